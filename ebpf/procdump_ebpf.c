@@ -17,18 +17,18 @@
 #include "procdump_ebpf.h"
 #include "procdump_ebpf_common.h"
 
-pid_t target_PID;
 uint dev, inode;
 int sampleRate;
 int currentSampleCount;
 bool isLoggingEnabled;
+bool churnMode;
 
 char LICENSE[] SEC("license") = "Dual BSD/GPL";
 
 // ------------------------------------------------------------------------------------------
 // GetFilterPidTgid
 //
-// Returns the PID and TID of the current process.
+// Returns the PID and TID of the current process if it's one of the processes being tracked.
 // ------------------------------------------------------------------------------------------
 __attribute__((always_inline))
 static inline bool GetFilterPidTgid(struct bpf_pidns_info* pidns)
@@ -39,9 +39,9 @@ static inline bool GetFilterPidTgid(struct bpf_pidns_info* pidns)
     }
 
     //
-    // Only trace PIDs that matched the target PID and if we should sample this event.
+    // Only trace PIDs that are in the set of target PIDs.
     //
-    if (pidns->tgid != target_PID)
+    if (bpf_map_lookup_elem(&targetPidMap, &pidns->tgid) == NULL)
     {
         return false;
     }
@@ -71,138 +71,193 @@ static inline bool CheckSampleRate()
 }
 
 // ------------------------------------------------------------------------------------------
-// ZeroMemory
+// RecordChurn
 //
-// We could just simply use memset but string.h is not working correctly due to needing
-// the 32bit version of stubs.h (stubs-32.h). For some reason targeting bpf undefines __x86_64__.
-// We can work around this on most architectures (they all have 32bit version) but not on
-// mariner which does not offer it (for now).
+// Counts an allocation against its call stack in churn mode. Nothing is sent to user space.
 // ------------------------------------------------------------------------------------------
 __attribute__((always_inline))
-static inline void ZeroMemory(char* ptr, unsigned int size)
+static inline int RecordChurn(unsigned long size, void *ctx, struct bpf_pidns_info* pidns)
 {
-    for(int i = 0; i < size; i++)
+    struct ChurnKey key = {};
+    struct ChurnValue* value = NULL;
+
+    //
+    // Same as the events, we are on the return path so the top frame is the caller of the
+    // allocation function.
+    //
+    key.pid = pidns->tgid;
+    key.stackId = bpf_get_stackid(ctx, &churnStackMap, USER_STACKID_FLAGS);
+
+    value = bpf_map_lookup_elem(&churnMap, &key);
+    if (value != NULL)
+    {
+        //
+        // Per cpu values, no need for atomics
+        //
+        value->count++;
+        value->bytes += size;
+        return 0;
+    }
+
+    struct ChurnValue initial = { 1, size };
+    if (bpf_map_update_elem(&churnMap, &key, &initial, BPF_NOEXIST) != 0)
     {
-        ptr[i] = 0;
+        BPF_PRINTK("   [RecordChurn] Failed: Adding stack (stack id: %d, target PID: %d)", key.stackId, pidns->tgid);
+        return 1;
     }
+
+    return 0;
 }
 
 // ------------------------------------------------------------------------------------------
-// SendEvent
+// SendResourceEvent
 //
-// Sends the allocation/free event
+// Sends a resource creation event along with the user mode call stack. The event is built
+// directly in the ring buffer and only the fields we use are written.
 // ------------------------------------------------------------------------------------------
 __attribute__((always_inline))
-static inline int SendEvent(void* alloc, bool freeOp, struct bpf_pidns_info* pidns)
+static inline int SendResourceEvent(unsigned long resource, unsigned int type, unsigned long size, void *ctx, struct bpf_pidns_info* pidns)
 {
     struct ResourceInformation* event = NULL;
-    int ret = 1;
+    long stackSize = 0;
 
     //
-    // Only trace PIDs that matched the target PID and have non NULL allocations
+    // In churn mode only the allocations are counted, other resources are not tracked.
     //
-    if (freeOp == false && alloc == NULL)
+    if (churnMode == true)
     {
-        return 1;
+        return type == RESTRACK_ALLOC ? RecordChurn(size, ctx, pidns) : 0;
     }
 
-    //
-    // Get event
-    //
-    event = (struct ResourceInformation*) bpf_map_lookup_elem(&argsHashMap, &pidns->pid);
+    event = bpf_ringbuf_reserve(&ringBuffer, sizeof(struct ResourceInformation), 0);
     if (event == NULL)
     {
-        BPF_PRINTK("   [SendEvent] Failed: Getting event (allocation address: 0x%lx, target PID: %d)", alloc, target_PID);
+        BPF_PRINTK("   [SendResourceEvent] Failed: Reserving event (resource: 0x%lx, target PID: %d)", resource, pidns->tgid);
         return 1;
     }
 
+    event->allocAddress = resource;
+    event->pid = pidns->tgid;
+    event->resourceType = type;
+    event->allocSize = size;
+    event->timestamp = bpf_ktime_get_ns();
+
     //
-    // Set the allocation address if it's an allocation operation
+    // We are on the return path so the top frame is the caller of the allocation function.
     //
-    if(freeOp == false)
-    {
-        event->allocAddress = (unsigned long) alloc;
-        BPF_PRINTK("   [SendEvent] Allocation size:0x%lx", event->allocSize);
-    }
+    stackSize = bpf_get_stack(ctx, event->stackTrace, sizeof(event->stackTrace), BPF_F_USER_STACK);
+    event->callStackLen = stackSize > 0 ? stackSize / sizeof(__u64) : 0;
+
+    bpf_ringbuf_submit(event, 0);
+
+    BPF_PRINTK("   [SendResourceEvent] Success: (type: %d, size: 0x%lx, resource: 0x%lx)", type, size, resource);
+    return 0;
+}
 
-    {BPF_PRINTK("   [SendEvent] Allocation :0x%lx", event->allocAddress);}
+// ------------------------------------------------------------------------------------------
+// SendReleaseEvent
+//
+// Sends a resource release event. It only needs the resource so it is sent straight away on
+// entry and we don't need a return probe.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int SendReleaseEvent(unsigned long resource, unsigned int type, struct bpf_pidns_info* pidns)
+{
+    struct ResourceInformation* event = NULL;
 
     //
-    // Send the event to the ring buffer (user land)
+    // Nothing is outstanding in churn mode.
     //
-    if((ret = bpf_ringbuf_output(&ringBuffer, event, sizeof(*event), 0)) != 0)
+    if (churnMode == true)
     {
-        BPF_PRINTK("   [SendEvent] Failed: Getting event (type: %d, allocation address: 0x%lx, target PID: %d)", event->resourceType, event->allocAddress, target_PID);
-        return ret;
+        return 0;
     }
 
-    {BPF_PRINTK("   [SendEvent] Deleting event for %ld", pidns->pid);}
-    if((ret = bpf_map_delete_elem(&argsHashMap, &pidns->pid)) != 0)
+    //
+    // Release events don't carry a call stack so only reserve the header.
+    //
+    event = bpf_ringbuf_reserve(&ringBuffer, offsetof(struct ResourceInformation, stackTrace), 0);
+    if (event == NULL)
     {
-        BPF_PRINTK("   [SendEvent] Failed: Deleting event (type: %d, allocation address: 0x%lx, target PID: %d)", event->resourceType, event->allocAddress, target_PID);
-        return ret;
+        BPF_PRINTK("   [SendReleaseEvent] Failed: Reserving event (resource: 0x%lx, target PID: %d)", resource, pidns->tgid);
+        return 1;
     }
 
-    BPF_PRINTK("   [SendEvent] Success: (type: %d, allocation address: 0x%lx, target PID: %d)", event->resourceType, event->allocAddress, target_PID);
+    event->allocAddress = resource;
+    event->pid = pidns->tgid;
+    event->resourceType = type;
+    event->allocSize = 0;
+    event->callStackLen = 0;
+    event->timestamp = 0;
+
+    bpf_ringbuf_submit(event, 0);
+
+    BPF_PRINTK("   [SendReleaseEvent] Success: (type: %d, resource: 0x%lx, target PID: %d)", type, resource, pidns->tgid);
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
-// ResourceFreeHelper
+// SendEvent
 //
-// Helper for all the intercepted free functions.
+// Sends the allocation event. Invoked on exit of the allocation function once the
+// allocation address is known.
 // ------------------------------------------------------------------------------------------
 __attribute__((always_inline))
-static inline int ResourceFreeHelper(void* alloc, struct bpf_pidns_info* pidns)
+static inline int SendEvent(void* alloc, void *ctx, struct bpf_pidns_info* pidns)
 {
-    struct ResourceInformation* event = NULL;
-    uint32_t map_id = bpf_get_smp_processor_id();
+    struct argsStruct* args = NULL;
+    unsigned long size = 0;
 
     //
-    // Get heap element from the map
+    // Get the arguments stored on entry. If there are none, this call was not sampled.
     //
-    event = bpf_map_lookup_elem(&heapStorage, &map_id);
-    if (event == NULL)
+    args = (struct argsStruct*) bpf_map_lookup_elem(&argsHashMap, &pidns->pid);
+    if (args == NULL)
     {
-        BPF_PRINTK("   [ResourceFreeHelper] Failed: Getting event (allocation: 0x%lx, target PID: %d)", alloc, target_PID);
-        return 1;
+        return 0;
     }
 
-    ZeroMemory((char*) event, sizeof(struct ResourceInformation));
-
-    //
-    // Setup the event we want to transfer to usermode.
-    //
-    event->pid = target_PID;
-    event->resourceType = RESTRACK_FREE;
-    event->allocAddress = (unsigned long) alloc;
+    size = args->size;
+    bpf_map_delete_elem(&argsHashMap, &pidns->pid);
 
     //
-    // Update the arguments hashmap with the entry. We'll fetch the entry when
-    // we free the allocation and update other fields (such as allocation ptr) and then
-    // send to user mode.
+    // Only trace non NULL allocations
     //
-    if (bpf_map_update_elem(&argsHashMap, &pidns->pid, event, BPF_ANY) != 0)
+    if (alloc == NULL)
     {
-        BPF_PRINTK("   [ResourceFreeHelper] Failed: Updating event (allocation: 0x%lx, target PID: %d)", alloc, target_PID);
         return 1;
     }
 
-    BPF_PRINTK("   [ResourceFreeHelper] Success: (allocation: 0x%lx, target PID: %d)", alloc, target_PID);
-    return 0;
+    return SendResourceEvent((unsigned long) alloc, RESTRACK_ALLOC, size, ctx, pidns);
+}
+
+// ------------------------------------------------------------------------------------------
+// ResourceFreeHelper
+//
+// Helper for all the intercepted free functions.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int ResourceFreeHelper(void* alloc, struct bpf_pidns_info* pidns)
+{
+    if (alloc == NULL)
+    {
+        return 0;
+    }
+
+    return SendReleaseEvent((unsigned long) alloc, RESTRACK_FREE, pidns);
 }
 
 
 // ------------------------------------------------------------------------------------------
 // ResourceAllocHelper
 //
-// Helper for all the intercepted allocation functions.
+// Helper for all the intercepted allocation functions. Records the arguments we need on
+// exit for the calls that are sampled.
 // ------------------------------------------------------------------------------------------
 __attribute__((always_inline))
-static inline int ResourceAllocHelper(unsigned long size, struct pt_regs *ctx, struct bpf_pidns_info* pidns)
+static inline int ResourceAllocHelper(unsigned long size, struct bpf_pidns_info* pidns)
 {
-    struct ResourceInformation* event = NULL;
-    uint32_t map_id = bpf_get_smp_processor_id();
+    struct argsStruct args = {};
 
     //
     // Only trace if we should sample this event.
@@ -212,49 +267,48 @@ static inline int ResourceAllocHelper(unsigned long size, struct pt_regs *ctx, s
         return 0;
     }
 
+    args.size = size;
+
     //
-    // Get heap element from the map
+    // Update the arguments hashmap with the entry. We'll fetch the entry when
+    // we exit the allocation and send the event to user mode.
     //
-    event = bpf_map_lookup_elem(&heapStorage, &map_id);
-    if (event != NULL)
-    {
-        ZeroMemory((char*) event, sizeof(struct ResourceInformation));
-    }
-    else
+    if (bpf_map_update_elem(&argsHashMap, &pidns->pid, &args, BPF_ANY) != 0)
     {
-        BPF_PRINTK("   [ResourceAllocHelper] Failed: Getting event (allocation size: 0x%lx, target PID: %d)", size, target_PID);
+        BPF_PRINTK("   [ResourceAllocHelper] Failed: Updating args (allocation size: 0x%lx, target PID: %d)", size, pidns->tgid);
         return 1;
     }
 
-    //
-    // Setup the event we want to transfer to usermode.
-    //
-    event->allocSize = size;
-    event->pid = target_PID;
-    event->resourceType = RESTRACK_ALLOC;
-    event->allocAddress = 0;
-    event->callStackLen = bpf_get_stack(ctx, event->stackTrace, sizeof(event->stackTrace), BPF_F_USER_STACK) / sizeof(__u64);
+    BPF_PRINTK("   [ResourceAllocHelper] Success: (allocation size: 0x%lx, target PID: %d)", size, pidns->tgid);
+    return 0;
+}
 
-    //
-    // Update the arguments hashmap with the entry. We'll fetch the entry when
-    // we exit the malloc and update other fields (such as allocation ptr) and then
-    // send to user mode.
-    //
-    if (bpf_map_update_elem(&argsHashMap, &pidns->pid, event, BPF_ANY) != 0)
+// ------------------------------------------------------------------------------------------
+// sys_enter_mmap
+//
+// Mappings are tracked using the syscall tracepoints rather than uprobes on the libc
+// wrappers. This is cheaper (no user mode trap) and also catches mappings made by direct
+// syscalls, the dynamic loader, runtimes that don't use libc and statically linked binaries.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/syscalls/sys_enter_mmap")
+int sys_enter_mmap(struct trace_event_raw_sys_enter *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    if(GetFilterPidTgid(&pidns) == false)
     {
-        BPF_PRINTK("   [ResourceAllocHelper] Failed: Updating event (allocation size: 0x%lx, target PID: %d)", size, target_PID);
-        return 1;
+        return 0;
     }
 
-    BPF_PRINTK("   [ResourceAllocHelper] Success: (allocation size: 0x%lx, target PID: %d)", size, target_PID);
+    {BPF_PRINTK("[***** sys_enter_mmap, pid: %ld, tgid: %ld, size: %ld]", pidns.pid, pidns.tgid, ctx->args[1]);}
+    ResourceAllocHelper(ctx->args[1], &pidns);
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
-// sys_mmap_enter
+// sys_exit_mmap
 // ------------------------------------------------------------------------------------------
-SEC("uprobe/libc.so.6:mmap")
-int sys_mmap_enter(struct pt_regs *ctx)
+SEC("tracepoint/syscalls/sys_exit_mmap")
+int sys_exit_mmap(struct trace_event_raw_sys_exit *ctx)
 {
     struct bpf_pidns_info pidns = {};
     if(GetFilterPidTgid(&pidns) == false)
@@ -262,16 +316,20 @@ int sys_mmap_enter(struct pt_regs *ctx)
         return 0;
     }
 
-    {BPF_PRINTK("[***** sys_mmap_enter, pid: %ld, tgid: %ld, size: %ld]", pidns.pid, pidns.tgid, (unsigned long) PT_REGS_PARM2(ctx));}
-    ResourceAllocHelper((unsigned long) PT_REGS_PARM2(ctx), ctx, &pidns);
+    {BPF_PRINTK("[***** sys_exit_mmap, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
+
+    //
+    // Failed mappings return -errno, treat them as a NULL allocation.
+    //
+    SendEvent(ctx->ret < 0 ? NULL : (void*) ctx->ret, ctx, &pidns);
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
-// sys_mmap_exit
+// sys_enter_munmap
 // ------------------------------------------------------------------------------------------
-SEC("uretprobe/libc.so.6:mmap")
-int sys_mmap_exit(struct pt_regs *ctx)
+SEC("tracepoint/syscalls/sys_enter_munmap")
+int sys_enter_munmap(struct trace_event_raw_sys_enter *ctx)
 {
     struct bpf_pidns_info pidns = {};
     if(GetFilterPidTgid(&pidns) == false)
@@ -279,49 +337,97 @@ int sys_mmap_exit(struct pt_regs *ctx)
         return 0;
     }
 
-    {BPF_PRINTK("[***** sys_mmap_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
-    SendEvent((void*) PT_REGS_RC(ctx), false, &pidns);
+    {BPF_PRINTK("[***** sys_enter_munmap, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
+    ResourceFreeHelper((void*) ctx->args[0], &pidns);
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
-// sys_munmap_enter
+// sys_enter_mremap
+//
+// A successful mremap frees the old mapping and creates a new one (possibly at the same
+// address). The old address is always needed on exit, the new size only if sampled.
 // ------------------------------------------------------------------------------------------
-SEC("uprobe/libc.so.6:munmap")
-int sys_munmap_enter(struct pt_regs *ctx)
+SEC("tracepoint/syscalls/sys_enter_mremap")
+int sys_enter_mremap(struct trace_event_raw_sys_enter *ctx)
 {
     struct bpf_pidns_info pidns = {};
+    struct argsStruct args = {};
+
     if(GetFilterPidTgid(&pidns) == false)
     {
         return 0;
     }
 
-    {BPF_PRINTK("[***** sys_munmap_enter, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
-    ResourceFreeHelper((void*) PT_REGS_PARM1(ctx), &pidns);
+    {BPF_PRINTK("[***** sys_enter_mremap, pid: %ld, tgid: %ld, size: %ld]", pidns.pid, pidns.tgid, ctx->args[2]);}
+
+    args.address = ctx->args[0];
+    args.size = CheckSampleRate() ? ctx->args[2] : 0;
+
+    if (bpf_map_update_elem(&argsHashMap, &pidns.pid, &args, BPF_ANY) != 0)
+    {
+        BPF_PRINTK("   [sys_enter_mremap] Failed: Updating args (address: 0x%lx, target PID: %d)", args.address, pidns.tgid);
+    }
+
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
-// sys_munmap_exit
+// sys_exit_mremap
 // ------------------------------------------------------------------------------------------
-SEC("uretprobe/libc.so.6:munmap")
-int sys_munmap_exit(struct pt_regs *ctx)
+SEC("tracepoint/syscalls/sys_exit_mremap")
+int sys_exit_mremap(struct trace_event_raw_sys_exit *ctx)
 {
     struct bpf_pidns_info pidns = {};
+    struct argsStruct* args = NULL;
+    unsigned long address = 0;
+
     if(GetFilterPidTgid(&pidns) == false)
     {
         return 0;
     }
 
-    {BPF_PRINTK("[***** sys_munmap_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
-    SendEvent(NULL, true, &pidns);
+    {BPF_PRINTK("[***** sys_exit_mremap, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
+
+    args = (struct argsStruct*) bpf_map_lookup_elem(&argsHashMap, &pidns.pid);
+    if (args == NULL)
+    {
+        return 0;
+    }
+
+    //
+    // If the remap failed the old mapping is left untouched.
+    //
+    if (ctx->ret < 0)
+    {
+        bpf_map_delete_elem(&argsHashMap, &pidns.pid);
+        return 0;
+    }
+
+    address = args->address;
+    ResourceFreeHelper((void*) address, &pidns);
+
+    //
+    // SendEvent consumes the arguments. If this call was not sampled we only record the free.
+    //
+    if (args->size == 0)
+    {
+        bpf_map_delete_elem(&argsHashMap, &pidns.pid);
+        return 0;
+    }
+
+    SendEvent((void*) ctx->ret, ctx, &pidns);
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
 // uprobe_malloc
+//
+// The allocator uprobes are not bound to a specific library. User space discovers the
+// allocator entry points in the target (libc, jemalloc, tcmalloc, mimalloc, operator new
+// and delete etc.) and attaches the program that matches the function's signature.
 // ------------------------------------------------------------------------------------------
-SEC("uprobe/libc.so.6:malloc")
+SEC("uprobe")
 int BPF_KPROBE(uprobe_malloc, unsigned long size)
 {
     struct bpf_pidns_info pidns = {};
@@ -331,14 +437,14 @@ int BPF_KPROBE(uprobe_malloc, unsigned long size)
     }
 
     {BPF_PRINTK("[***** malloc_enter, pid:%ld, tgid: %ld, size: %ld]", pidns.pid, pidns.tgid, size);}
-    ResourceAllocHelper(size, ctx, &pidns);
+    ResourceAllocHelper(size, &pidns);
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
 // uretprobe_malloc
 // ------------------------------------------------------------------------------------------
-SEC("uretprobe/libc.so.6:malloc")
+SEC("uretprobe")
 int BPF_KRETPROBE(uretprobe_malloc, void* ret)
 {
     struct bpf_pidns_info pidns = {};
@@ -348,14 +454,14 @@ int BPF_KRETPROBE(uretprobe_malloc, void* ret)
     }
 
     {BPF_PRINTK("[***** malloc_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
-    SendEvent(ret, false, &pidns);
+    SendEvent(ret, ctx, &pidns);
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
 // uprobe_free
 // ------------------------------------------------------------------------------------------
-SEC("uprobe/libc.so.6:free")
+SEC("uprobe")
 int BPF_KPROBE(uprobe_free, void* alloc)
 {
     struct bpf_pidns_info pidns = {};
@@ -370,29 +476,12 @@ int BPF_KPROBE(uprobe_free, void* alloc)
 }
 
 
-// ------------------------------------------------------------------------------------------
-// uretprobe_free
-// ------------------------------------------------------------------------------------------
-SEC("uretprobe/libc.so.6:free")
-int BPF_KRETPROBE(uretprobe_free, void* ret)
-{
-    struct bpf_pidns_info pidns = {};
-    if(GetFilterPidTgid(&pidns) == false)
-    {
-        return 0;
-    }
-
-    {BPF_PRINTK("[***** free_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
-    SendEvent(NULL, true, &pidns);
-    return 0;
-}
-
 // ------------------------------------------------------------------------------------------
 // uprobe_cmalloc
 //
 // This is the entry point for the calloc uprobe. It's called when calloc is called.
 // ------------------------------------------------------------------------------------------
-SEC("uprobe/libc.so.6:calloc")
+SEC("uprobe")
 int BPF_KPROBE(uprobe_calloc, int count, unsigned long size)
 {
     struct bpf_pidns_info pidns = {};
@@ -402,7 +491,7 @@ int BPF_KPROBE(uprobe_calloc, int count, unsigned long size)
     }
 
     {BPF_PRINTK("[***** calloc_enter, pid: %ld, tgid: %ld, size: %ld]", pidns.pid, pidns.tgid, size*count);}
-    ResourceAllocHelper(size*count, ctx, &pidns);
+    ResourceAllocHelper(size*count, &pidns);
     return 0;
 }
 
@@ -411,7 +500,7 @@ int BPF_KPROBE(uprobe_calloc, int count, unsigned long size)
 //
 // This is the entry point for the calloc exit uprobe. It's called when calloc is exiting.
 // ------------------------------------------------------------------------------------------
-SEC("uretprobe/libc.so.6:calloc")
+SEC("uretprobe")
 int BPF_KRETPROBE(uretprobe_calloc, void* ret)
 {
     struct bpf_pidns_info pidns = {};
@@ -421,7 +510,7 @@ int BPF_KRETPROBE(uretprobe_calloc, void* ret)
     }
 
     {BPF_PRINTK("[***** calloc_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
-    SendEvent(ret, false, &pidns);
+    SendEvent(ret, ctx, &pidns);
     return 0;
 }
 
@@ -430,7 +519,7 @@ int BPF_KRETPROBE(uretprobe_calloc, void* ret)
 //
 // This is the entry point for the realloc uprobe. It's called when realloc is called.
 // ------------------------------------------------------------------------------------------
-SEC("uprobe/libc.so.6:realloc")
+SEC("uprobe")
 int BPF_KPROBE(uprobe_realloc, void* ptr, unsigned long size)
 {
     struct bpf_pidns_info pidns = {};
@@ -440,7 +529,7 @@ int BPF_KPROBE(uprobe_realloc, void* ptr, unsigned long size)
     }
 
     {BPF_PRINTK("[***** realloc_enter, pid:%ld, tgid: %ld, size:%ld]", pidns.pid, pidns.tgid, size);}
-    ResourceAllocHelper(size, ctx, &pidns);
+    ResourceAllocHelper(size, &pidns);
     return 0;
 }
 
@@ -449,7 +538,7 @@ int BPF_KPROBE(uprobe_realloc, void* ptr, unsigned long size)
 //
 // This is the entry point for the realloc exit uprobe. It's called when realloc is exiting.
 // ------------------------------------------------------------------------------------------
-SEC("uretprobe/libc.so.6:realloc")
+SEC("uretprobe")
 int BPF_KRETPROBE(uretprobe_realloc, void* ret)
 {
     struct bpf_pidns_info pidns = {};
@@ -459,7 +548,7 @@ int BPF_KRETPROBE(uretprobe_realloc, void* ret)
     }
 
     {BPF_PRINTK("[***** realloc_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
-    SendEvent(ret, false, &pidns);
+    SendEvent(ret, ctx, &pidns);
     return 0;
 }
 
@@ -469,7 +558,7 @@ int BPF_KRETPROBE(uretprobe_realloc, void* ret)
 //
 // This is the entry point for the reallocarray uprobe. It's called when reallocarray is called.
 // ------------------------------------------------------------------------------------------
-SEC("uprobe/libc.so.6:reallocarray")
+SEC("uprobe")
 int BPF_KPROBE(uprobe_reallocarray, void* ptr, long count, unsigned long size)
 {
     struct bpf_pidns_info pidns = {};
@@ -479,7 +568,7 @@ int BPF_KPROBE(uprobe_reallocarray, void* ptr, long count, unsigned long size)
     }
 
     {BPF_PRINTK("[***** reallocarray_enter, pid: %ld, tgid: %ld, size: %ld]", pidns.pid, pidns.tgid, size*count);}
-    ResourceAllocHelper(size*count, ctx, &pidns);
+    ResourceAllocHelper(size*count, &pidns);
     return 0;
 }
 
@@ -488,7 +577,7 @@ int BPF_KPROBE(uprobe_reallocarray, void* ptr, long count, unsigned long size)
 //
 // This is the entry point for the reallocarray exit uprobe. It's called when reallocarray is exiting.
 // ------------------------------------------------------------------------------------------
-SEC("uretprobe/libc.so.6:reallocarray")
+SEC("uretprobe")
 int BPF_KRETPROBE(uretprobe_reallocarray, void* ret)
 {
     struct bpf_pidns_info pidns = {};
@@ -498,6 +587,391 @@ int BPF_KRETPROBE(uretprobe_reallocarray, void* ret)
     }
 
     {BPF_PRINTK("[***** reallocarray_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
-    SendEvent(ret, false, &pidns);
+    SendEvent(ret, ctx, &pidns);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// uprobe_aligned_alloc
+//
+// Entry point for aligned_alloc/memalign style functions (alignment, size). The exit is
+// handled by uretprobe_malloc.
+// ------------------------------------------------------------------------------------------
+SEC("uprobe")
+int BPF_KPROBE(uprobe_aligned_alloc, unsigned long alignment, unsigned long size)
+{
+    struct bpf_pidns_info pidns = {};
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    {BPF_PRINTK("[***** aligned_alloc_enter, pid: %ld, tgid: %ld, size: %ld]", pidns.pid, pidns.tgid, size);}
+    ResourceAllocHelper(size, &pidns);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// uprobe_posix_memalign
+//
+// Entry point for posix_memalign style functions (memptr, alignment, size). The allocation
+// is returned through memptr so we keep it around until exit.
+// ------------------------------------------------------------------------------------------
+SEC("uprobe")
+int BPF_KPROBE(uprobe_posix_memalign, void** memptr, unsigned long alignment, unsigned long size)
+{
+    struct bpf_pidns_info pidns = {};
+    struct argsStruct* args = NULL;
+
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    {BPF_PRINTK("[***** posix_memalign_enter, pid: %ld, tgid: %ld, size: %ld]", pidns.pid, pidns.tgid, size);}
+    if (ResourceAllocHelper(size, &pidns) != 0)
+    {
+        return 0;
+    }
+
+    args = (struct argsStruct*) bpf_map_lookup_elem(&argsHashMap, &pidns.pid);
+    if (args != NULL)
+    {
+        args->address = (unsigned long) memptr;
+    }
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// uretprobe_posix_memalign
+// ------------------------------------------------------------------------------------------
+SEC("uretprobe")
+int BPF_KRETPROBE(uretprobe_posix_memalign, int ret)
+{
+    struct bpf_pidns_info pidns = {};
+    struct argsStruct* args = NULL;
+    void* alloc = NULL;
+
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    {BPF_PRINTK("[***** posix_memalign_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
+
+    args = (struct argsStruct*) bpf_map_lookup_elem(&argsHashMap, &pidns.pid);
+    if (args == NULL)
+    {
+        return 0;
+    }
+
+    //
+    // On failure memptr is left untouched, SendEvent treats NULL as a failed allocation.
+    //
+    if (ret == 0 && args->address != 0)
+    {
+        bpf_probe_read_user(&alloc, sizeof(alloc), (void*) args->address);
+    }
+
+    SendEvent(alloc, ctx, &pidns);
     return 0;
-}
\ No newline at end of file
+}
+
+// ------------------------------------------------------------------------------------------
+// FdOpenHelper
+//
+// Helper for the exit of all the syscalls that return a new file descriptor.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int FdOpenHelper(struct trace_event_raw_sys_exit *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    if (ctx->ret < 0)
+    {
+        return 0;
+    }
+
+    {BPF_PRINTK("[***** fd_open, pid: %ld, tgid: %ld, fd: %ld]", pidns.pid, pidns.tgid, ctx->ret);}
+    return SendResourceEvent(ctx->ret, RESTRACK_FD_OPEN, 0, ctx, &pidns);
+}
+
+SEC("tracepoint/syscalls/sys_exit_openat")
+int sys_exit_openat(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+SEC("tracepoint/syscalls/sys_exit_socket")
+int sys_exit_socket(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+SEC("tracepoint/syscalls/sys_exit_accept")
+int sys_exit_accept(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+SEC("tracepoint/syscalls/sys_exit_accept4")
+int sys_exit_accept4(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+SEC("tracepoint/syscalls/sys_exit_dup")
+int sys_exit_dup(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+SEC("tracepoint/syscalls/sys_exit_dup3")
+int sys_exit_dup3(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+SEC("tracepoint/syscalls/sys_exit_eventfd2")
+int sys_exit_eventfd2(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+#if defined(__TARGET_ARCH_x86)
+//
+// Legacy syscalls that only exist on x86
+//
+SEC("tracepoint/syscalls/sys_exit_open")
+int sys_exit_open(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+SEC("tracepoint/syscalls/sys_exit_dup2")
+int sys_exit_dup2(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+
+SEC("tracepoint/syscalls/sys_exit_eventfd")
+int sys_exit_eventfd(struct trace_event_raw_sys_exit *ctx)
+{
+    return FdOpenHelper(ctx);
+}
+#endif
+
+// ------------------------------------------------------------------------------------------
+// sys_enter_pipe2
+//
+// pipe2 returns the descriptors through the array passed in so we keep it around until exit.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int PipeEnterHelper(unsigned long fds)
+{
+    struct bpf_pidns_info pidns = {};
+    struct argsStruct args = {};
+
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    args.address = fds;
+    bpf_map_update_elem(&argsHashMap, &pidns.pid, &args, BPF_ANY);
+    return 0;
+}
+
+__attribute__((always_inline))
+static inline int PipeExitHelper(struct trace_event_raw_sys_exit *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    struct argsStruct* args = NULL;
+    int fds[2] = {};
+
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    args = (struct argsStruct*) bpf_map_lookup_elem(&argsHashMap, &pidns.pid);
+    if (args == NULL)
+    {
+        return 0;
+    }
+
+    if (ctx->ret == 0 && bpf_probe_read_user(fds, sizeof(fds), (void*) args->address) == 0)
+    {
+        {BPF_PRINTK("[***** pipe, pid: %ld, tgid: %ld, fds: %d %d]", pidns.pid, pidns.tgid, fds[0], fds[1]);}
+        SendResourceEvent(fds[0], RESTRACK_FD_OPEN, 0, ctx, &pidns);
+        SendResourceEvent(fds[1], RESTRACK_FD_OPEN, 0, ctx, &pidns);
+    }
+
+    bpf_map_delete_elem(&argsHashMap, &pidns.pid);
+    return 0;
+}
+
+SEC("tracepoint/syscalls/sys_enter_pipe2")
+int sys_enter_pipe2(struct trace_event_raw_sys_enter *ctx)
+{
+    return PipeEnterHelper(ctx->args[0]);
+}
+
+SEC("tracepoint/syscalls/sys_exit_pipe2")
+int sys_exit_pipe2(struct trace_event_raw_sys_exit *ctx)
+{
+    return PipeExitHelper(ctx);
+}
+
+#if defined(__TARGET_ARCH_x86)
+SEC("tracepoint/syscalls/sys_enter_pipe")
+int sys_enter_pipe(struct trace_event_raw_sys_enter *ctx)
+{
+    return PipeEnterHelper(ctx->args[0]);
+}
+
+SEC("tracepoint/syscalls/sys_exit_pipe")
+int sys_exit_pipe(struct trace_event_raw_sys_exit *ctx)
+{
+    return PipeExitHelper(ctx);
+}
+#endif
+
+// ------------------------------------------------------------------------------------------
+// sys_enter_close
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/syscalls/sys_enter_close")
+int sys_enter_close(struct trace_event_raw_sys_enter *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    {BPF_PRINTK("[***** close, pid: %ld, tgid: %ld, fd: %ld]", pidns.pid, pidns.tgid, ctx->args[0]);}
+    SendReleaseEvent(ctx->args[0], RESTRACK_FD_CLOSE, &pidns);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// sys_enter_clone
+//
+// Thread creation is reported from sched_process_fork which runs in the context of the
+// creating thread and gives us the new thread id. The clone flags are only available on the
+// syscall so we keep them around until then.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int CloneEnterHelper(unsigned long flags)
+{
+    struct bpf_pidns_info pidns = {};
+    struct argsStruct args = {};
+
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    if ((flags & CLONE_THREAD) == 0)
+    {
+        return 0;
+    }
+
+    args.size = flags;
+    bpf_map_update_elem(&argsHashMap, &pidns.pid, &args, BPF_ANY);
+    return 0;
+}
+
+__attribute__((always_inline))
+static inline int CloneExitHelper()
+{
+    struct bpf_pidns_info pidns = {};
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    //
+    // Normally consumed by sched_process_fork, only left over if the clone failed.
+    //
+    bpf_map_delete_elem(&argsHashMap, &pidns.pid);
+    return 0;
+}
+
+SEC("tracepoint/syscalls/sys_enter_clone")
+int sys_enter_clone(struct trace_event_raw_sys_enter *ctx)
+{
+    return CloneEnterHelper(ctx->args[0]);
+}
+
+SEC("tracepoint/syscalls/sys_exit_clone")
+int sys_exit_clone(struct trace_event_raw_sys_exit *ctx)
+{
+    return CloneExitHelper();
+}
+
+SEC("tracepoint/syscalls/sys_enter_clone3")
+int sys_enter_clone3(struct trace_event_raw_sys_enter *ctx)
+{
+    __u64 flags = 0;
+    bpf_probe_read_user(&flags, sizeof(flags), (void*) ctx->args[0] + offsetof(struct clone_args, flags));
+    return CloneEnterHelper(flags);
+}
+
+SEC("tracepoint/syscalls/sys_exit_clone3")
+int sys_exit_clone3(struct trace_event_raw_sys_exit *ctx)
+{
+    return CloneExitHelper();
+}
+
+// ------------------------------------------------------------------------------------------
+// sched_process_fork
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/sched/sched_process_fork")
+int sched_process_fork(struct trace_event_raw_sched_process_fork *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    struct argsStruct* args = NULL;
+
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    args = (struct argsStruct*) bpf_map_lookup_elem(&argsHashMap, &pidns.pid);
+    if (args == NULL)
+    {
+        return 0;
+    }
+
+    bpf_map_delete_elem(&argsHashMap, &pidns.pid);
+
+    {BPF_PRINTK("[***** thread_create, pid: %ld, tgid: %ld, tid: %d]", pidns.pid, pidns.tgid, ctx->child_pid);}
+    SendResourceEvent(ctx->child_pid, RESTRACK_THREAD_CREATE, 0, ctx, &pidns);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// sched_process_exit
+//
+// Fires for every thread that exits. The thread id is taken from the root pid namespace to
+// match the id reported by sched_process_fork.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/sched/sched_process_exit")
+int sched_process_exit(struct trace_event_raw_sched_process_template *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    if(GetFilterPidTgid(&pidns) == false)
+    {
+        return 0;
+    }
+
+    {BPF_PRINTK("[***** thread_exit, pid: %ld, tgid: %ld]", pidns.pid, pidns.tgid);}
+    SendReleaseEvent((__u32) bpf_get_current_pid_tgid(), RESTRACK_THREAD_EXIT, &pidns);
+    return 0;
+}
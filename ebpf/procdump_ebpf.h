@@ -21,8 +21,13 @@
 #include <bpf_helpers.h>
 #include <usdt.bpf.h>
 
+#include "procdump_ebpf_common.h"
+
 #define USER_STACKID_FLAGS (0 | BPF_F_FAST_STACK_CMP | BPF_F_USER_STACK)
 #define ARGS_HASH_SIZE 10240
+#define TARGET_PID_MAP_SIZE 4096
+#define CLONE_THREAD 0x00010000
+#define CHURN_STACKS_SIZE 16384
 
 #define BPF_PRINTK( format, ... ) \
     if(isLoggingEnabled == true) \
@@ -32,40 +37,67 @@
     }
 
 //
-// This is a hashmap to hold resource arguments (such as size) between alloc and free calls.
-// It's shared by all cpus because alloc and free could be on different cpus.
+// The set of processes (tgid in procdump's pid namespace) being tracked. It's shared by all
+// targets so that a single instance of the program can track all of them.
+//
+struct
+{
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, TARGET_PID_MAP_SIZE);
+    __type(key, int);
+    __type(value, __u8);
+} targetPidMap SEC(".maps");
+
+//
+// This is a hashmap to hold resource arguments (such as size) between the entry and exit
+// of an allocation call. It's keyed by thread id and shared by all cpus because entry and exit
+// could be on different cpus. Only the arguments are stored here, the event itself is built
+// directly in the ring buffer on exit. We use an LRU map so that threads that never return
+// (for example, killed mid allocation) can't starve other threads of entries. The address
+// is only used by calls that move an existing resource (mremap).
+//
 struct argsStruct
 {
     unsigned long size;
+    unsigned long address;
 };
 
 struct
 {
-    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
     __uint(max_entries, ARGS_HASH_SIZE);
     __type(key, int);
-    __type(value, struct ResourceInformation);
+    __type(value, struct argsStruct);
 } argsHashMap SEC(".maps");
 
-
 //
-// Since stack space is minimal, we use this to store an event on the heap
+// The ring buffer we use to communicate with user space
 //
 struct
 {
-	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
-	__uint(max_entries, 512);
-	__type(key, int);
-	__type(value, struct ResourceInformation);
-} heapStorage SEC(".maps");
+	__uint(type, BPF_MAP_TYPE_RINGBUF);
+	__uint(max_entries, 10 * 1024 * 1024 /* 10 MB */);
+} ringBuffer SEC(".maps");
 
 //
-// The ring buffer we use to communicate with user space
+// Churn mode (-restrack churn) counts the allocations by call stack in-kernel instead of
+// sending them to user space. User space sizes both maps before loading and keeps them
+// minimal when churn mode is off.
 //
 struct
 {
-	__uint(type, BPF_MAP_TYPE_RINGBUF);
-	__uint(max_entries, 10 * 1024 * 1024 /* 10 MB */);
-} ringBuffer SEC(".maps");
+    __uint(type, BPF_MAP_TYPE_STACK_TRACE);
+    __uint(max_entries, CHURN_STACKS_SIZE);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, MAX_CALL_STACK_FRAMES * sizeof(__u64));
+} churnStackMap SEC(".maps");
+
+struct
+{
+    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __uint(max_entries, CHURN_STACKS_SIZE);
+    __type(key, struct ChurnKey);
+    __type(value, struct ChurnValue);
+} churnMap SEC(".maps");
 
-#endif // __PROCDUMP_EBPF_H__
\ No newline at end of file
+#endif // __PROCDUMP_EBPF_H__
@@ -19,8 +19,123 @@
 
 #define MAX_CALL_STACK_FRAMES   100
 
-#define RESTRACK_ALLOC       0x00000001
-#define RESTRACK_FREE        0x00000002
+#define RESTRACK_ALLOC          0x00000001
+#define RESTRACK_FREE           0x00000002
+#define RESTRACK_FD_OPEN        0x00000003
+#define RESTRACK_FD_CLOSE       0x00000004
+#define RESTRACK_THREAD_CREATE  0x00000005
+#define RESTRACK_THREAD_EXIT    0x00000006
+#define RESTRACK_ALLOC_CHURN    0x00000007      // only reported, churn is counted in-kernel
+
+//
+// Allocations counted in-kernel by call stack in churn mode (-restrack churn). The values
+// are per cpu and summed up by user space.
+//
+struct ChurnKey
+{
+    unsigned int pid;
+    int stackId;
+};
+
+struct ChurnValue
+{
+    __u64 count;
+    __u64 bytes;
+};
+
+//
+// Triggers evaluated in-kernel by the trigger eBPF program (procdump_trigger_ebpf.c). An
+// event is only sent to user space when the trigger condition is met.
+//
+#define TRIGGER_CPU             0x00000001
+#define TRIGGER_MEMORY          0x00000002
+#define TRIGGER_SIGNAL          0x00000004
+#define TRIGGER_THREAD_COUNT    0x00000008
+#define TRIGGER_FD_COUNT        0x00000010
+#define TRIGGER_PROBE           0x00000020
+#define TRIGGER_LATENCY         0x00000040
+#define TRIGGER_SYSCALL_ERROR   0x00000080
+#define TRIGGER_EXCEPTION       0x00000100
+
+//
+// Memory counters of a process reported by the kmem:rss_stat tracepoint (file, anonymous,
+// swap and shared memory pages), their sum is the commit used by the memory trigger.
+//
+#define TRIGGER_MEMORY_COUNTERS 4
+
+//
+// Size of the map of the change of the file descriptor count on success of each syscall
+// (indexed by syscall number).
+//
+#define TRIGGER_FD_SYSCALLS     512
+
+//
+// Syscalls whose change of the file descriptor count depends on their arguments, the change
+// is worked out on entry. The bitmap of open descriptors is scanned for up to
+// TRIGGER_FD_BITMAP_WORDS words (close_range) and up to TRIGGER_FD_CMSGS control messages
+// are parsed for SCM_RIGHTS descriptors (recvmsg).
+//
+#define TRIGGER_FD_FCNTL        0x100
+#define TRIGGER_FD_DUP2         0x101
+#define TRIGGER_FD_CLOSE_RANGE  0x102
+#define TRIGGER_FD_RECVMSG      0x103
+#define TRIGGER_FD_CALLS        4096
+#define TRIGGER_FD_BITMAP_WORDS 1024
+#define TRIGGER_FD_CMSGS        8
+
+//
+// Syscall error trigger: syscall numbers and errnos that can be filtered on.
+//
+#define TRIGGER_SYSCALLS        512
+#define TRIGGER_ERRNOS          256
+
+//
+// Size of the map of the calls of the -uprobe function in progress (one per thread) for the
+// latency trigger.
+//
+#define TRIGGER_LATENCY_CALLS   4096
+
+//
+// Native exception trigger: exception types (std::type_info) seen by the uprobe on
+// __cxa_throw. The name is the mangled type name, user space matches it against the -f
+// filter and marks the types that don't trigger as ignored so that they are filtered
+// in-kernel from then on. New types are first checked in-kernel against up to
+// TRIGGER_EXCEPTION_FILTERS names that the mangled name has to contain (one per filter).
+//
+#define TRIGGER_EXCEPTION_TYPES 1024
+#define TRIGGER_EXCEPTION_NAME  128
+#define TRIGGER_EXCEPTION_FILTERS 4
+#define TRIGGER_EXCEPTION_FILTER  32
+
+struct ExceptionType
+{
+    char name[TRIGGER_EXCEPTION_NAME];
+    bool ignored;
+};
+
+//
+// Set in the value of a signal event when the target was stopped for the signal, user space
+// continues it once the dump is written.
+//
+#define TRIGGER_SIGNAL_STOPPED  0x100
+
+struct TriggerEvent
+{
+    unsigned int type;
+    unsigned int pid;               // thread that met the condition (procdump's pid namespace)
+    __u64 timestamp;                // bpf_ktime_get_ns (CLOCK_MONOTONIC)
+    __u64 value;                    // CPU: usage (%) over the window, memory: commit (bytes), signal: number, counts: count,
+                                    // probe and syscall error: hits (per second with a rate), latency: duration (ns) of the call,
+                                    // exception: address of the std::type_info of the thrown object
+    int stackId;                    // latency: user stack of the slow thread if it was running (-1 otherwise),
+                                    // syscall error: user stack of the failing thread
+    unsigned int detail;            // syscall error: syscall number (high 16 bits) and errno (low 16 bits)
+};
+
+//
+// For memory resources allocAddress is the address of the allocation, for file descriptors
+// the descriptor and for threads the thread id (in the root pid namespace).
+//
 
 struct ResourceInformation
 {
@@ -29,6 +144,7 @@ struct ResourceInformation
     unsigned int resourceType;
     unsigned long allocSize;
     long callStackLen;
+    __u64 timestamp;                // bpf_ktime_get_ns (CLOCK_MONOTONIC) of the creation
     __u64 stackTrace[MAX_CALL_STACK_FRAMES];
 };
 
@@ -0,0 +1,1061 @@
+/*
+    ProcDump for Linux
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "procdump_trigger_ebpf.h"
+
+//
+// One instance of the program is loaded per trigger and target, user space only loads the
+// programs of that trigger.
+//
+uint dev, inode;
+int targetPid;
+bool isLoggingEnabled;
+bool armed;                         // cleared when an event is sent, user space rearms
+
+//
+// CPU trigger (-c with -cw). The on-cpu time of the target is accumulated in two slots of
+// cpuWindowNs each, the usage is the current slot plus the part of the previous slot that
+// still falls within the rolling window.
+//
+__u64 cpuWindowNs;
+__u64 cpuThreshold;
+__u64 cpuSlotWindow[2];
+__u64 cpuSlotNs[2];
+
+//
+// Memory trigger (-m or -ml with -mh). The memory counters of the target are initialized by
+// user space and kept up to date from the rss_stat events. Once the threshold is crossed, it
+// has to move back by the hysteresis before it can be crossed again.
+//
+__u64 memoryThreshold;
+__u64 memoryHysteresis;
+bool memoryBelow;
+bool memoryCrossed;
+unsigned int memoryMmId;
+__s64 memoryCounters[TRIGGER_MEMORY_COUNTERS];
+
+//
+// Signal trigger (-sig). Bit n-1 of signalMask is set for each signal n to intercept, the
+// bits of signalTerminateMask for the signals whose default action terminates the process.
+//
+__u64 signalMask;
+__u64 signalTerminateMask;
+
+//
+// Thread and file descriptor count triggers (-tc and -fc). The count of the target is seeded
+// by user space and kept up to date from the events that change it.
+//
+__s64 resourceCount;
+__s64 resourceThreshold;
+
+//
+// Probe triggers (-uprobe, -usdt) and syscall error trigger (-se). The trigger fires on the
+// probeHits-th hit since it was armed or, with probeRate, when there are more than probeHits
+// hits per second (counted in two slots of a second like the CPU usage).
+//
+__u64 probeHits;
+bool probeRate;
+__u64 probeCount;
+__u64 probeSlotWindow[2];
+__u64 probeSlotHits[2];
+
+//
+// USDT probe trigger (-usdt), the hits can be filtered on the value of one argument.
+//
+bool probeFilter;
+__u32 probeArgument;
+__s64 probeArgumentValue;
+
+//
+// Latency trigger (-uprobe with -pl). The calls in progress are checked on each tick of the
+// cpu clock (every latencyClockNs) so that a slow call is reported while it's still running.
+//
+__u64 latencyThresholdNs;
+__u64 latencyClockNs;
+
+//
+// Syscall error trigger (-se). Bit n of errorMask is set for each errno n and, unless any
+// syscall is counted, bit n of errorSyscallMask for each syscall n. The errors are counted
+// like the probe hits.
+//
+__u64 errorMask[TRIGGER_ERRNOS / 64];
+bool errorAnySyscall;
+__u64 errorSyscallMask[TRIGGER_SYSCALLS / 64];
+
+//
+// Native exception trigger (-ne). Unless exceptionFilterCount is 0, a new type is only
+// reported if its mangled name contains one of the (lower case) exceptionFilters, user space
+// then matches the demangled name against -f.
+//
+__u32 exceptionFilterCount;
+char exceptionFilters[TRIGGER_EXCEPTION_FILTERS][TRIGGER_EXCEPTION_FILTER];
+
+char LICENSE[] SEC("license") = "Dual BSD/GPL";
+
+// ------------------------------------------------------------------------------------------
+// IsTarget
+//
+// Returns true if the current task belongs to the target process. The pid of the current
+// thread in procdump's pid namespace is returned in pidns.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline bool IsTarget(struct bpf_pidns_info* pidns)
+{
+    if(bpf_get_ns_current_pid_tgid(dev, inode, pidns, sizeof(*pidns)))
+    {
+        return false;
+    }
+
+    return pidns->tgid == targetPid;
+}
+
+// ------------------------------------------------------------------------------------------
+// SendTriggerEventStack
+//
+// Notifies user space that the trigger condition is met, with the id of a stack captured
+// in the stack map of the trigger (-1 if none) and the details of the trigger. Only the
+// first event is sent until user space rearms the trigger. Returns 0 if the event was sent.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int SendTriggerEventStack(unsigned int type, unsigned int pid, __u64 timestamp, __u64 value, int stackId, unsigned int detail)
+{
+    if(armed == false)
+    {
+        return 1;
+    }
+
+    armed = false;
+
+    struct TriggerEvent* event = bpf_ringbuf_reserve(&triggerRingBuffer, sizeof(struct TriggerEvent), 0);
+    if (event == NULL)
+    {
+        BPF_PRINTK("   [SendTriggerEvent] Failed: Reserving event (type: %d, target PID: %d)", type, targetPid);
+        armed = true;
+        return 1;
+    }
+
+    event->type = type;
+    event->pid = pid;
+    event->timestamp = timestamp;
+    event->value = value;
+    event->stackId = stackId;
+    event->detail = detail;
+
+    bpf_ringbuf_submit(event, 0);
+
+    BPF_PRINTK("   [SendTriggerEvent] Success: (type: %d, value: %lu)", type, value);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// SendTriggerEvent
+//
+// Notifies user space that the trigger condition is met (without a stack).
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int SendTriggerEvent(unsigned int type, unsigned int pid, __u64 timestamp, __u64 value)
+{
+    return SendTriggerEventStack(type, pid, timestamp, value, -1, 0);
+}
+
+// ------------------------------------------------------------------------------------------
+// SendTriggerEventStop
+//
+// Stops the target (SIGSTOP) and notifies user space, which continues it once the dump is
+// written. The target is stopped before the event is visible so that user space can't
+// continue it first, and at most once until user space continued it (concurrent events
+// are dropped). Returns 0 if the target was stopped and the event sent.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int SendTriggerEventStop(unsigned int type, unsigned int pid, __u64 timestamp, __u64 value, int stackId, unsigned int detail)
+{
+    __u32 key = 0;
+    __u32 stopped = 1;
+
+    if(armed == false || bpf_map_update_elem(&targetStoppedMap, &key, &stopped, BPF_NOEXIST) != 0)
+    {
+        return 1;
+    }
+
+    long ret = bpf_send_signal(SIGSTOP);
+    if(ret != 0)
+    {
+        BPF_PRINTK("   [SendTriggerEventStop] Failed: Stopping target (type: %d, error: %ld)", type, ret);
+        bpf_map_delete_elem(&targetStoppedMap, &key);
+        return 1;
+    }
+
+    //
+    // Nothing would continue the target without the event, the pending SIGSTOP is discarded
+    // by SIGCONT.
+    //
+    if(SendTriggerEventStack(type, pid, timestamp, value, stackId, detail) != 0)
+    {
+        bpf_send_signal(SIGCONT);
+        bpf_map_delete_elem(&targetStoppedMap, &key);
+        return 1;
+    }
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// AccountCpu
+//
+// Accounts the time since the cpu was last accounted for to the task that ran in between
+// (the current task) and checks the CPU threshold if it belongs to the target.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int AccountCpu()
+{
+    struct bpf_pidns_info pidns = {};
+    __u32 zero = 0;
+
+    struct CpuState* state = bpf_map_lookup_elem(&cpuStateMap, &zero);
+    if (state == NULL || cpuWindowNs == 0)
+    {
+        return 0;
+    }
+
+    __u64 now = bpf_ktime_get_ns();
+    __u64 last = state->lastAccounted;
+    state->lastAccounted = now;
+
+    if (last == 0 || IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    __u64 delta = now - last;
+    if (delta > cpuWindowNs)
+    {
+        delta = cpuWindowNs;
+    }
+
+    //
+    // Another cpu might reset the slot at the same time, the little time lost that way
+    // doesn't matter for a threshold.
+    //
+    __u64 window = now / cpuWindowNs;
+    __u32 slot = window & 1;
+    if (cpuSlotWindow[slot] != window)
+    {
+        cpuSlotWindow[slot] = window;
+        cpuSlotNs[slot] = 0;
+    }
+
+    __sync_fetch_and_add(&cpuSlotNs[slot], delta);
+
+    //
+    // Weigh the previous slot in microseconds so that long windows can't overflow
+    //
+    __u64 windowUs = cpuWindowNs / 1000;
+    __u64 remainingUs = windowUs - (now - window * cpuWindowNs) / 1000;
+    __u64 previousUs = cpuSlotWindow[slot ^ 1] == window - 1 ? cpuSlotNs[slot ^ 1] / 1000 : 0;
+    __u64 onCpuUs = cpuSlotNs[slot] / 1000 + (windowUs > 0 ? previousUs * remainingUs / windowUs : 0);
+    __u64 usage = windowUs > 0 ? onCpuUs * 100 / windowUs : 0;
+
+    if (usage >= cpuThreshold)
+    {
+        return SendTriggerEvent(TRIGGER_CPU, pidns.pid, now, usage);
+    }
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// sched_switch
+//
+// The previous task (current) is switched out, it ran since the cpu was last accounted for.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/sched/sched_switch")
+int sched_switch(struct trace_event_raw_sched_switch *ctx)
+{
+    return AccountCpu();
+}
+
+// ------------------------------------------------------------------------------------------
+// cpu_clock
+//
+// Periodic tick on every cpu (a fraction of the window) so that threads that are not
+// switched out for a long time are still accounted for in time.
+// ------------------------------------------------------------------------------------------
+SEC("perf_event")
+int cpu_clock(struct bpf_perf_event_data *ctx)
+{
+    return AccountCpu();
+}
+
+// ------------------------------------------------------------------------------------------
+// rss_stat
+//
+// A memory counter of a process changed. The events of the target are recognized by the
+// hashed mm id, which is learnt from the events raised by the target itself so that changes
+// made by other tasks (for example, swapping by kswapd) are included.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/kmem/rss_stat")
+int rss_stat(struct trace_event_raw_rss_stat *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    unsigned int mmId = ctx->mm_id;
+    int member = ctx->member;
+
+    if (ctx->curr != 0 && IsTarget(&pidns) == true)
+    {
+        memoryMmId = mmId;
+    }
+    else if (memoryMmId == 0 || mmId != memoryMmId)
+    {
+        return 0;
+    }
+
+    if (member < 0 || member >= TRIGGER_MEMORY_COUNTERS)
+    {
+        return 0;
+    }
+
+    memoryCounters[member & (TRIGGER_MEMORY_COUNTERS - 1)] = ctx->size;
+
+    __s64 total = 0;
+    for (int i = 0; i < TRIGGER_MEMORY_COUNTERS; i++)
+    {
+        total += memoryCounters[i];
+    }
+
+    __u64 usage = total > 0 ? total : 0;
+    bool bMet = memoryBelow ? usage < memoryThreshold : usage >= memoryThreshold;
+
+    if (bMet == true)
+    {
+        if (memoryCrossed == false && armed == true)
+        {
+            memoryCrossed = true;
+            return SendTriggerEvent(TRIGGER_MEMORY, pidns.pid, bpf_ktime_get_ns(), usage);
+        }
+    }
+    else if (memoryBelow ? usage >= memoryThreshold + memoryHysteresis : usage + memoryHysteresis < memoryThreshold)
+    {
+        memoryCrossed = false;
+    }
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// signal_deliver
+//
+// A signal is about to be handled by a thread of the current process. If it's one of the
+// signals to intercept, the process is stopped so that the dump shows it at the start of the
+// handler. A signal without handler whose default action terminates the process can't be
+// held, the event is still sent so that user space can report it.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/signal/signal_deliver")
+int signal_deliver(struct trace_event_raw_signal_deliver *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    int sig = ctx->sig;
+
+    if (sig < 1 || sig > 64 || (signalMask & (1ULL << (sig - 1))) == 0)
+    {
+        return 0;
+    }
+
+    if (armed == false || IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    bool bStop = ctx->sa_handler != SIG_DFL || (signalTerminateMask & (1ULL << (sig - 1))) == 0;
+    __u64 value = bStop ? sig | TRIGGER_SIGNAL_STOPPED : sig;
+
+    if (bStop == true)
+    {
+        return SendTriggerEventStop(TRIGGER_SIGNAL, pidns.pid, bpf_ktime_get_ns(), value, -1, 0);
+    }
+
+    return SendTriggerEvent(TRIGGER_SIGNAL, pidns.pid, bpf_ktime_get_ns(), value);
+}
+
+// ------------------------------------------------------------------------------------------
+// UpdateResourceCount
+//
+// Applies a change to the thread or file descriptor count of the target and checks the
+// threshold when it grows.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int UpdateResourceCount(unsigned int type, unsigned int pid, __s64 delta)
+{
+    __sync_fetch_and_add(&resourceCount, delta);
+
+    __s64 count = resourceCount;
+    if (delta > 0 && count >= resourceThreshold)
+    {
+        return SendTriggerEvent(type, pid, bpf_ktime_get_ns(), count);
+    }
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// task_newtask
+//
+// A task was created by the current task, it's a new thread of the target if the creator
+// belongs to the target and the thread group is shared.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/task/task_newtask")
+int task_newtask(struct trace_event_raw_task_newtask *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+
+    if ((ctx->clone_flags & CLONE_THREAD) == 0 || IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    return UpdateResourceCount(TRIGGER_THREAD_COUNT, pidns.pid, 1);
+}
+
+// ------------------------------------------------------------------------------------------
+// sched_process_exit
+//
+// The current task exits.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/sched/sched_process_exit")
+int sched_process_exit(struct trace_event_raw_sched_process_template *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+
+    if (IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    return UpdateResourceCount(TRIGGER_THREAD_COUNT, pidns.pid, -1);
+}
+
+// ------------------------------------------------------------------------------------------
+// CountOpenFds
+//
+// Counts the open descriptors of the current process from first to last (inclusive) in the
+// bitmap of its descriptor table. Only the first TRIGGER_FD_BITMAP_WORDS words of the range
+// are scanned.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline __s64 CountOpenFds(__u64 first, __u64 last)
+{
+    struct task_struct* task = (struct task_struct*) bpf_get_current_task();
+    struct files_struct* files = BPF_CORE_READ(task, files);
+    struct fdtable* fdt = BPF_CORE_READ(files, fdt);
+    unsigned int maxFds = BPF_CORE_READ(fdt, max_fds);
+    unsigned long* openFds = BPF_CORE_READ(fdt, open_fds);
+    __s64 count = 0;
+
+    if (openFds == NULL || first >= maxFds)
+    {
+        return 0;
+    }
+
+    if (last >= maxFds)
+    {
+        last = maxFds - 1;
+    }
+
+    for (__u64 i = 0; i < TRIGGER_FD_BITMAP_WORDS; i++)
+    {
+        __u64 word = first / 64 + i;
+        unsigned long bits = 0;
+
+        if (word > last / 64 || bpf_probe_read_kernel(&bits, sizeof(bits), openFds + word) != 0)
+        {
+            break;
+        }
+
+        if (word == first / 64)
+        {
+            bits &= ~0UL << (first % 64);
+        }
+        if (word == last / 64 && last % 64 != 63)
+        {
+            bits &= (1UL << (last % 64 + 1)) - 1;
+        }
+
+        count += __builtin_popcountl(bits);
+    }
+
+    return count;
+}
+
+// ------------------------------------------------------------------------------------------
+// CountReceivedFds
+//
+// Counts the descriptors received in the SCM_RIGHTS control messages of a msghdr once
+// recvmsg returned (the kernel updated msg_controllen).
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline __s64 CountReceivedFds(__u64 msg)
+{
+    struct user_msghdr hdr = {};
+    __u64 offset = 0;
+    __s64 count = 0;
+
+    if (bpf_probe_read_user(&hdr, sizeof(hdr), (void*) msg) != 0 || hdr.msg_control == NULL)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < TRIGGER_FD_CMSGS; i++)
+    {
+        struct cmsghdr cmsg = {};
+
+        if (offset + sizeof(cmsg) > hdr.msg_controllen ||
+            bpf_probe_read_user(&cmsg, sizeof(cmsg), (char*) hdr.msg_control + offset) != 0 ||
+            cmsg.cmsg_len < sizeof(cmsg))
+        {
+            break;
+        }
+
+        if (cmsg.cmsg_level == SOL_SOCKET && cmsg.cmsg_type == SCM_RIGHTS)
+        {
+            count += (cmsg.cmsg_len - sizeof(cmsg)) / sizeof(int);
+        }
+
+        offset += (cmsg.cmsg_len + sizeof(long) - 1) & ~(sizeof(long) - 1);
+    }
+
+    return count;
+}
+
+// ------------------------------------------------------------------------------------------
+// sys_enter
+//
+// A syscall is entered. For the syscalls whose change of the descriptor count depends on
+// their arguments, the change is worked out now and kept until the syscall returns: fcntl
+// only creates a descriptor for F_DUPFD(_CLOEXEC), dup2 and dup3 only onto a free slot and
+// close_range closes the open descriptors in its range unless it only sets close-on-exec.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/raw_syscalls/sys_enter")
+int sys_enter(struct trace_event_raw_sys_enter *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    struct FdSyscallArgs args = {};
+    __u32 id = ctx->id;
+
+    if (id >= TRIGGER_FD_SYSCALLS)
+    {
+        return 0;
+    }
+
+    int* delta = bpf_map_lookup_elem(&fdSyscallMap, &id);
+    if (delta == NULL || *delta < TRIGGER_FD_FCNTL || IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    switch (*delta)
+    {
+        case TRIGGER_FD_FCNTL:
+            args.delta = ctx->args[1] == F_DUPFD || ctx->args[1] == F_DUPFD_CLOEXEC;
+            break;
+
+        case TRIGGER_FD_DUP2:
+            args.delta = (unsigned int) ctx->args[0] != (unsigned int) ctx->args[1] && CountOpenFds((unsigned int) ctx->args[1], (unsigned int) ctx->args[1]) == 0;
+            break;
+
+        case TRIGGER_FD_CLOSE_RANGE:
+            if ((ctx->args[2] & CLOSE_RANGE_CLOEXEC) == 0)
+            {
+                args.delta = -CountOpenFds((unsigned int) ctx->args[0], (unsigned int) ctx->args[1]);
+            }
+            break;
+
+        case TRIGGER_FD_RECVMSG:
+            args.msg = ctx->args[1];
+            break;
+    }
+
+    if (args.delta != 0 || args.msg != 0)
+    {
+        bpf_map_update_elem(&fdSyscallArgsMap, &pidns.pid, &args, BPF_ANY);
+    }
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// sys_exit
+//
+// A syscall returns. Syscalls returning a descriptor add one on success, the ones returning
+// a pair of descriptors or closing one return 0 on success. The change of the syscalls that
+// depend on their arguments was worked out on entry.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/raw_syscalls/sys_exit")
+int sys_exit(struct trace_event_raw_sys_exit *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    __u32 id = ctx->id;
+
+    if (id >= TRIGGER_FD_SYSCALLS)
+    {
+        return 0;
+    }
+
+    int* delta = bpf_map_lookup_elem(&fdSyscallMap, &id);
+    if (delta == NULL || *delta == 0)
+    {
+        return 0;
+    }
+
+    if (*delta >= TRIGGER_FD_FCNTL)
+    {
+        if (IsTarget(&pidns) == false)
+        {
+            return 0;
+        }
+
+        struct FdSyscallArgs* args = bpf_map_lookup_elem(&fdSyscallArgsMap, &pidns.pid);
+        if (args == NULL)
+        {
+            return 0;
+        }
+
+        __s64 change = args->delta;
+        __u64 msg = args->msg;
+        bpf_map_delete_elem(&fdSyscallArgsMap, &pidns.pid);
+
+        if (ctx->ret < 0)
+        {
+            return 0;
+        }
+
+        if (msg != 0)
+        {
+            change = CountReceivedFds(msg);
+        }
+
+        return change != 0 ? UpdateResourceCount(TRIGGER_FD_COUNT, pidns.pid, change) : 0;
+    }
+
+    if (ctx->ret < 0 || (*delta != 1 && ctx->ret != 0))
+    {
+        return 0;
+    }
+
+    if (IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    return UpdateResourceCount(TRIGGER_FD_COUNT, pidns.pid, *delta);
+}
+
+// ------------------------------------------------------------------------------------------
+// CountHit
+//
+// Counts a hit of the probe (or syscall error) and returns true if the hit count or rate is
+// reached. The count or rate is returned in value.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline bool CountHit(__u64 now, __u64* value)
+{
+    if (probeRate == false)
+    {
+        __sync_fetch_and_add(&probeCount, 1);
+        *value = probeCount;
+        return probeCount >= probeHits;
+    }
+
+    __u64 window = now / NSEC_PER_SEC;
+    __u32 slot = window & 1;
+    if (probeSlotWindow[slot] != window)
+    {
+        probeSlotWindow[slot] = window;
+        probeSlotHits[slot] = 0;
+    }
+
+    __sync_fetch_and_add(&probeSlotHits[slot], 1);
+
+    //
+    // The previous slot counts for the part of it that still falls within the last second
+    //
+    __u64 remainingNs = NSEC_PER_SEC - (now - window * NSEC_PER_SEC);
+    __u64 previous = probeSlotWindow[slot ^ 1] == window - 1 ? probeSlotHits[slot ^ 1] : 0;
+    *value = probeSlotHits[slot] + previous * (remainingNs / 1000) / (NSEC_PER_SEC / 1000);
+
+    return *value > probeHits;
+}
+
+// ------------------------------------------------------------------------------------------
+// CountProbeHit
+//
+// Counts a hit of the probe in the target and reports it if the hit count or rate is reached.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline int CountProbeHit()
+{
+    struct bpf_pidns_info pidns = {};
+    __u64 value = 0;
+
+    if (IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    __u64 now = bpf_ktime_get_ns();
+    if (CountHit(now, &value) == false)
+    {
+        return 0;
+    }
+
+    return SendTriggerEvent(TRIGGER_PROBE, pidns.pid, now, value);
+}
+
+// ------------------------------------------------------------------------------------------
+// uprobe_hit
+//
+// The function specified with -uprobe is called, user space attaches the probe.
+// ------------------------------------------------------------------------------------------
+SEC("uprobe")
+int BPF_KPROBE(uprobe_hit)
+{
+    return CountProbeHit();
+}
+
+// ------------------------------------------------------------------------------------------
+// usdt_hit
+//
+// The USDT probe specified with -usdt is hit, user space attaches the probe. Hits where the
+// filtered argument has another value are not counted.
+// ------------------------------------------------------------------------------------------
+SEC("usdt")
+int usdt_hit(struct pt_regs* ctx)
+{
+    if(probeFilter == true)
+    {
+        long value = 0;
+        if(bpf_usdt_arg(ctx, probeArgument, &value) != 0 || value != probeArgumentValue)
+        {
+            return 0;
+        }
+    }
+
+    return CountProbeHit();
+}
+
+// ------------------------------------------------------------------------------------------
+// latency_entry
+//
+// The function specified with -uprobe is called, the outermost call of each thread is timed.
+// ------------------------------------------------------------------------------------------
+SEC("uprobe")
+int BPF_KPROBE(latency_entry)
+{
+    struct bpf_pidns_info pidns = {};
+
+    if (IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    __u32 tid = pidns.pid;
+    struct LatencyCall* call = bpf_map_lookup_elem(&latencyCallMap, &tid);
+    if (call != NULL)
+    {
+        call->depth++;
+        return 0;
+    }
+
+    struct LatencyCall newCall = {};
+    newCall.entry = bpf_ktime_get_ns();
+    newCall.depth = 1;
+    if (bpf_map_update_elem(&latencyCallMap, &tid, &newCall, BPF_ANY) != 0)
+    {
+        BPF_PRINTK("   [latency_entry] Failed: Adding call of thread %d", tid);
+    }
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// latency_return
+//
+// The function specified with -uprobe returns. A slow call is normally reported by the cpu
+// clock while it's running, calls that return between two ticks are reported here.
+// ------------------------------------------------------------------------------------------
+SEC("uretprobe")
+int BPF_KRETPROBE(latency_return)
+{
+    struct bpf_pidns_info pidns = {};
+
+    if (IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    __u32 tid = pidns.pid;
+    struct LatencyCall* call = bpf_map_lookup_elem(&latencyCallMap, &tid);
+    if (call == NULL)
+    {
+        return 0;
+    }
+
+    if (call->depth > 1)
+    {
+        call->depth--;
+        return 0;
+    }
+
+    __u64 now = bpf_ktime_get_ns();
+    __u64 duration = now - call->entry;
+    bool reported = call->reported;
+
+    bpf_map_delete_elem(&latencyCallMap, &tid);
+
+    if (reported == false && duration >= latencyThresholdNs)
+    {
+        return SendTriggerEvent(TRIGGER_LATENCY, tid, now, duration);
+    }
+
+    return 0;
+}
+
+struct LatencyScan
+{
+    __u64 now;
+};
+
+// ------------------------------------------------------------------------------------------
+// CheckLatencyCall
+//
+// Reports the first call in progress over the threshold (bpf_for_each_map_elem callback).
+// The threshold is extended by a tick so that a running thread is reported by the cpu clock
+// of its own cpu, with its stack.
+// ------------------------------------------------------------------------------------------
+static long CheckLatencyCall(struct bpf_map* map, __u32* tid, struct LatencyCall* call, struct LatencyScan* scan)
+{
+    //
+    // The call may have started on another cpu after the scan did
+    //
+    if (call->reported == true || call->entry > scan->now || scan->now - call->entry < latencyThresholdNs + latencyClockNs)
+    {
+        return 0;
+    }
+
+    call->reported = true;
+    SendTriggerEvent(TRIGGER_LATENCY, *tid, scan->now, scan->now - call->entry);
+    return 1;
+}
+
+// ------------------------------------------------------------------------------------------
+// latency_clock
+//
+// Periodic tick on every cpu that checks the calls in progress. If the interrupted thread is
+// in a slow call, its user stack is captured before the event is sent.
+// ------------------------------------------------------------------------------------------
+SEC("perf_event")
+int latency_clock(struct bpf_perf_event_data *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+
+    if (armed == false)
+    {
+        return 0;
+    }
+
+    __u64 now = bpf_ktime_get_ns();
+    if (IsTarget(&pidns) == true)
+    {
+        __u32 tid = pidns.pid;
+        struct LatencyCall* call = bpf_map_lookup_elem(&latencyCallMap, &tid);
+        if (call != NULL && call->reported == false && now - call->entry >= latencyThresholdNs)
+        {
+            call->reported = true;
+            int stackId = bpf_get_stackid(ctx, &triggerStackMap, BPF_F_USER_STACK | BPF_F_REUSE_STACKID);
+            return SendTriggerEventStack(TRIGGER_LATENCY, tid, now, now - call->entry, stackId, 0);
+        }
+    }
+
+    struct LatencyScan scan = { now };
+    bpf_for_each_map_elem(&latencyCallMap, CheckLatencyCall, &scan, 0);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// latency_exit
+//
+// A thread of the target exits, possibly in the middle of a call.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/sched/sched_process_exit")
+int latency_exit(struct trace_event_raw_sched_process_template *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+
+    if (IsTarget(&pidns) == true)
+    {
+        __u32 tid = pidns.pid;
+        bpf_map_delete_elem(&latencyCallMap, &tid);
+    }
+
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// syscall_error
+//
+// A syscall returns. Errors of the target that match the errno (and syscall) filter are
+// counted, the user stack of the failing thread is captured with the event.
+// ------------------------------------------------------------------------------------------
+SEC("tracepoint/raw_syscalls/sys_exit")
+int syscall_error(struct trace_event_raw_sys_exit *ctx)
+{
+    struct bpf_pidns_info pidns = {};
+    __u64 value = 0;
+    long ret = ctx->ret;
+    __u32 id = ctx->id;
+
+    if (ret >= 0 || ret <= -TRIGGER_ERRNOS || id >= TRIGGER_SYSCALLS)
+    {
+        return 0;
+    }
+
+    __u32 error = -ret;
+    if ((errorMask[error / 64] & (1ULL << (error % 64))) == 0)
+    {
+        return 0;
+    }
+
+    if (errorAnySyscall == false && (errorSyscallMask[id / 64] & (1ULL << (id % 64))) == 0)
+    {
+        return 0;
+    }
+
+    if (IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    __u64 now = bpf_ktime_get_ns();
+    if (CountHit(now, &value) == false || armed == false)
+    {
+        return 0;
+    }
+
+    int stackId = bpf_get_stackid(ctx, &triggerStackMap, BPF_F_USER_STACK | BPF_F_REUSE_STACKID);
+    return SendTriggerEventStack(TRIGGER_SYSCALL_ERROR, pidns.pid, now, value, stackId, id << 16 | error);
+}
+
+// ------------------------------------------------------------------------------------------
+// MatchesExceptionFilters
+//
+// Returns true if the mangled name of a new exception type contains one of the exception
+// filters (case insensitive like the -f match), or if there are no filters.
+// ------------------------------------------------------------------------------------------
+__attribute__((always_inline))
+static inline bool MatchesExceptionFilters(const char* name)
+{
+    if (exceptionFilterCount == 0)
+    {
+        return true;
+    }
+
+    for (__u32 filter = 0; filter < TRIGGER_EXCEPTION_FILTERS && filter < exceptionFilterCount; filter++)
+    {
+        for (int start = 0; start < TRIGGER_EXCEPTION_NAME && name[start] != '\0'; start++)
+        {
+            for (int i = 0; i < TRIGGER_EXCEPTION_FILTER; i++)
+            {
+                char expected = exceptionFilters[filter][i];
+                if (expected == '\0')
+                {
+                    return true;
+                }
+
+                char c = start + i < TRIGGER_EXCEPTION_NAME ? name[(start + i) & (TRIGGER_EXCEPTION_NAME - 1)] : '\0';
+                if (c >= 'A' && c <= 'Z')
+                {
+                    c += 'a' - 'A';
+                }
+
+                if (c != expected)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------
+// cxa_throw
+//
+// A C++ exception is thrown, user space attaches the probe to __cxa_throw of the C++
+// runtime. The name of the type is recorded the first time it's thrown and the types that
+// can't match the exception filters are ignored right away. Types that user space marked as
+// ignored (no match for -f or no dumps left) are filtered out too. The whole process is
+// stopped at the throw site so that the dump shows the stack of the thread, which also
+// happens once for each new type that passed the exception filters until user space has
+// matched it.
+// ------------------------------------------------------------------------------------------
+SEC("uprobe")
+int BPF_KPROBE(cxa_throw, void* thrownException, void* typeInfo)
+{
+    struct bpf_pidns_info pidns = {};
+    __u64 key = (__u64) typeInfo;
+
+    if (armed == false || IsTarget(&pidns) == false)
+    {
+        return 0;
+    }
+
+    struct ExceptionType* exceptionType = bpf_map_lookup_elem(&exceptionTypeMap, &key);
+    if (exceptionType == NULL)
+    {
+        struct ExceptionType newType = {};
+        const char* name = NULL;
+
+        // std::type_info is the vtable pointer followed by the name
+        long len = 0;
+        if (bpf_probe_read_user(&name, sizeof(name), (char*) typeInfo + sizeof(void*)) != 0 ||
+            (len = bpf_probe_read_user_str(newType.name, sizeof(newType.name), name)) < 0)
+        {
+            BPF_PRINTK("   [cxa_throw] Failed: Reading type name (type_info: %lx)", key);
+            return 0;
+        }
+
+        // Truncated names are left to user space
+        newType.ignored = len < sizeof(newType.name) && MatchesExceptionFilters(newType.name) == false;
+
+        if (bpf_map_update_elem(&exceptionTypeMap, &key, &newType, BPF_NOEXIST) != 0)
+        {
+            BPF_PRINTK("   [cxa_throw] Failed: Adding exception type (type_info: %lx)", key);
+        }
+
+        exceptionType = bpf_map_lookup_elem(&exceptionTypeMap, &key);
+        if (exceptionType == NULL)
+        {
+            return 0;
+        }
+    }
+
+    if (exceptionType->ignored == true)
+    {
+        return 0;
+    }
+
+    int stackId = bpf_get_stackid(ctx, &triggerStackMap, BPF_F_USER_STACK | BPF_F_REUSE_STACKID);
+    return SendTriggerEventStop(TRIGGER_EXCEPTION, pidns.pid, bpf_ktime_get_ns(), key, stackId, 0);
+}
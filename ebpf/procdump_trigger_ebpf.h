@@ -0,0 +1,163 @@
+/*
+    ProcDump for Linux
+
+    Copyright (c) Microsoft Corporation
+
+    All rights reserved.
+
+    MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef __PROCDUMP_TRIGGER_EBPF_H__
+#define __PROCDUMP_TRIGGER_EBPF_H__
+
+#include "vmlinux.h"
+#include <bpf_helpers.h>
+#include <bpf_tracing.h>
+#include <bpf_core_read.h>
+#include <usdt.bpf.h>
+
+#include "procdump_ebpf_common.h"
+
+#define TRIGGER_RING_BUFFER_SIZE (256 * 1024)
+
+#define SIG_DFL 0
+#define SIGSTOP 19
+#define SIGCONT 18
+#define CLONE_THREAD 0x00010000
+#define F_DUPFD 0
+#define F_DUPFD_CLOEXEC 1030
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#define SOL_SOCKET 1
+#define SCM_RIGHTS 1
+#define NSEC_PER_SEC 1000000000ULL
+
+#define BPF_PRINTK( format, ... ) \
+    if(isLoggingEnabled == true) \
+    { \
+        char fmt[] = format; \
+        bpf_trace_printk(fmt, sizeof(fmt), ##__VA_ARGS__ ); \
+    }
+
+//
+// The ring buffer used to notify user space when a trigger condition is met. Events are
+// rare so it's kept small.
+//
+struct
+{
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, TRIGGER_RING_BUFFER_SIZE);
+} triggerRingBuffer SEC(".maps");
+
+//
+// Triggers that stop the target until the dump is written (signal and exception): the entry
+// exists while the target is stopped for an event. Adding it is how a program claims the
+// stop, user space removes it once it continued the target.
+//
+struct
+{
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u32);
+} targetStoppedMap SEC(".maps");
+
+//
+// CPU trigger: time (ns) at which the cpu was last accounted for, either on a context switch
+// or on a tick of the cpu clock.
+//
+struct CpuState
+{
+    __u64 lastAccounted;
+};
+
+struct
+{
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct CpuState);
+} cpuStateMap SEC(".maps");
+
+//
+// File descriptor count trigger: change of the file descriptor count on success of each
+// syscall, filled by user space since syscall numbers are architecture specific.
+//
+struct
+{
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, TRIGGER_FD_SYSCALLS);
+    __type(key, __u32);
+    __type(value, int);
+} fdSyscallMap SEC(".maps");
+
+//
+// File descriptor count trigger: change of the count worked out on entry of the syscalls
+// that depend on their arguments, by thread, until they return. recvmsg keeps the address
+// of its msghdr instead, the descriptors received are only known on return.
+//
+struct FdSyscallArgs
+{
+    __s64 delta;
+    __u64 msg;
+};
+
+struct
+{
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, TRIGGER_FD_CALLS);
+    __type(key, __u32);
+    __type(value, struct FdSyscallArgs);
+} fdSyscallArgsMap SEC(".maps");
+
+//
+// Latency trigger: call of the -uprobe function in progress by thread. Recursive calls are
+// part of the outermost call.
+//
+struct LatencyCall
+{
+    __u64 entry;
+    __u32 depth;
+    bool reported;
+};
+
+struct
+{
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, TRIGGER_LATENCY_CALLS);
+    __type(key, __u32);
+    __type(value, struct LatencyCall);
+} latencyCallMap SEC(".maps");
+
+//
+// Native exception trigger: exception types thrown by the target, keyed by the address of
+// their std::type_info. The least recently thrown types are evicted once it's full, they
+// are checked again if they are thrown again.
+//
+struct
+{
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, TRIGGER_EXCEPTION_TYPES);
+    __type(key, __u64);
+    __type(value, struct ExceptionType);
+} exceptionTypeMap SEC(".maps");
+
+//
+// User stack of the thread reported by the event (latency, syscall error and exception
+// triggers). It's captured just before the event is sent and replaced by the next one.
+//
+struct
+{
+    __uint(type, BPF_MAP_TYPE_STACK_TRACE);
+    __uint(max_entries, 1);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, MAX_CALL_STACK_FRAMES * sizeof(__u64));
+} triggerStackMap SEC(".maps");
+
+#endif // __PROCDUMP_TRIGGER_EBPF_H__
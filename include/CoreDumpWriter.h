@@ -31,6 +31,10 @@
 #define CORECLR_DUMPTYPE_FULL 4
 #define CORECLR_DUMPLOGGING_OFF 0
 #define CORECLR_DIAG_IPCHEADER_SIZE 24
+#define CORECLR_DIAG_PROCESS_COMMANDSET 0x04
+#define CORECLR_DIAG_ENABLE_PERFMAP 0x05
+#define CORECLR_DIAG_DISABLE_PERFMAP 0x06
+#define CORECLR_PERFMAPTYPE_PERFMAP 3
 
 // Magic version for the IpcHeader struct
 struct MagicVersion
@@ -73,6 +77,10 @@ enum ECoreDumpType {
     SIGNAL,                 // trigger on signal
     TIME,                   // trigger on time interval
     EXCEPTION,              // trigger on exception
+    RESTRACK,               // trigger on restrack outstanding allocations
+    CRASH,                  // trigger on fatal signal
+    PROBE,                  // trigger on probe hits
+    SYSCALL,                // trigger on syscall errors
     MANUAL                  // manual trigger
 };
 
@@ -16,5 +16,7 @@
 
 bool IsCoreClrProcess(pid_t pid, char** socketName);
 bool GenerateCoreClrDump(char* socketName, char* dumpFileName);
+bool IsCoreClrPerfMapEnabled(pid_t pid);
+bool SetCoreClrPerfMap(char* socketName, bool bEnable);
 
 #endif // DOTNETHELPERS_H
\ No newline at end of file
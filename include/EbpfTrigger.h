@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// EbpfTrigger.h
+//
+// Triggers evaluated in-kernel by the trigger eBPF program. User space
+// is only woken up when the trigger condition is met.
+//
+//--------------------------------------------------------------------
+
+#ifndef EBPFTRIGGER_H
+#define EBPFTRIGGER_H
+
+#ifdef __linux__
+#include <pthread.h>
+#include <vector>
+#include <string>
+
+#include "Handle.h"
+#include "procdump_ebpf_common.h"
+
+#define MIN_CPU_WINDOW      10          // -cw (ms)
+#define MAX_CPU_WINDOW      10000
+#define MAX_USDT_ARGUMENTS  12          // -pa (BPF_USDT_MAX_ARG_CNT)
+#define MIN_LATENCY_CLOCK   1           // -pl check period (ms)
+#define MAX_LATENCY_CLOCK   100
+#define FD_COUNT_RESYNC_INTERVAL 60000  // -fc procfs resync (ms)
+
+struct EbpfTrigger
+{
+    unsigned int type;
+    struct ProcDumpConfiguration* config;
+    struct procdump_trigger_ebpf* skel;
+    struct ring_buffer* ringBuffer;
+    std::vector<struct bpf_link*> links;
+    pthread_t pollingThread;
+    bool bStop;
+
+    //
+    // Signaled when an event is received or monitoring should stop (manual reset, the
+    // monitor thread resets it before taking the event). The pending event is protected by
+    // eventMutex.
+    //
+    struct Handle evtTriggered;
+    pthread_mutex_t eventMutex;
+    bool bEventPending;
+    struct TriggerEvent pendingEvent;
+};
+
+struct EbpfTrigger* StartEbpfTrigger(struct ProcDumpConfiguration* config, unsigned int type);
+void StopEbpfTrigger(struct EbpfTrigger* trigger);
+bool GetEbpfTriggerEvent(struct EbpfTrigger* trigger, struct TriggerEvent* event);
+void RearmEbpfTrigger(struct EbpfTrigger* trigger);
+void ResyncEbpfTrigger(struct EbpfTrigger* trigger);
+void ContinueEbpfTriggerTarget(struct EbpfTrigger* trigger);
+void LogEbpfTriggerStack(struct EbpfTrigger* trigger, struct TriggerEvent* event);
+bool GetEbpfTriggerExceptionType(struct EbpfTrigger* trigger, struct TriggerEvent* event, std::string& name);
+void IgnoreEbpfTriggerExceptionType(struct EbpfTrigger* trigger, struct TriggerEvent* event);
+#endif
+
+#endif // EBPFTRIGGER_H
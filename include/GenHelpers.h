@@ -113,9 +113,15 @@ static inline void cancel_pthread(unsigned long* val)
 #define auto_free_file __attribute__ ((__cleanup__(cleanup_file)))
 #define auto_cancel_thread __attribute__ ((__cleanup__(cancel_pthread)))
 
-int* GetSeparatedValues(char* src, char* separator, int* numValues);
 bool ConvertToInt(const char* src, int* conv);
 bool ConvertToIntHex(const char* src, int* conv);
+int* GetSeparatedValues(char* src, char* separator, int* numValues, bool (*convert)(const char* src, int* conv) = ConvertToInt);
+#ifdef __linux__
+bool ConvertToErrno(const char* src, int* conv);
+bool ConvertToSyscall(const char* src, int* conv);
+const char* GetErrnoName(int error);
+const char* GetSyscallName(int syscall);
+#endif
 bool IsValidNumberArg(const char *arg);
 bool CheckKernelVersion(int major, int minor);
 uint16_t* GetUint16(char* buffer);
@@ -11,6 +11,9 @@
 #include "DotnetHelpers.h"
 #include "ProfilerHelpers.h"
 #include "Restrack.h"
+#include "RestrackOutput.h"
+#include "RestrackCapture.h"
+#include "EbpfTrigger.h"
 #include "ProcDumpVersion.h"
 
 
@@ -17,6 +17,15 @@
 #include "ProcDumpConfiguration.h"
 
 #define MAX_PROFILER_CONNECTIONS    50
+#define CRASH_WAKE_SIGNAL           (SIGRTMIN + 1)  // interrupts the waitpid of the crash monitor on quit
+#define CRASH_WAKE_INTERVAL         100             // ms between wake signals until the crash monitor is done
+
+struct CrashWake
+{
+    struct ProcDumpConfiguration *config;
+    pid_t tid;                      // crash monitoring thread
+    struct Handle evtDone;          // set once it no longer waits for its tracees
+};
 
 // Monitor functions
 void MonitorProcesses(struct ProcDumpConfiguration*self);
@@ -41,12 +50,21 @@ bool ExitProcessMonitor(struct ProcDumpConfiguration* config, pthread_t processM
 // Monitor worker threads
 void *CommitMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *CpuMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *CpuEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *CommitEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *SignalEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *ThreadCountEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *FileDescriptorCountEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *ThreadCountMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *FileDescriptorCountMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *SignalMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *CrashMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *ProbeMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *NativeExceptionMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *TimerThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *DotNetMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *RestrackThread(void *thread_args /* struct ProcDumpConfiguration* */);
+void *RestrackMemoryMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */);
 void *ProcessMonitor(void *thread_args /* struct ProcDumpConfiguration* */);
 void *WaitForProfilerCompletion(void *thread_args /* struct ProcDumpConfiguration* */);
 
@@ -40,6 +40,7 @@
 #endif
 
 #include <unordered_map>
+#include <string>
 
 #define MAX_TRIGGERS 10
 #define NO_PID INT_MAX
@@ -120,6 +121,7 @@ struct ProcDumpConfiguration
     int FileDescriptorThreshold;    // -fc
     int* SignalNumber;              // -sig
     int SignalCount;
+    bool bDumpOnCrash;              // -crash
     int PollingInterval;            // -pf
     char *CoreDumpPath;             //
     char *CoreDumpName;             //
@@ -129,8 +131,32 @@ struct ProcDumpConfiguration
     char *ExcludeFilter;            // -fx (exclude filter)
     bool bRestrackEnabled;          // -restrack
     bool bRestrackGenerateDump;     // -restrack generate dump flag
+    bool bRestrackDiff;             // -restrack diff (differential reports)
+    bool bRestrackChurn;            // -restrack churn (allocation churn reports)
     bool bLeakReportInProgress;
     int SampleRate;                 // Record every X resource allocation in restrack
+    int RestrackMinAge;             // -ra (minimum age in seconds of resources in restrack reports)
+#ifdef __linux__
+    enum RestrackReportFormat RestrackFormat;   // -rf (restrack report format)
+    char *RestrackReportFile;       // -restrack-report (raw capture to generate a report from)
+    int RestrackThreshold;          // -rm (MB)
+    enum RestrackThresholdType RestrackThresholdType;   // -rm [stack:|growth:]
+    int RestrackMaxResources;       // -rc (0 is the default maximum)
+    int CpuWindow;                  // -cw (ms, CPU usage measured in-kernel over a rolling window)
+    int MemoryHysteresis;           // -mh (MB, commit usage measured in-kernel)
+    char *Uprobe;                   // -uprobe ([Binary:]Symbol)
+    char *Usdt;                     // -usdt ([Binary:]Provider:Probe)
+    int ProbeArgument;              // -pa (USDT argument, 1-based)
+    long long ProbeArgumentValue;   // -pa (value of the USDT argument)
+    int ProbeHits;                  // -ph (hits of the probe or syscall errors)
+    bool bProbeHitRate;             // -ph rate: (hits per second)
+    int ProbeLatency;               // -pl (ms, duration of a call of the -uprobe function)
+    int* SyscallErrors;             // -se (errnos)
+    int SyscallErrorCount;
+    int* Syscalls;                  // -ss (syscall numbers, any if not specified)
+    int SyscallCount;
+    bool bDumpOnNativeException;    // -ne (C++ exceptions, filtered with -f)
+#endif
     int CoreDumpMask;               // -mc (core dump mask)
 
     //
@@ -140,6 +166,35 @@ struct ProcDumpConfiguration
 #ifdef __linux__
     std::unordered_map<uintptr_t, ResourceInformation*> memAllocMap;
     pthread_mutex_t memAllocMapMutex;
+
+    //
+    // The grouped result of the previous restrack report, used for differential reports.
+    // Access must be protected by memAllocMapMutex.
+    //
+    std::unordered_map<std::string, groupedAllocEntry> restrackPreviousGroups;
+    uint64_t restrackPreviousSnapshotTime;
+
+    // Start (ms) of the window covered by the next churn report (-restrack churn)
+    uint64_t restrackChurnWindowStart;
+
+    //
+    // Running totals of the outstanding allocations in memAllocMap for the restrack memory
+    // trigger (-rm), the per call stack bytes are only kept for -rm stack:. Access must be
+    // protected by memAllocMapMutex.
+    //
+    uint64_t restrackOutstandingBytes;
+    std::unordered_map<uint64_t, uint64_t> restrackStackBytes;
+    uint64_t restrackStacksOverThreshold;
+
+    //
+    // Once the maximum number of tracked resources (-rc) is reached only the resources whose
+    // hash is below 2^-restrackSamplingShift are kept. Counts of the resources that were not
+    // sampled or evicted when the sampling rate was lowered. Access must be protected by
+    // memAllocMapMutex.
+    //
+    unsigned int restrackSamplingShift;
+    uint64_t restrackDroppedCount;
+    uint64_t restrackEvictedCount;
 #endif
 
     // multithreading
@@ -285,6 +285,9 @@ struct ProcessStatus {
 // -----------------------------------------------------------
 
 bool GetProcessStat(pid_t pid, struct ProcessStat *proc);
+#ifdef __linux__
+bool GetProcessSignalMasks(pid_t pid, uint64_t* caught, uint64_t* ignored);
+#endif
 char* GetProcessName(pid_t pid);
 char* GetProcessNameFromCmdLine(char* cmdLine);
 pid_t GetProcessPgid(pid_t pid);
@@ -23,7 +23,10 @@ enum TriggerType
     Exception,
     GCThreshold,
     GCGeneration,
-    Restrack
+    Restrack,
+    RestrackMemory,
+    Crash,
+    Probe
 };
 
 #endif // PROFILERCOMMON_H
\ No newline at end of file
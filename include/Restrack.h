@@ -10,13 +10,87 @@
 #ifndef RESTRACK_H
 #define RESTRACK_H
 
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "RestrackCapture.h"
+
 #define MAX_CALL_STACK_FRAMES   100
 
+//
+// Age buckets of the outstanding resources (<1s, <1m, <10m, older)
+//
+#define RESTRACK_AGE_BUCKETS    4
+
+//
+// Default maximum number of resources tracked per process (-rc). Once reached, the resources
+// are sampled and the reports are scaled by the sampling weight.
+//
+#define RESTRACK_DEFAULT_MAX_RESOURCES  1000000
+#define RESTRACK_MAX_SAMPLING_SHIFT     32
+
+//
+// A group of outstanding resources with the same type, size and call stack.
+//
+typedef struct {
+    unsigned int type;
+    unsigned long allocCount;
+    unsigned long allocSize;
+    unsigned long totalAllocSize;
+    unsigned long ageHistogram[RESTRACK_AGE_BUCKETS];
+    unsigned int callStackLen;
+    unsigned long long stackTrace[MAX_CALL_STACK_FRAMES];
+} groupedAllocEntry;
+
+//
+// A symbolized frame of a restrack call stack.
+//
+typedef struct {
+    std::string symbolName;
+    std::string demangledSymbolName;
+    std::string moduleName;
+    uint64_t offset;
+    unsigned long long pc;
+} stackFrame;
+
+//
+// Restrack report formats (-rf)
+//
+enum RestrackReportFormat
+{
+    RestrackFormatText,
+    RestrackFormatPprof,
+    RestrackFormatFolded,
+    RestrackFormatRaw
+};
+
+//
+// What the restrack memory threshold (-rm) applies to
+//
+enum RestrackThresholdType
+{
+    RestrackThresholdTotal,         // all the outstanding allocations
+    RestrackThresholdStack,         // the outstanding allocations of any single call stack
+    RestrackThresholdGrowth         // growth of the outstanding allocations within a minute
+};
+
+void SetMaxRLimit();
+void SetLibbpfPrint(struct ProcDumpConfiguration *config);
 struct procdump_ebpf* RunRestrack(struct ProcDumpConfiguration *config);
 void StopRestrack(struct procdump_ebpf* skel);
+void InitRestrackSymbolCache();
+bool RestrackAddTarget(struct ProcDumpConfiguration *config);
+void RestrackRemoveTarget(struct ProcDumpConfiguration *config);
 int RestrackHandleEvent(void *ctx, void *data, size_t data_sz);
 void* ReportLeaks(void* args);
 pthread_t WriteRestrackSnapshot(ProcDumpConfiguration* config, ECoreDumpType type);
+void GroupResource(std::unordered_map<std::string, groupedAllocEntry>& groups, unsigned int type, unsigned long size, uint64_t ageNs, unsigned int callStackLen, const unsigned long long* stackTrace, uint64_t weight);
+bool WriteRestrackReport(struct ProcDumpConfiguration* config, const char* filename, void* symResolver, const std::unordered_map<std::string, groupedAllocEntry>& groups, const std::unordered_map<std::string, groupedAllocEntry>* previousGroups, uint64_t elapsedMs, const std::vector<RestrackCaptureMapping>* mappings);
+bool ResolveCallStack(struct ProcDumpConfiguration* config, void* symResolver, const groupedAllocEntry& entry, std::vector<stackFrame>& callStack);
+const char* GetRestrackSectionTitle(unsigned int type);
+uint64_t GetRestrackThresholdBytes(struct ProcDumpConfiguration* config);
+bool WildcardSearch(char* entry, char* search);
 
 #endif // RESTRACK_H
 
@@ -0,0 +1,85 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// RestrackCapture.h
+//
+// Raw restrack captures (-rf raw) and offline reports (-restrack-report).
+//
+//--------------------------------------------------------------------
+
+#ifndef RESTRACKCAPTURE_H
+#define RESTRACKCAPTURE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#define RESTRACK_CAPTURE_MAGIC      "PDRESTRK"
+#define RESTRACK_CAPTURE_VERSION    1
+
+//
+// File layout (native byte order):
+//
+// RestrackCaptureHeader
+// moduleCount x (RestrackCaptureModule, path, build id)
+// stackCount x (uint32_t frame count, frame count x uint64_t frames)
+// resourceCount x RestrackCaptureResource
+//
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    uint64_t captureTime;           // CLOCK_MONOTONIC (ns), same clock as the resource timestamps
+    uint32_t sampleRate;
+    uint32_t moduleCount;
+    uint32_t stackCount;
+    uint32_t samplingShift;         // 1 in 2^samplingShift resources kept once the cap (-rc) was reached
+    uint64_t resourceCount;
+} RestrackCaptureHeader;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t fileOffset;
+    uint32_t pathLength;
+    uint32_t buildIdLength;
+} RestrackCaptureModule;
+
+typedef struct {
+    uint64_t resource;
+    uint64_t size;
+    uint64_t timestamp;
+    uint32_t type;
+    uint32_t stackIndex;            // index in the stack table
+} RestrackCaptureResource;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t fileOffset;
+    std::string path;
+    std::string buildId;
+} RestrackCaptureMapping;
+
+//
+// In memory representation of a capture. The frames of stack i are
+// stackFrames[stackOffsets[i]] to stackFrames[stackOffsets[i+1]].
+//
+typedef struct {
+    RestrackCaptureHeader header;
+    std::vector<RestrackCaptureMapping> mappings;
+    std::vector<uint32_t> stackOffsets;
+    std::vector<unsigned long long> stackFrames;
+    std::vector<RestrackCaptureResource> resources;
+} RestrackCapture;
+
+void GetRestrackMappings(pid_t pid, std::vector<RestrackCaptureMapping>& mappings);
+void CaptureResources(struct ProcDumpConfiguration* config, RestrackCapture& capture);
+bool WriteRestrackCapture(const char* filename, struct ProcDumpConfiguration* config, RestrackCapture& capture);
+bool ReadRestrackCapture(const char* filename, RestrackCapture& capture);
+int RestrackOfflineReport(struct ProcDumpConfiguration* config);
+
+#endif // RESTRACKCAPTURE_H
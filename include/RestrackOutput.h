@@ -0,0 +1,20 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// RestrackOutput.h
+//
+// Machine readable restrack report formats.
+//
+//--------------------------------------------------------------------
+
+#ifndef RESTRACKOUTPUT_H
+#define RESTRACKOUTPUT_H
+
+#include <vector>
+
+bool WriteRestrackPprof(const char* filename, struct ProcDumpConfiguration* config, void* symResolver, std::vector<const groupedAllocEntry*>& groups, const std::vector<RestrackCaptureMapping>& mappings);
+bool WriteRestrackFolded(const char* filename, struct ProcDumpConfiguration* config, void* symResolver, std::vector<const groupedAllocEntry*>& groups);
+
+#endif // RESTRACKOUTPUT_H
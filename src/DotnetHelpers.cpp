@@ -214,3 +214,143 @@ bool GenerateCoreClrDump(char* socketName, char* dumpFileName)
 #pragma GCC diagnostic pop
 #endif
 }
+
+//--------------------------------------------------------------------
+//
+// IsCoreClrPerfMapEnabled - Checks whether the .NET process was
+// started with the perf map enabled (DOTNET_PerfMapEnabled or
+// COMPlus_PerfMapEnabled set to a non zero value).
+//
+// Returns: true   - if the perf map is enabled by the environment
+//          false  - otherwise
+//
+//--------------------------------------------------------------------
+bool IsCoreClrPerfMapEnabled(pid_t pid)
+{
+    bool bRet = false;
+    char environPath[64];
+    auto_free_file FILE *environFile = NULL;
+    char* entry = NULL;
+    size_t entrySize = 0;
+
+    snprintf(environPath, sizeof(environPath), "/proc/%d/environ", pid);
+    environFile = fopen(environPath, "r");
+    if(environFile == NULL)
+    {
+        Trace("IsCoreClrPerfMapEnabled: Failed to open %s [%d].", environPath, errno);
+        return false;
+    }
+
+    // Entries are NUL separated
+    while(getdelim(&entry, &entrySize, '\0', environFile) != -1)
+    {
+        char* value = NULL;
+        if(strncmp(entry, "DOTNET_PerfMapEnabled=", 22) == 0)
+        {
+            value = entry + 22;
+        }
+        else if(strncmp(entry, "COMPlus_PerfMapEnabled=", 23) == 0)
+        {
+            value = entry + 23;
+        }
+
+        if(value != NULL && value[0] != '\0' && strcmp(value, "0") != 0)
+        {
+            bRet = true;
+            break;
+        }
+    }
+
+    free(entry);
+    return bRet;
+}
+
+//--------------------------------------------------------------------
+//
+// SetCoreClrPerfMap - Enables or disables the perf map of the JIT'ed
+// code (/tmp/perf-<pid>.map) using the diagnostics server. When
+// enabled, the runtime also writes the methods that were already
+// JIT'ed. Requires .NET 8 or later.
+//
+// Returns: true   - if the runtime accepted the command
+//          false  - otherwise
+//
+//--------------------------------------------------------------------
+bool SetCoreClrPerfMap(char* socketName, bool bEnable)
+{
+    bool bRet = false;
+    struct sockaddr_un addr = {0};
+    auto_free_fd int fd = 0;
+    uint32_t perfMapType = CORECLR_PERFMAPTYPE_PERFMAP;
+    unsigned char packet[sizeof(struct IpcHeader) + sizeof(perfMapType)];
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        Trace("SetCoreClrPerfMap: Failed to create socket [%d].", errno);
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketName, sizeof(addr.sun_path)-1);
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(struct sockaddr_un)) == -1)
+    {
+        Trace("SetCoreClrPerfMap: Failed to connect to socket %s [%d].", socketName, errno);
+        return false;
+    }
+
+    // Enable carries the perf map type, disable has no payload
+    uint16_t totalPacketSize = sizeof(struct IpcHeader) + (bEnable ? sizeof(perfMapType) : 0);
+    struct IpcHeader perfMapHeader =
+    {
+        { {"DOTNET_IPC_V1"} },
+        totalPacketSize,
+        (uint8_t)CORECLR_DIAG_PROCESS_COMMANDSET,
+        (uint8_t)(bEnable ? CORECLR_DIAG_ENABLE_PERFMAP : CORECLR_DIAG_DISABLE_PERFMAP),
+        (uint16_t)0x0000
+    };
+
+    memcpy(packet, &perfMapHeader, sizeof(struct IpcHeader));
+    memcpy(packet + sizeof(struct IpcHeader), &perfMapType, sizeof(perfMapType));
+
+    if(send_all(fd, packet, totalPacketSize) == -1)
+    {
+        Trace("SetCoreClrPerfMap: Failed sending packet to diagnostics server [%d]", errno);
+        return false;
+    }
+
+    // The response is a header followed by a single uint32 (hresult), older runtimes reply
+    // with an error for the unknown command
+    struct IpcHeader retHeader;
+    int32_t res = -1;
+    if(recv_all(fd, &retHeader, sizeof(struct IpcHeader)) == -1)
+    {
+        Trace("SetCoreClrPerfMap: Failed receiving response header from diagnostics server [%d]", errno);
+    }
+    else if(retHeader.Size != CORECLR_DIAG_IPCHEADER_SIZE)
+    {
+        Trace("SetCoreClrPerfMap: Failed validating header size in response header from diagnostics server [%d != 24]", retHeader.Size);
+    }
+    else if(recv_all(fd, &res, sizeof(int32_t)) == -1)
+    {
+        Trace("SetCoreClrPerfMap: Failed receiving result code from diagnostics server [%d]", errno);
+    }
+    else if(res != 0)
+    {
+        Trace("SetCoreClrPerfMap: Diagnostics server returned 0x%x.", res);
+    }
+    else
+    {
+        bRet = true;
+    }
+
+#if (__GNUC__ >= 13)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-fd-leak"
+#endif
+    return bRet;
+#if (__GNUC__ >= 13)
+#pragma GCC diagnostic pop
+#endif
+}
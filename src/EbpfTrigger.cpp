@@ -0,0 +1,1146 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// EbpfTrigger.cpp
+//
+// Triggers evaluated in-kernel by the trigger eBPF program. Each trigger
+// loads its own instance of the program with only the programs it needs,
+// the monitor thread blocks until the program reports that the condition
+// is met.
+//
+//--------------------------------------------------------------------
+#define _Bool bool
+#include "procdump_trigger_ebpf.skel.h"
+
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <cxxabi.h>
+
+#include "Includes.h"
+#include "bcc_syms.h"
+
+// ------------------------------------------------------------------------------------------
+// EbpfTriggerHandleEvent
+//
+// Keeps the event for the monitor thread and wakes it up.
+// ------------------------------------------------------------------------------------------
+static int EbpfTriggerHandleEvent(void *ctx, void *data, size_t data_sz)
+{
+    struct EbpfTrigger* trigger = (struct EbpfTrigger*) ctx;
+
+    if(data_sz < sizeof(struct TriggerEvent))
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&trigger->eventMutex);
+    memcpy(&trigger->pendingEvent, data, sizeof(struct TriggerEvent));
+    trigger->bEventPending = true;
+    pthread_mutex_unlock(&trigger->eventMutex);
+
+    SetEvent(&trigger->evtTriggered.event);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// EbpfTriggerPollingThread
+//
+// Polls the ring buffer of the trigger. Since the monitor thread blocks until an event is
+// received, it's also woken up once monitoring should stop (for example, the target exited).
+// ------------------------------------------------------------------------------------------
+static void* EbpfTriggerPollingThread(void* args)
+{
+    struct EbpfTrigger* trigger = (struct EbpfTrigger*) args;
+    Trace("EbpfTriggerPollingThread: Enter [id=%d]", gettid());
+
+    while(trigger->bStop == false)
+    {
+        int err = ring_buffer__poll(trigger->ringBuffer, 100);
+        if (err == -EINTR)
+        {
+            continue;
+        }
+        if (err < 0)
+        {
+            Log(error, "EbpfTriggerPollingThread: Error polling ring buffer: %d\n", err);
+            SetEvent(&trigger->evtTriggered.event);
+            break;
+        }
+
+        if(ContinueMonitoring(trigger->config) == false)
+        {
+            SetEvent(&trigger->evtTriggered.event);
+        }
+    }
+
+    Trace("EbpfTriggerPollingThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+// ------------------------------------------------------------------------------------------
+// AttachCpuClock
+//
+// Attaches a program to a software clock on every cpu that ticks every periodNs, so that
+// threads that run without being switched out (CPU) or without returning (latency) are
+// checked in time.
+// ------------------------------------------------------------------------------------------
+static bool AttachCpuClock(struct EbpfTrigger* trigger, struct bpf_program* prog, uint64_t periodNs)
+{
+    int numCpus = libbpf_num_possible_cpus();
+    if(numCpus <= 0)
+    {
+        Trace("AttachCpuClock: Failed to get the number of cpus.");
+        return false;
+    }
+
+    struct perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_CPU_CLOCK;
+    attr.sample_period = periodNs;
+
+    for(int cpu = 0; cpu < numCpus; cpu++)
+    {
+        int fd = syscall(__NR_perf_event_open, &attr, -1, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+        if(fd < 0)
+        {
+            //
+            // Possible but offline cpus
+            //
+            if(errno == ENODEV)
+            {
+                continue;
+            }
+
+            Trace("AttachCpuClock: Failed to open the cpu clock on cpu %d (%s).", cpu, strerror(errno));
+            return false;
+        }
+
+        struct bpf_link* link = bpf_program__attach_perf_event(prog, fd);
+        if(libbpf_get_error(link) != 0)
+        {
+            Trace("AttachCpuClock: Failed to attach to the cpu clock on cpu %d.", cpu);
+            close(fd);
+            return false;
+        }
+
+        trigger->links.push_back(link);
+    }
+
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// AttachUprobe
+//
+// Attaches a uprobe (or uretprobe) program to a function of the target given as
+// [Binary:]Symbol. The binary is a path or the name of a library mapped by the target and
+// defaults to the executable. C++ functions are given by their mangled name.
+// ------------------------------------------------------------------------------------------
+static bool AttachUprobe(struct EbpfTrigger* trigger, struct bpf_program* prog, const char* probe, bool bRetprobe)
+{
+    pid_t pid = trigger->config->ProcessId;
+    std::string binary = "/proc/" + std::to_string(pid) + "/exe";
+    std::string symbol = probe;
+
+    size_t separator = symbol.find(':');
+    if(separator != std::string::npos)
+    {
+        binary = symbol.substr(0, separator);
+        symbol = symbol.substr(separator + 1);
+    }
+
+    struct bcc_symbol sym = {};
+    if(bcc_resolve_symname(binary.c_str(), symbol.c_str(), 0, pid, NULL, &sym) != 0)
+    {
+        Log(error, "Failed to resolve %s in %s of process ID %d.", symbol.c_str(), binary.c_str(), pid);
+        return false;
+    }
+
+    LIBBPF_OPTS(bpf_uprobe_opts, opts, .retprobe = bRetprobe);
+    struct bpf_link* link = bpf_program__attach_uprobe_opts(prog, pid, sym.module, sym.offset, &opts);
+    if(link == NULL)
+    {
+        Trace("AttachUprobe: Failed to attach to %s in %s at offset 0x%lx (%s).", symbol.c_str(), sym.module, sym.offset, strerror(errno));
+        free((void*) sym.module);
+        return false;
+    }
+
+    Trace("AttachUprobe: Attached to %s in %s at offset 0x%lx.", symbol.c_str(), sym.module, sym.offset);
+    free((void*) sym.module);
+
+    trigger->links.push_back(link);
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// AttachUsdt
+//
+// Attaches a USDT program to a probe of the target given as [Binary:]Provider:Probe. The
+// binary is a path or the name of a library mapped by the target and defaults to the
+// executable.
+// ------------------------------------------------------------------------------------------
+static bool AttachUsdt(struct EbpfTrigger* trigger, struct bpf_program* prog, const char* probe)
+{
+    pid_t pid = trigger->config->ProcessId;
+    std::string binary = "/proc/" + std::to_string(pid) + "/exe";
+    std::string provider = probe;
+    std::string name;
+
+    size_t separator = provider.rfind(':');
+    if(separator == std::string::npos || separator == 0 || separator + 1 == provider.length())
+    {
+        Log(error, "Invalid USDT probe %s, the format is [Binary:]Provider:Probe.", probe);
+        return false;
+    }
+
+    name = provider.substr(separator + 1);
+    provider = provider.substr(0, separator);
+
+    separator = provider.rfind(':');
+    if(separator != std::string::npos)
+    {
+        binary = provider.substr(0, separator);
+        provider = provider.substr(separator + 1);
+    }
+
+    struct bpf_link* link = bpf_program__attach_usdt(prog, pid, binary.c_str(), provider.c_str(), name.c_str(), NULL);
+    if(link == NULL)
+    {
+        Log(error, "Failed to attach to the USDT probe %s:%s in %s of process ID %d (%s).", provider.c_str(), name.c_str(), binary.c_str(), pid, strerror(errno));
+        return false;
+    }
+
+    Trace("AttachUsdt: Attached to %s:%s in %s.", provider.c_str(), name.c_str(), binary.c_str());
+
+    trigger->links.push_back(link);
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// AttachCxaThrow
+//
+// Attaches the exception program to __cxa_throw of the target, which is in the C++ runtime
+// (libstdc++ or libc++abi) or in the executable if the runtime is linked statically.
+// Succeeds if any of them defines it.
+// ------------------------------------------------------------------------------------------
+static bool AttachCxaThrow(struct EbpfTrigger* trigger, struct bpf_program* prog)
+{
+    pid_t pid = trigger->config->ProcessId;
+    std::string binaries[] = { "/proc/" + std::to_string(pid) + "/exe", "libstdc++.so.6", "libc++abi.so.1" };
+    bool bAttached = false;
+
+    for(const std::string& binary : binaries)
+    {
+        //
+        // Binaries linked dynamically only reference it, nothing to attach to
+        //
+        struct bcc_symbol sym = {};
+        if(bcc_resolve_symname(binary.c_str(), "__cxa_throw", 0, pid, NULL, &sym) != 0 || sym.offset == 0)
+        {
+            Trace("AttachCxaThrow: __cxa_throw not found in %s.", binary.c_str());
+            continue;
+        }
+        free((void*) sym.module);
+
+        if(AttachUprobe(trigger, prog, (binary + ":__cxa_throw").c_str(), false) == true)
+        {
+            bAttached = true;
+        }
+    }
+
+    return bAttached;
+}
+
+// ------------------------------------------------------------------------------------------
+// GetMemoryCounters
+//
+// Reads the memory counters of the process (bytes) in the order of the rss_stat members, the
+// program only receives the counters that change after it's attached.
+// ------------------------------------------------------------------------------------------
+static bool GetMemoryCounters(pid_t pid, int64_t counters[TRIGGER_MEMORY_COUNTERS])
+{
+    static const char* names[TRIGGER_MEMORY_COUNTERS] = { "RssFile:", "RssAnon:", "VmSwap:", "RssShmem:" };
+    char path[PATH_MAX];
+    char line[256];
+    int found = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE* file = fopen(path, "r");
+    if(file == NULL)
+    {
+        Trace("GetMemoryCounters: Failed to open %s (%s).", path, strerror(errno));
+        return false;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        for(int i = 0; i < TRIGGER_MEMORY_COUNTERS; i++)
+        {
+            long long kb = 0;
+            size_t len = strlen(names[i]);
+            if(strncmp(line, names[i], len) == 0 && sscanf(line + len, "%lld", &kb) == 1)
+            {
+                counters[i] = kb << 10;
+                found++;
+            }
+        }
+    }
+
+    fclose(file);
+    return found == TRIGGER_MEMORY_COUNTERS;
+}
+
+// ------------------------------------------------------------------------------------------
+// GetMemoryThreshold
+//
+// Returns the current memory threshold (bytes), the last one is kept once all the thresholds
+// have been used.
+// ------------------------------------------------------------------------------------------
+static uint64_t GetMemoryThreshold(struct ProcDumpConfiguration* config)
+{
+    int index = config->MemoryCurrentThreshold < config->MemoryThresholdCount ? config->MemoryCurrentThreshold : config->MemoryThresholdCount - 1;
+    return (uint64_t) config->MemoryThreshold[index] << 20;
+}
+
+// ------------------------------------------------------------------------------------------
+// IsTerminatingSignal
+//
+// Returns true if the default action of the signal terminates the process.
+// ------------------------------------------------------------------------------------------
+static bool IsTerminatingSignal(int signum)
+{
+    switch(signum)
+    {
+        case SIGCHLD:
+        case SIGCONT:
+        case SIGURG:
+        case SIGWINCH:
+        case SIGSTOP:
+        case SIGTSTP:
+        case SIGTTIN:
+        case SIGTTOU:
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// GetResourceCount
+//
+// Reads the thread or file descriptor count of the process from procfs, the count is then
+// kept up to date in-kernel. Returns -1 on failure.
+// ------------------------------------------------------------------------------------------
+static int64_t GetResourceCount(pid_t pid, unsigned int type)
+{
+    struct ProcessStat proc = {0};
+
+    if(GetProcessStat(pid, &proc) == false)
+    {
+        Trace("GetResourceCount: Failed to get the stats of process %d.", pid);
+        return -1;
+    }
+
+    return type == TRIGGER_THREAD_COUNT ? proc.num_threads : proc.num_filedescriptors;
+}
+
+// ------------------------------------------------------------------------------------------
+// SetFdSyscalls
+//
+// Fills the change of the file descriptor count on success of the syscalls that create or
+// close descriptors. The change of fcntl, dup2/dup3, close_range and recvmsg depends on their
+// arguments and is worked out by the program. Descriptors created through io_uring or
+// recvmmsg aren't counted, the count is read from procfs again before a dump.
+// ------------------------------------------------------------------------------------------
+static bool SetFdSyscalls(struct procdump_trigger_ebpf* skel)
+{
+    static const struct { long id; int delta; } fdSyscalls[] =
+    {
+#ifdef SYS_open
+        { SYS_open, 1 },
+#endif
+#ifdef SYS_creat
+        { SYS_creat, 1 },
+#endif
+#ifdef SYS_openat
+        { SYS_openat, 1 },
+#endif
+#ifdef SYS_openat2
+        { SYS_openat2, 1 },
+#endif
+#ifdef SYS_open_by_handle_at
+        { SYS_open_by_handle_at, 1 },
+#endif
+#ifdef SYS_socket
+        { SYS_socket, 1 },
+#endif
+#ifdef SYS_accept
+        { SYS_accept, 1 },
+#endif
+#ifdef SYS_accept4
+        { SYS_accept4, 1 },
+#endif
+#ifdef SYS_dup
+        { SYS_dup, 1 },
+#endif
+#ifdef SYS_epoll_create
+        { SYS_epoll_create, 1 },
+#endif
+#ifdef SYS_epoll_create1
+        { SYS_epoll_create1, 1 },
+#endif
+#ifdef SYS_eventfd
+        { SYS_eventfd, 1 },
+#endif
+#ifdef SYS_eventfd2
+        { SYS_eventfd2, 1 },
+#endif
+#ifdef SYS_timerfd_create
+        { SYS_timerfd_create, 1 },
+#endif
+#ifdef SYS_inotify_init
+        { SYS_inotify_init, 1 },
+#endif
+#ifdef SYS_inotify_init1
+        { SYS_inotify_init1, 1 },
+#endif
+#ifdef SYS_fanotify_init
+        { SYS_fanotify_init, 1 },
+#endif
+#ifdef SYS_memfd_create
+        { SYS_memfd_create, 1 },
+#endif
+#ifdef SYS_pidfd_open
+        { SYS_pidfd_open, 1 },
+#endif
+#ifdef SYS_pidfd_getfd
+        { SYS_pidfd_getfd, 1 },
+#endif
+#ifdef SYS_userfaultfd
+        { SYS_userfaultfd, 1 },
+#endif
+#ifdef SYS_perf_event_open
+        { SYS_perf_event_open, 1 },
+#endif
+#ifdef SYS_io_uring_setup
+        { SYS_io_uring_setup, 1 },
+#endif
+#ifdef SYS_pipe
+        { SYS_pipe, 2 },
+#endif
+#ifdef SYS_pipe2
+        { SYS_pipe2, 2 },
+#endif
+#ifdef SYS_socketpair
+        { SYS_socketpair, 2 },
+#endif
+        { SYS_close, -1 },
+#ifdef SYS_fcntl
+        { SYS_fcntl, TRIGGER_FD_FCNTL },
+#endif
+#ifdef SYS_dup2
+        { SYS_dup2, TRIGGER_FD_DUP2 },
+#endif
+#ifdef SYS_dup3
+        { SYS_dup3, TRIGGER_FD_DUP2 },
+#endif
+#ifdef SYS_close_range
+        { SYS_close_range, TRIGGER_FD_CLOSE_RANGE },
+#endif
+#ifdef SYS_recvmsg
+        { SYS_recvmsg, TRIGGER_FD_RECVMSG },
+#endif
+    };
+
+    for(size_t i = 0; i < sizeof(fdSyscalls) / sizeof(fdSyscalls[0]); i++)
+    {
+        unsigned int id = fdSyscalls[i].id;
+        int delta = fdSyscalls[i].delta;
+        if(id < TRIGGER_FD_SYSCALLS && bpf_map__update_elem(skel->maps.fdSyscallMap, &id, sizeof(id), &delta, sizeof(delta), BPF_ANY) != 0)
+        {
+            Trace("SetFdSyscalls: Failed to set syscall %u (%s).", id, strerror(errno));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// SetExceptionFilters
+//
+// Gives the program the name the mangled name of a new exception type has to contain for
+// each -f filter. Identifiers appear as is in mangled names, so that's the longest run of
+// identifier characters of the filter that the demangler can't produce from an encoding
+// (builtin types, std abbreviations, ...). If a filter has none, the program leaves all new
+// types to user space.
+// ------------------------------------------------------------------------------------------
+static void SetExceptionFilters(struct procdump_trigger_ebpf* skel, const char* exceptionFilter)
+{
+    static const char* encodedWords[] =
+    {
+        "std", "allocator", "basic_string", "string", "char_traits", "basic_istream", "basic_ostream",
+        "basic_iostream", "istream", "ostream", "iostream", "anonymous", "namespace", "lambda", "unnamed",
+        "operator", "decltype", "const", "volatile", "restrict", "unsigned", "signed", "wchar_t", "char8_t",
+        "char16_t", "char32_t", "bool", "void", "short", "long", "__int128", "__float128", "float", "double",
+        "decimal32", "decimal64", "decimal128", "auto", "nullptr_t", "true", "false"
+    };
+    std::vector<std::string> names;
+
+    skel->bss->exceptionFilterCount = 0;
+    if(exceptionFilter == NULL)
+    {
+        return;
+    }
+
+    std::string filters = exceptionFilter;
+    size_t start = 0;
+    while(start < filters.length())
+    {
+        size_t end = filters.find(',', start);
+        if(end == std::string::npos)
+        {
+            end = filters.length();
+        }
+
+        std::string filter = filters.substr(start, end - start);
+        start = end + 1;
+        if(filter.empty())
+        {
+            continue;
+        }
+
+        std::string name;
+        std::string run;
+        for(size_t i = 0; i <= filter.length(); i++)
+        {
+            char c = i < filter.length() ? tolower(filter[i]) : '\0';
+            if(isalnum(c) || c == '_')
+            {
+                run += c;
+                continue;
+            }
+
+            bool bEncoded = false;
+            for(const char* word : encodedWords)
+            {
+                bEncoded = bEncoded || strstr(word, run.c_str()) != NULL;
+            }
+
+            if(bEncoded == false && run.length() > name.length())
+            {
+                name = run;
+            }
+            run.clear();
+        }
+
+        if(name.empty() || names.size() == TRIGGER_EXCEPTION_FILTERS)
+        {
+            Trace("SetExceptionFilters: Exception filter %s can't be checked in-kernel.", filter.c_str());
+            return;
+        }
+
+        names.push_back(name.substr(0, TRIGGER_EXCEPTION_FILTER - 1));
+    }
+
+    for(size_t i = 0; i < names.size(); i++)
+    {
+        memset(skel->bss->exceptionFilters[i], 0, TRIGGER_EXCEPTION_FILTER);
+        memcpy(skel->bss->exceptionFilters[i], names[i].c_str(), names[i].length());
+    }
+
+    skel->bss->exceptionFilterCount = names.size();
+}
+
+// ------------------------------------------------------------------------------------------
+// PostEbpfTriggerEvent
+//
+// Reports an event found by user space (the condition was already met when the trigger was
+// started or rearmed), the program stays disarmed like after sending one.
+// ------------------------------------------------------------------------------------------
+static void PostEbpfTriggerEvent(struct EbpfTrigger* trigger, uint64_t value)
+{
+    trigger->skel->bss->armed = false;
+
+    pthread_mutex_lock(&trigger->eventMutex);
+    trigger->pendingEvent = {};
+    trigger->pendingEvent.type = trigger->type;
+    trigger->pendingEvent.value = value;
+    trigger->pendingEvent.stackId = -1;
+    trigger->bEventPending = true;
+    pthread_mutex_unlock(&trigger->eventMutex);
+
+    SetEvent(&trigger->evtTriggered.event);
+}
+
+// ------------------------------------------------------------------------------------------
+// StartEbpfTrigger
+//
+// Loads the programs of the trigger for the target and starts polling for its events.
+// Returns NULL if the trigger can't be evaluated in-kernel.
+// ------------------------------------------------------------------------------------------
+struct EbpfTrigger* StartEbpfTrigger(struct ProcDumpConfiguration* config, unsigned int type)
+{
+    struct procdump_trigger_ebpf* skel = NULL;
+    struct bpf_program* prog = NULL;
+    struct stat sb = {};
+    int64_t counters[TRIGGER_MEMORY_COUNTERS] = {};
+    uint64_t usage = 0;
+    uint64_t caught = 0;
+    uint64_t ignored = 0;
+    int64_t count = 0;
+    uint64_t clockNs = 0;
+
+    SetMaxRLimit();
+    SetLibbpfPrint(config);
+
+    //
+    // Target PIDs are specified using procdump's view of the PID so we use procdump's pid
+    // namespace.
+    //
+    if (stat("/proc/self/ns/pid", &sb) == -1)
+    {
+        Trace("StartEbpfTrigger: Failed to stat /proc/self/ns/pid (%s)\n", strerror(errno));
+        return NULL;
+    }
+
+    skel = procdump_trigger_ebpf__open();
+    if (!skel)
+    {
+        Trace("StartEbpfTrigger: Failed to open the trigger eBPF program.");
+        return NULL;
+    }
+
+    skel->bss->dev = sb.st_dev;
+    skel->bss->inode = sb.st_ino;
+    skel->bss->targetPid = config->ProcessId;
+    skel->bss->armed = true;
+    if(config->DiagnosticsLoggingEnabled != none)
+    {
+        skel->bss->isLoggingEnabled = true;
+    }
+
+    //
+    // Only load the programs of this trigger
+    //
+    bpf_object__for_each_program(prog, skel->obj)
+    {
+        bpf_program__set_autoload(prog, false);
+    }
+
+    switch(type)
+    {
+        case TRIGGER_CPU:
+            skel->bss->cpuWindowNs = (uint64_t) config->CpuWindow * 1000000;
+            skel->bss->cpuThreshold = config->CpuThreshold;
+            bpf_program__set_autoload(skel->progs.sched_switch, true);
+            bpf_program__set_autoload(skel->progs.cpu_clock, true);
+            break;
+
+        case TRIGGER_MEMORY:
+            if(GetMemoryCounters(config->ProcessId, counters) == false)
+            {
+                Trace("StartEbpfTrigger: Failed to get the memory counters of process %d.", config->ProcessId);
+                procdump_trigger_ebpf__destroy(skel);
+                return NULL;
+            }
+
+            for(int i = 0; i < TRIGGER_MEMORY_COUNTERS; i++)
+            {
+                skel->bss->memoryCounters[i] = counters[i];
+                usage += counters[i];
+            }
+
+            skel->bss->memoryThreshold = GetMemoryThreshold(config);
+            skel->bss->memoryHysteresis = (uint64_t) config->MemoryHysteresis << 20;
+            skel->bss->memoryBelow = config->bMemoryTriggerBelowValue;
+            bpf_program__set_autoload(skel->progs.rss_stat, true);
+            break;
+
+        case TRIGGER_SIGNAL:
+            if(GetProcessSignalMasks(config->ProcessId, &caught, &ignored) == false)
+            {
+                Trace("StartEbpfTrigger: Failed to get the signal masks of process %d.", config->ProcessId);
+                procdump_trigger_ebpf__destroy(skel);
+                return NULL;
+            }
+
+            for(int i = 0; i < config->SignalCount; i++)
+            {
+                int signum = config->SignalNumber[i];
+                if(signum < 1 || signum > 64)
+                {
+                    Trace("StartEbpfTrigger: Signal %d can't be intercepted in-kernel.", signum);
+                    procdump_trigger_ebpf__destroy(skel);
+                    return NULL;
+                }
+
+                uint64_t bit = 1ULL << (signum - 1);
+
+                //
+                // Without a handler the signal terminates the process before it can be stopped,
+                // only ptrace can hold it.
+                //
+                if(IsTerminatingSignal(signum) == true && (caught & bit) == 0 && (ignored & bit) == 0)
+                {
+                    Log(info, "Signal %d isn't handled by process ID %d, it can only be intercepted with ptrace.", signum, config->ProcessId);
+                    procdump_trigger_ebpf__destroy(skel);
+                    return NULL;
+                }
+
+                skel->bss->signalMask |= bit;
+                if(IsTerminatingSignal(signum) == true)
+                {
+                    skel->bss->signalTerminateMask |= bit;
+                }
+            }
+
+            bpf_program__set_autoload(skel->progs.signal_deliver, true);
+            break;
+
+        case TRIGGER_THREAD_COUNT:
+        case TRIGGER_FD_COUNT:
+            if((count = GetResourceCount(config->ProcessId, type)) == -1)
+            {
+                procdump_trigger_ebpf__destroy(skel);
+                return NULL;
+            }
+
+            skel->bss->resourceCount = count;
+            if(type == TRIGGER_THREAD_COUNT)
+            {
+                skel->bss->resourceThreshold = config->ThreadThreshold;
+                bpf_program__set_autoload(skel->progs.task_newtask, true);
+                bpf_program__set_autoload(skel->progs.sched_process_exit, true);
+            }
+            else
+            {
+                skel->bss->resourceThreshold = config->FileDescriptorThreshold;
+                bpf_program__set_autoload(skel->progs.sys_enter, true);
+                bpf_program__set_autoload(skel->progs.sys_exit, true);
+            }
+            break;
+
+        case TRIGGER_PROBE:
+            skel->bss->probeHits = config->ProbeHits;
+            skel->bss->probeRate = config->bProbeHitRate;
+            if(config->Usdt != NULL)
+            {
+                if(config->ProbeArgument != -1)
+                {
+                    skel->bss->probeFilter = true;
+                    skel->bss->probeArgument = config->ProbeArgument - 1;
+                    skel->bss->probeArgumentValue = config->ProbeArgumentValue;
+                }
+                bpf_program__set_autoload(skel->progs.usdt_hit, true);
+            }
+            else
+            {
+                bpf_program__set_autoload(skel->progs.uprobe_hit, true);
+            }
+            break;
+
+        case TRIGGER_LATENCY:
+            //
+            // The calls are checked a few times per threshold, but at least every
+            // MAX_LATENCY_CLOCK so that the dump isn't created too long after the threshold
+            //
+            clockNs = (uint64_t) config->ProbeLatency * 1000000 / 4;
+            if(clockNs < MIN_LATENCY_CLOCK * 1000000ULL)
+            {
+                clockNs = MIN_LATENCY_CLOCK * 1000000ULL;
+            }
+            else if(clockNs > MAX_LATENCY_CLOCK * 1000000ULL)
+            {
+                clockNs = MAX_LATENCY_CLOCK * 1000000ULL;
+            }
+
+            skel->bss->latencyThresholdNs = (uint64_t) config->ProbeLatency * 1000000;
+            skel->bss->latencyClockNs = clockNs;
+            bpf_program__set_autoload(skel->progs.latency_entry, true);
+            bpf_program__set_autoload(skel->progs.latency_return, true);
+            bpf_program__set_autoload(skel->progs.latency_clock, true);
+            bpf_program__set_autoload(skel->progs.latency_exit, true);
+            break;
+
+        case TRIGGER_SYSCALL_ERROR:
+            skel->bss->probeHits = config->ProbeHits;
+            skel->bss->probeRate = config->bProbeHitRate;
+            for(int i = 0; i < config->SyscallErrorCount; i++)
+            {
+                skel->bss->errorMask[config->SyscallErrors[i] / 64] |= 1ULL << (config->SyscallErrors[i] % 64);
+            }
+
+            skel->bss->errorAnySyscall = config->SyscallCount == 0;
+            for(int i = 0; i < config->SyscallCount; i++)
+            {
+                skel->bss->errorSyscallMask[config->Syscalls[i] / 64] |= 1ULL << (config->Syscalls[i] % 64);
+            }
+
+            bpf_program__set_autoload(skel->progs.syscall_error, true);
+            break;
+
+        case TRIGGER_EXCEPTION:
+            SetExceptionFilters(skel, config->ExceptionFilter);
+            bpf_program__set_autoload(skel->progs.cxa_throw, true);
+            break;
+
+        default:
+            Trace("StartEbpfTrigger: Unknown trigger type %d.", type);
+            procdump_trigger_ebpf__destroy(skel);
+            return NULL;
+    }
+
+    if (procdump_trigger_ebpf__load(skel) != 0)
+    {
+        Trace("StartEbpfTrigger: Failed to load the trigger eBPF program.");
+        procdump_trigger_ebpf__destroy(skel);
+        return NULL;
+    }
+
+    if (type == TRIGGER_FD_COUNT && SetFdSyscalls(skel) == false)
+    {
+        procdump_trigger_ebpf__destroy(skel);
+        return NULL;
+    }
+
+    struct EbpfTrigger* trigger = new EbpfTrigger();
+    trigger->type = type;
+    trigger->config = config;
+    trigger->skel = skel;
+    trigger->ringBuffer = NULL;
+    trigger->bStop = false;
+    trigger->bEventPending = false;
+    InitNamedEvent(&trigger->evtTriggered.event, true, false, const_cast<char*>("EbpfTrigger"));
+    trigger->evtTriggered.type = EVENT;
+    pthread_mutex_init(&trigger->eventMutex, NULL);
+
+    //
+    // The tracepoints are attached by the skeleton, the perf events and probes by hand
+    //
+    bool bAttached = procdump_trigger_ebpf__attach(skel) == 0;
+    if(bAttached == true && type == TRIGGER_CPU)
+    {
+        bAttached = AttachCpuClock(trigger, skel->progs.cpu_clock, skel->bss->cpuWindowNs / 4);
+    }
+    else if(bAttached == true && type == TRIGGER_LATENCY)
+    {
+        bAttached = AttachUprobe(trigger, skel->progs.latency_entry, config->Uprobe, false) &&
+                    AttachUprobe(trigger, skel->progs.latency_return, config->Uprobe, true) &&
+                    AttachCpuClock(trigger, skel->progs.latency_clock, skel->bss->latencyClockNs);
+    }
+    else if(bAttached == true && type == TRIGGER_PROBE)
+    {
+        bAttached = config->Usdt != NULL ? AttachUsdt(trigger, skel->progs.usdt_hit, config->Usdt) : AttachUprobe(trigger, skel->progs.uprobe_hit, config->Uprobe, false);
+    }
+    else if(bAttached == true && type == TRIGGER_EXCEPTION)
+    {
+        bAttached = AttachCxaThrow(trigger, skel->progs.cxa_throw);
+    }
+
+    if(bAttached == false)
+    {
+        Trace("StartEbpfTrigger: Failed to attach the trigger eBPF program.");
+        StopEbpfTrigger(trigger);
+        return NULL;
+    }
+
+    trigger->ringBuffer = ring_buffer__new(bpf_map__fd(skel->maps.triggerRingBuffer), EbpfTriggerHandleEvent, trigger, NULL);
+    if (!trigger->ringBuffer)
+    {
+        Trace("StartEbpfTrigger: Failed to create ring buffer.");
+        StopEbpfTrigger(trigger);
+        return NULL;
+    }
+
+    //
+    // The program only sees changes, if the threshold is already met report it now.
+    //
+    if(type == TRIGGER_MEMORY && (config->bMemoryTriggerBelowValue ? usage < skel->bss->memoryThreshold : usage >= skel->bss->memoryThreshold))
+    {
+        skel->bss->memoryCrossed = true;
+        PostEbpfTriggerEvent(trigger, usage);
+    }
+    else if((type == TRIGGER_THREAD_COUNT || type == TRIGGER_FD_COUNT) && count >= skel->bss->resourceThreshold)
+    {
+        PostEbpfTriggerEvent(trigger, count);
+    }
+
+    if(pthread_create(&trigger->pollingThread, NULL, EbpfTriggerPollingThread, trigger) != 0)
+    {
+        Trace("StartEbpfTrigger: Failed to create polling thread.");
+        ring_buffer__free(trigger->ringBuffer);
+        trigger->ringBuffer = NULL;
+        StopEbpfTrigger(trigger);
+        return NULL;
+    }
+
+    return trigger;
+}
+
+// ------------------------------------------------------------------------------------------
+// LogEbpfTriggerStack
+//
+// Logs the user stack captured with the event, if any.
+// ------------------------------------------------------------------------------------------
+void LogEbpfTriggerStack(struct EbpfTrigger* trigger, struct TriggerEvent* event)
+{
+    __u64 stackTrace[MAX_CALL_STACK_FRAMES] = {};
+    __u32 stackId = event->stackId;
+
+    if(event->stackId < 0)
+    {
+        return;
+    }
+
+    if(bpf_map__lookup_elem(trigger->skel->maps.triggerStackMap, &stackId, sizeof(stackId), stackTrace, sizeof(stackTrace), 0) != 0)
+    {
+        Trace("LogEbpfTriggerStack: Failed to get stack %d (%s).", event->stackId, strerror(errno));
+        return;
+    }
+
+    void* symResolver = bcc_symcache_new(trigger->config->ProcessId, NULL);
+
+    Log(info, "Call stack of thread %d:", event->pid);
+    for(int i = 0; i < MAX_CALL_STACK_FRAMES && stackTrace[i] != 0; i++)
+    {
+        struct bcc_symbol sym = {};
+        if(bcc_symcache_resolve(symResolver, stackTrace[i], &sym) == 0)
+        {
+            Log(info, "    0x%llx %s+0x%lx (%s)", (unsigned long long) stackTrace[i], sym.demangle_name != NULL ? sym.demangle_name : sym.name, sym.offset, sym.module);
+            bcc_symbol_free_demangle_name(&sym);
+        }
+        else
+        {
+            Log(info, "    0x%llx %s", (unsigned long long) stackTrace[i], sym.module != NULL ? sym.module : "<unknown>");
+        }
+    }
+
+    bcc_free_symcache(symResolver, trigger->config->ProcessId);
+}
+
+// ------------------------------------------------------------------------------------------
+// GetEbpfTriggerExceptionType
+//
+// Gets the (demangled) name of the exception type of an exception event, as recorded by
+// the program.
+// ------------------------------------------------------------------------------------------
+bool GetEbpfTriggerExceptionType(struct EbpfTrigger* trigger, struct TriggerEvent* event, std::string& name)
+{
+    struct ExceptionType exceptionType = {};
+    __u64 typeInfo = event->value;
+
+    if(bpf_map__lookup_elem(trigger->skel->maps.exceptionTypeMap, &typeInfo, sizeof(typeInfo), &exceptionType, sizeof(exceptionType), 0) != 0)
+    {
+        Trace("GetEbpfTriggerExceptionType: Failed to get type 0x%llx (%s).", (unsigned long long) typeInfo, strerror(errno));
+        return false;
+    }
+
+    //
+    // Types with internal linkage are prefixed with '*'
+    //
+    exceptionType.name[TRIGGER_EXCEPTION_NAME - 1] = '\0';
+    const char* mangled = exceptionType.name[0] == '*' ? exceptionType.name + 1 : exceptionType.name;
+
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(mangled, NULL, NULL, &status);
+    name = demangled != NULL ? demangled : mangled;
+    free(demangled);
+
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// IgnoreEbpfTriggerExceptionType
+//
+// Filters out the exception type of an exception event in-kernel, it doesn't trigger
+// anymore.
+// ------------------------------------------------------------------------------------------
+void IgnoreEbpfTriggerExceptionType(struct EbpfTrigger* trigger, struct TriggerEvent* event)
+{
+    struct ExceptionType exceptionType = {};
+    __u64 typeInfo = event->value;
+
+    if(bpf_map__lookup_elem(trigger->skel->maps.exceptionTypeMap, &typeInfo, sizeof(typeInfo), &exceptionType, sizeof(exceptionType), 0) != 0)
+    {
+        Trace("IgnoreEbpfTriggerExceptionType: Failed to get type 0x%llx (%s).", (unsigned long long) typeInfo, strerror(errno));
+        return;
+    }
+
+    exceptionType.ignored = true;
+    if(bpf_map__update_elem(trigger->skel->maps.exceptionTypeMap, &typeInfo, sizeof(typeInfo), &exceptionType, sizeof(exceptionType), BPF_EXIST) != 0)
+    {
+        Trace("IgnoreEbpfTriggerExceptionType: Failed to update type 0x%llx (%s).", (unsigned long long) typeInfo, strerror(errno));
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// SeedResourceCount
+//
+// Seeds the count of a count trigger from procfs again. The program keeps updating the count
+// while procfs is read, so the correction is added atomically rather than stored. Returns
+// the count, -1 on failure.
+// ------------------------------------------------------------------------------------------
+static int64_t SeedResourceCount(struct EbpfTrigger* trigger)
+{
+    int64_t before = trigger->skel->bss->resourceCount;
+    int64_t count = GetResourceCount(trigger->config->ProcessId, trigger->type);
+    if(count == -1)
+    {
+        return -1;
+    }
+
+    __sync_fetch_and_add(&trigger->skel->bss->resourceCount, count - before);
+    return count;
+}
+
+// ------------------------------------------------------------------------------------------
+// ResyncEbpfTrigger
+//
+// Seeds the count of a count trigger from procfs again while it's armed, to bound the drift
+// of the descriptors the program doesn't see (io_uring, ...). It's O(open descriptors) so the
+// monitor only does it every FD_COUNT_RESYNC_INTERVAL. The count is reported right away if
+// it's over the threshold.
+// ------------------------------------------------------------------------------------------
+void ResyncEbpfTrigger(struct EbpfTrigger* trigger)
+{
+    if((trigger->type != TRIGGER_THREAD_COUNT && trigger->type != TRIGGER_FD_COUNT) || trigger->skel->bss->armed == false)
+    {
+        return;
+    }
+
+    int64_t count = SeedResourceCount(trigger);
+    if(count != -1 && count >= trigger->skel->bss->resourceThreshold)
+    {
+        PostEbpfTriggerEvent(trigger, count);
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// ContinueEbpfTriggerTarget
+//
+// Continues the target if the program stopped it for an event (signal and exception
+// triggers), the program can stop it again once it's rearmed.
+// ------------------------------------------------------------------------------------------
+void ContinueEbpfTriggerTarget(struct EbpfTrigger* trigger)
+{
+    __u32 key = 0;
+    __u32 stopped = 0;
+
+    if(bpf_map__lookup_elem(trigger->skel->maps.targetStoppedMap, &key, sizeof(key), &stopped, sizeof(stopped), 0) != 0)
+    {
+        return;
+    }
+
+    if (kill(trigger->config->ProcessId, SIGCONT) == -1)
+    {
+        Trace("ContinueEbpfTriggerTarget: Failed to continue process %d (%s).", trigger->config->ProcessId, strerror(errno));
+    }
+
+    bpf_map__delete_elem(trigger->skel->maps.targetStoppedMap, &key, sizeof(key), 0);
+}
+
+// ------------------------------------------------------------------------------------------
+// StopEbpfTrigger
+//
+// Stops polling, detaches and unloads the programs of the trigger.
+// ------------------------------------------------------------------------------------------
+void StopEbpfTrigger(struct EbpfTrigger* trigger)
+{
+    if(trigger == NULL)
+    {
+        return;
+    }
+
+    //
+    // Disarm and detach first so that the target can't be stopped anymore, it's then
+    // continued if it was stopped for an event that wasn't handled.
+    //
+    trigger->skel->bss->armed = false;
+    procdump_trigger_ebpf__detach(trigger->skel);
+    for(auto link : trigger->links)
+    {
+        bpf_link__destroy(link);
+    }
+
+    if(trigger->ringBuffer != NULL)
+    {
+        trigger->bStop = true;
+        pthread_join(trigger->pollingThread, NULL);
+        ring_buffer__free(trigger->ringBuffer);
+    }
+
+    ContinueEbpfTriggerTarget(trigger);
+
+    procdump_trigger_ebpf__destroy(trigger->skel);
+
+    DestroyEvent(&trigger->evtTriggered.event);
+    pthread_mutex_destroy(&trigger->eventMutex);
+    delete trigger;
+}
+
+// ------------------------------------------------------------------------------------------
+// GetEbpfTriggerEvent
+//
+// Takes the event received since the last call, if any.
+// ------------------------------------------------------------------------------------------
+bool GetEbpfTriggerEvent(struct EbpfTrigger* trigger, struct TriggerEvent* event)
+{
+    pthread_mutex_lock(&trigger->eventMutex);
+    bool bPending = trigger->bEventPending;
+    if(bPending == true)
+    {
+        memcpy(event, &trigger->pendingEvent, sizeof(struct TriggerEvent));
+        trigger->bEventPending = false;
+    }
+    pthread_mutex_unlock(&trigger->eventMutex);
+
+    return bPending;
+}
+
+// ------------------------------------------------------------------------------------------
+// RearmEbpfTrigger
+//
+// The program only sends one event until it's rearmed, the monitor thread rearms it once
+// it's ready for the next one. The memory trigger moves on to the current threshold, the
+// count triggers read the count again in case it drifted and report it right away if it's
+// still over the threshold (as polling would). The probe and syscall error triggers count
+// the hits again.
+// ------------------------------------------------------------------------------------------
+void RearmEbpfTrigger(struct EbpfTrigger* trigger)
+{
+    if(trigger->type == TRIGGER_THREAD_COUNT || trigger->type == TRIGGER_FD_COUNT)
+    {
+        int64_t count = SeedResourceCount(trigger);
+        if(count != -1 && count >= trigger->skel->bss->resourceThreshold)
+        {
+            PostEbpfTriggerEvent(trigger, count);
+            return;
+        }
+    }
+
+    if(trigger->type == TRIGGER_PROBE || trigger->type == TRIGGER_SYSCALL_ERROR)
+    {
+        trigger->skel->bss->probeCount = 0;
+    }
+
+    if(trigger->type == TRIGGER_MEMORY)
+    {
+        //
+        // A new threshold can be crossed right away, the same threshold only once the usage
+        // moved back by the hysteresis.
+        //
+        uint64_t threshold = GetMemoryThreshold(trigger->config);
+        if(threshold != trigger->skel->bss->memoryThreshold)
+        {
+            trigger->skel->bss->memoryThreshold = threshold;
+            trigger->skel->bss->memoryCrossed = false;
+        }
+    }
+
+    trigger->skel->bss->armed = true;
+}
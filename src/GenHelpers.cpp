@@ -14,10 +14,11 @@
 //--------------------------------------------------------------------
 //
 // GetSeparatedValues -
-// Returns a list of values separated by the specified separator.
+// Returns a list of values separated by the specified separator,
+// converted with convert (integers by default).
 //
 //--------------------------------------------------------------------
-int* GetSeparatedValues(char* src, char* separator, int* numValues)
+int* GetSeparatedValues(char* src, char* separator, int* numValues, bool (*convert)(const char* src, int* conv))
 {
     int* ret = NULL;
     int i = 0;
@@ -59,7 +60,7 @@ int* GetSeparatedValues(char* src, char* separator, int* numValues)
             token = strtok((char*)dup, separator);
             while (token != NULL)
             {
-                if(!ConvertToInt(token, &ret[i]))
+                if(!convert(token, &ret[i]))
                 {
                     free(ret);
                     ret = NULL;
@@ -96,6 +97,154 @@ bool ConvertToInt(const char* src, int* conv)
     return true;
 }
 
+#ifdef __linux__
+struct NamedValue
+{
+    const char* name;
+    int value;
+};
+
+#define NAMED_VALUE(name) { #name, name }
+#define NAMED_SYSCALL(name) { #name, SYS_##name }
+
+//
+// Errnos that can be specified by name (-se)
+//
+static const struct NamedValue errnoNames[] =
+{
+    NAMED_VALUE(EPERM), NAMED_VALUE(ENOENT), NAMED_VALUE(ESRCH), NAMED_VALUE(EINTR),
+    NAMED_VALUE(EIO), NAMED_VALUE(ENXIO), NAMED_VALUE(E2BIG), NAMED_VALUE(ENOEXEC),
+    NAMED_VALUE(EBADF), NAMED_VALUE(ECHILD), NAMED_VALUE(EAGAIN), NAMED_VALUE(ENOMEM),
+    NAMED_VALUE(EACCES), NAMED_VALUE(EFAULT), NAMED_VALUE(EBUSY), NAMED_VALUE(EEXIST),
+    NAMED_VALUE(EXDEV), NAMED_VALUE(ENODEV), NAMED_VALUE(ENOTDIR), NAMED_VALUE(EISDIR),
+    NAMED_VALUE(EINVAL), NAMED_VALUE(ENFILE), NAMED_VALUE(EMFILE), NAMED_VALUE(ENOTTY),
+    NAMED_VALUE(ETXTBSY), NAMED_VALUE(EFBIG), NAMED_VALUE(ENOSPC), NAMED_VALUE(ESPIPE),
+    NAMED_VALUE(EROFS), NAMED_VALUE(EMLINK), NAMED_VALUE(EPIPE), NAMED_VALUE(ERANGE),
+    NAMED_VALUE(EDEADLK), NAMED_VALUE(ENAMETOOLONG), NAMED_VALUE(ENOLCK), NAMED_VALUE(ENOSYS),
+    NAMED_VALUE(ENOTEMPTY), NAMED_VALUE(ELOOP), NAMED_VALUE(ENODATA), NAMED_VALUE(ETIME),
+    NAMED_VALUE(EOVERFLOW), NAMED_VALUE(EILSEQ), NAMED_VALUE(ENOTSOCK), NAMED_VALUE(EDESTADDRREQ),
+    NAMED_VALUE(EMSGSIZE), NAMED_VALUE(EPROTOTYPE), NAMED_VALUE(ENOPROTOOPT), NAMED_VALUE(EPROTONOSUPPORT),
+    NAMED_VALUE(EOPNOTSUPP), NAMED_VALUE(EAFNOSUPPORT), NAMED_VALUE(EADDRINUSE), NAMED_VALUE(EADDRNOTAVAIL),
+    NAMED_VALUE(ENETDOWN), NAMED_VALUE(ENETUNREACH), NAMED_VALUE(ENETRESET), NAMED_VALUE(ECONNABORTED),
+    NAMED_VALUE(ECONNRESET), NAMED_VALUE(ENOBUFS), NAMED_VALUE(EISCONN), NAMED_VALUE(ENOTCONN),
+    NAMED_VALUE(ESHUTDOWN), NAMED_VALUE(ETIMEDOUT), NAMED_VALUE(ECONNREFUSED), NAMED_VALUE(EHOSTDOWN),
+    NAMED_VALUE(EHOSTUNREACH), NAMED_VALUE(EALREADY), NAMED_VALUE(EINPROGRESS), NAMED_VALUE(ESTALE),
+    NAMED_VALUE(EDQUOT), NAMED_VALUE(ECANCELED), NAMED_VALUE(EOWNERDEAD), NAMED_VALUE(ENOTRECOVERABLE)
+};
+
+//
+// Syscalls that can be specified by name (-ss), the others by number
+//
+static const struct NamedValue syscallNames[] =
+{
+    NAMED_SYSCALL(read), NAMED_SYSCALL(write), NAMED_SYSCALL(openat), NAMED_SYSCALL(close),
+    NAMED_SYSCALL(pread64), NAMED_SYSCALL(pwrite64), NAMED_SYSCALL(readv), NAMED_SYSCALL(writev),
+    NAMED_SYSCALL(fstat), NAMED_SYSCALL(newfstatat), NAMED_SYSCALL(statx), NAMED_SYSCALL(lseek),
+    NAMED_SYSCALL(mmap), NAMED_SYSCALL(munmap), NAMED_SYSCALL(mprotect), NAMED_SYSCALL(madvise),
+    NAMED_SYSCALL(brk), NAMED_SYSCALL(ioctl), NAMED_SYSCALL(fcntl), NAMED_SYSCALL(dup),
+    NAMED_SYSCALL(dup3), NAMED_SYSCALL(pipe2), NAMED_SYSCALL(socket), NAMED_SYSCALL(connect),
+    NAMED_SYSCALL(accept), NAMED_SYSCALL(accept4), NAMED_SYSCALL(bind), NAMED_SYSCALL(listen),
+    NAMED_SYSCALL(sendto), NAMED_SYSCALL(recvfrom), NAMED_SYSCALL(sendmsg), NAMED_SYSCALL(recvmsg),
+    NAMED_SYSCALL(shutdown), NAMED_SYSCALL(setsockopt), NAMED_SYSCALL(getsockopt), NAMED_SYSCALL(epoll_create1),
+    NAMED_SYSCALL(epoll_ctl), NAMED_SYSCALL(epoll_pwait), NAMED_SYSCALL(eventfd2), NAMED_SYSCALL(timerfd_create),
+    NAMED_SYSCALL(ppoll), NAMED_SYSCALL(pselect6), NAMED_SYSCALL(futex), NAMED_SYSCALL(nanosleep),
+    NAMED_SYSCALL(clone), NAMED_SYSCALL(execve), NAMED_SYSCALL(wait4), NAMED_SYSCALL(kill),
+    NAMED_SYSCALL(mkdirat), NAMED_SYSCALL(unlinkat), NAMED_SYSCALL(renameat), NAMED_SYSCALL(ftruncate),
+    NAMED_SYSCALL(fsync), NAMED_SYSCALL(fdatasync), NAMED_SYSCALL(memfd_create), NAMED_SYSCALL(io_uring_enter),
+#if defined(__x86_64__)
+    NAMED_SYSCALL(open), NAMED_SYSCALL(stat), NAMED_SYSCALL(lstat), NAMED_SYSCALL(poll),
+    NAMED_SYSCALL(select), NAMED_SYSCALL(pipe), NAMED_SYSCALL(dup2), NAMED_SYSCALL(fork),
+    NAMED_SYSCALL(epoll_wait), NAMED_SYSCALL(mkdir), NAMED_SYSCALL(unlink), NAMED_SYSCALL(rename),
+#endif
+};
+
+//--------------------------------------------------------------------
+//
+// ConvertToNamedValue - Helper to convert from a char* (number or
+// name) to int
+//
+//--------------------------------------------------------------------
+static bool ConvertToNamedValue(const char* src, int* conv, const struct NamedValue* names, size_t count)
+{
+    if(ConvertToInt(src, conv))
+    {
+        return true;
+    }
+
+    for(size_t i = 0; i < count; i++)
+    {
+        if(strcasecmp(src, names[i].name) == 0)
+        {
+            *conv = names[i].value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//--------------------------------------------------------------------
+//
+// GetValueName - Returns the name of a value, NULL if it doesn't have
+// one
+//
+//--------------------------------------------------------------------
+static const char* GetValueName(int value, const struct NamedValue* names, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        if(names[i].value == value)
+        {
+            return names[i].name;
+        }
+    }
+
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// ConvertToErrno - Helper to convert from a char* (number or name,
+// for example EMFILE) to an errno
+//
+//--------------------------------------------------------------------
+bool ConvertToErrno(const char* src, int* conv)
+{
+    return ConvertToNamedValue(src, conv, errnoNames, sizeof(errnoNames) / sizeof(errnoNames[0]));
+}
+
+//--------------------------------------------------------------------
+//
+// ConvertToSyscall - Helper to convert from a char* (number or name,
+// for example openat) to a syscall number
+//
+//--------------------------------------------------------------------
+bool ConvertToSyscall(const char* src, int* conv)
+{
+    return ConvertToNamedValue(src, conv, syscallNames, sizeof(syscallNames) / sizeof(syscallNames[0]));
+}
+
+//--------------------------------------------------------------------
+//
+// GetErrnoName - Returns the name of an errno, NULL if unknown
+//
+//--------------------------------------------------------------------
+const char* GetErrnoName(int error)
+{
+    return GetValueName(error, errnoNames, sizeof(errnoNames) / sizeof(errnoNames[0]));
+}
+
+//--------------------------------------------------------------------
+//
+// GetSyscallName - Returns the name of a syscall, NULL if unknown
+//
+//--------------------------------------------------------------------
+const char* GetSyscallName(int syscall)
+{
+    return GetValueName(syscall, syscallNames, sizeof(syscallNames) / sizeof(syscallNames[0]));
+}
+#endif
+
 //--------------------------------------------------------------------
 //
 // ConvertToIntHex - Helper to convert from a char* (hex) to int
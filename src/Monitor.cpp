@@ -16,6 +16,14 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <set>
+
+#ifdef __linux__
+#include <elf.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#endif
 
 #ifdef __APPLE__
 #include <libproc.h>
@@ -101,7 +109,7 @@ void* SignalThread(void *input)
                 // To avoid situations where we have intercepted a signal and CTRL-C is hit, we synchronize
                 // access to the signal path (in SignalMonitoringThread). Note, there is still a race but
                 // acceptable since it is very unlikely to occur. We also cancel the SignalMonitorThread to
-                // break it out of waitpid call.
+                // break it out of waitpid call. The CrashMonitoringThread wakes up and detaches on quit.
                 if(it->second->SignalCount > 0)
                 {
                     for(int i=0; i<it->second->nThreads; i++)
@@ -543,7 +551,15 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
 
     if (self->CpuThreshold != -1)
     {
-        if ((rc = CreateMonitorThread(self, Processor, CpuMonitoringThread, (void *)self)) != 0 )
+        void *(*cpuMonitoringThread)(void *) = CpuMonitoringThread;
+#ifdef __linux__
+        if (self->CpuWindow != -1)
+        {
+            cpuMonitoringThread = CpuEbpfMonitoringThread;
+        }
+#endif
+
+        if ((rc = CreateMonitorThread(self, Processor, cpuMonitoringThread, (void *)self)) != 0 )
         {
             Trace("CreateMonitorThreads: failed to create CpuThread.");
             return rc;
@@ -552,7 +568,15 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
 
     if (self->MemoryThreshold != NULL && !tooManyTriggers && self->bMonitoringGCMemory == false)
     {
-        if ((rc = CreateMonitorThread(self, Commit, CommitMonitoringThread, (void *)self)) != 0 )
+        void *(*commitMonitoringThread)(void *) = CommitMonitoringThread;
+#ifdef __linux__
+        if (self->MemoryHysteresis != -1)
+        {
+            commitMonitoringThread = CommitEbpfMonitoringThread;
+        }
+#endif
+
+        if ((rc = CreateMonitorThread(self, Commit, commitMonitoringThread, (void *)self)) != 0 )
         {
             Trace("CreateMonitorThreads: failed to create CommitThread.");
             return rc;
@@ -561,7 +585,12 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
 
     if (self->ThreadThreshold != -1 && !tooManyTriggers)
     {
-        if ((rc = CreateMonitorThread(self, ThreadCount, ThreadCountMonitoringThread, (void *)self)) != 0 )
+        void *(*threadCountMonitoringThread)(void *) = ThreadCountMonitoringThread;
+#ifdef __linux__
+        threadCountMonitoringThread = ThreadCountEbpfMonitoringThread;
+#endif
+
+        if ((rc = CreateMonitorThread(self, ThreadCount, threadCountMonitoringThread, (void *)self)) != 0 )
         {
             Trace("CreateMonitorThreads: failed to create ThreadThread.");
             return rc;
@@ -570,7 +599,12 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
 
     if (self->FileDescriptorThreshold != -1 && !tooManyTriggers)
     {
-        if ((rc = CreateMonitorThread(self, FileDescriptorCount, FileDescriptorCountMonitoringThread, (void *)self)) != 0 )
+        void *(*fileDescriptorCountMonitoringThread)(void *) = FileDescriptorCountMonitoringThread;
+#ifdef __linux__
+        fileDescriptorCountMonitoringThread = FileDescriptorCountEbpfMonitoringThread;
+#endif
+
+        if ((rc = CreateMonitorThread(self, FileDescriptorCount, fileDescriptorCountMonitoringThread, (void *)self)) != 0 )
         {
             Trace("CreateMonitorThreads: failed to create FileDescriptorThread.");
             return rc;
@@ -579,13 +613,47 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
 
     if (self->SignalCount > 0 && !tooManyTriggers)
     {
-        if ((rc = CreateMonitorThread(self, Signal, SignalMonitoringThread, (void *)self)) != 0 )
+        void *(*signalMonitoringThread)(void *) = SignalMonitoringThread;
+#ifdef __linux__
+        signalMonitoringThread = SignalEbpfMonitoringThread;
+#endif
+
+        if ((rc = CreateMonitorThread(self, Signal, signalMonitoringThread, (void *)self)) != 0 )
         {
             Trace("CreateMonitorThreads: failed to create SignalMonitoringThread.");
             return rc;
         }
     }
 
+#ifdef __linux__
+    if (self->Uprobe != NULL || self->Usdt != NULL || self->SyscallErrorCount > 0)
+    {
+        if ((rc = CreateMonitorThread(self, Probe, ProbeMonitoringThread, (void *)self)) != 0 )
+        {
+            Trace("CreateMonitorThreads: failed to create ProbeMonitoringThread.");
+            return rc;
+        }
+    }
+
+    if (self->bDumpOnNativeException)
+    {
+        if ((rc = CreateMonitorThread(self, Exception, NativeExceptionMonitoringThread, (void *)self)) != 0 )
+        {
+            Trace("CreateMonitorThreads: failed to create NativeExceptionMonitoringThread.");
+            return rc;
+        }
+    }
+#endif
+
+    if (self->bDumpOnCrash)
+    {
+        if ((rc = CreateMonitorThread(self, Crash, CrashMonitoringThread, (void *)self)) != 0 )
+        {
+            Trace("CreateMonitorThreads: failed to create CrashMonitoringThread.");
+            return rc;
+        }
+    }
+
     if (self->bTimerThreshold)
     {
         if ((rc = CreateMonitorThread(self, Timer, TimerThread, (void *)self)) != 0 )
@@ -604,6 +672,17 @@ int CreateMonitorThreads(struct ProcDumpConfiguration *self)
         }
     }
 
+#ifdef __linux__
+    if (self->bRestrackEnabled && self->RestrackThreshold != -1)
+    {
+        if ((rc = CreateMonitorThread(self, RestrackMemory, RestrackMemoryMonitoringThread, (void *)self)) != 0 )
+        {
+            Trace("CreateMonitorThreads: failed to create RestrackMemoryMonitoringThread.");
+            return rc;
+        }
+    }
+#endif
+
     return 0;
 }
 
@@ -777,8 +856,9 @@ int WaitForAllMonitorsToTerminate(struct ProcDumpConfiguration *self)
     // If we have a restrack thread, cancel it and wait for it to exit
     //
 #ifdef __linux__    
-    if(CancelRestrackThread(self) != 0)
+    if(restrackThread != 0)
     {
+        CancelRestrackThread(self);
         if ((rc = pthread_join(restrackThread, NULL)) != 0)
         {
             Log(error, "An error occurred while joining restrack thread\n");
@@ -1309,227 +1389,1461 @@ void* SignalMonitoringThread(void *thread_args /* struct ProcDumpConfiguration*
     return NULL;
 }
 
+#ifdef __linux__
 //--------------------------------------------------------------------
 //
-// CpuMonitoringThread - Thread monitoring for CPU usage.
+// IsCrashSignal - Returns true if the signal terminates the process
+// with a core dump, that is a SIGSEGV, SIGBUS or SIGABRT the process
+// doesn't handle.
 //
 //--------------------------------------------------------------------
-void *CpuMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+static bool IsCrashSignal(pid_t pid, int signum)
 {
-    Trace("CpuMonitoringThread: Enter [id=%d]", gettid());
-    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+    uint64_t caught = 0;
+    uint64_t ignored = 0;
 
-    unsigned long totalTime = 0;
-    unsigned long elapsedTime = 0;
-    int cpuUsage;
-    auto_free struct CoreDumpWriter *writer = NULL;
-    auto_free char* dumpFileName = NULL;
-#ifdef __linux__
-    std::vector<pthread_t> leakReportThreads;
-#endif
+    if (signum != SIGSEGV && signum != SIGBUS && signum != SIGABRT)
+    {
+        return false;
+    }
 
-    writer = NewCoreDumpWriter(CPU, config);
+    // Fault signals are forced to the default action when ignored, only a handler prevents the crash
+    if (GetProcessSignalMasks(pid, &caught, &ignored) == false)
+    {
+        return true;
+    }
 
-    int rc = 0;
-    struct ProcessStat proc = {0};
+    return (caught & (1ULL << (signum - 1))) == 0;
+}
 
-    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+//--------------------------------------------------------------------
+//
+// SeizeProcessThreads - Traces all the threads of the process, the
+// threads they create are traced automatically.
+//
+//--------------------------------------------------------------------
+static bool SeizeProcessThreads(pid_t pid, std::set<pid_t>& tracees)
+{
+    char path[PATH_MAX];
+    bool bNewThreads = true;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+
+    //
+    // Threads can be created while we enumerate them, repeat until there are no new ones.
+    //
+    while (bNewThreads == true)
     {
-        while ((rc = WaitForQuit(config, config->PollingInterval)) == WAIT_TIMEOUT)
+        bNewThreads = false;
+
+        auto_free_dir DIR* dir = opendir(path);
+        if (dir == NULL)
         {
-            if (GetProcessStat(config->ProcessId, &proc))
+            Trace("SeizeProcessThreads: Failed to open %s (%s).", path, strerror(errno));
+            return false;
+        }
+
+        struct dirent* entry = NULL;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            pid_t tid = atoi(entry->d_name);
+            if (tid <= 0 || tracees.count(tid) != 0)
             {
-                cpuUsage = GetCpuUsage(config->ProcessId);
-                Trace("CpuMonitoringThread: CPU usage:%d%% on process ID: %d", cpuUsage, config->ProcessId);
+                continue;
+            }
 
-                // CPU Trigger
-                if ((config->bCpuTriggerBelowValue && (cpuUsage < config->CpuThreshold)) ||
-                    (!config->bCpuTriggerBelowValue && (cpuUsage >= config->CpuThreshold)))
+            if (ptrace(PTRACE_SEIZE, tid, NULL, PTRACE_O_TRACECLONE) == -1)
+            {
+                // The thread exited, or was created by a traced thread and is already traced
+                if (errno == ESRCH || (errno == EPERM && tid != pid))
                 {
-                    Log(info, "Trigger: CPU usage:%d%% on process ID: %d", cpuUsage, config->ProcessId);
-                    if(config->bRestrackGenerateDump == true)
-                    {
-                        // Only generate core dump if user did not specify the "nodump" restrack option
-                        dumpFileName = WriteCoreDump(writer);
-                        if(dumpFileName == NULL)
-                        {
-                            SetQuit(config, 1);
-                        }
-                    }
-
-                    //
-                    // Check to see if restrack is specified, if so, save current resource usage to file.
-                    //
-#ifdef __linux__                    
-                    if(config->bRestrackEnabled == true)
+                    if (errno == EPERM)
                     {
-                        pthread_t id = WriteRestrackSnapshot(config, writer->Type);
-                        if (id == 0)
-                        {
-                            SetQuit(config, 1);
-                        }
-                        else
-                        {
-                            leakReportThreads.push_back(id);
-                        }
+                        tracees.insert(tid);
                     }
-#endif                    
 
-                    if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
-                    {
-                        break;
-                    }
+                    continue;
                 }
+
+                Trace("SeizeProcessThreads: Failed to seize thread %d (%s).", tid, strerror(errno));
+                return false;
             }
-            else
-            {
-                Log(error, "An error occurred while parsing procfs\n");
-                exit(-1);
-            }
+
+            tracees.insert(tid);
+            bNewThreads = true;
         }
     }
 
-    //
-    // Wait for the leak reporting threads to finish
-    //
-#ifdef __linux__    
-    WaitThreads(leakReportThreads);
-#endif
-
-    Trace("CpuMonitoringThread: Exit [id=%d]", gettid());
-    return NULL;
+    return true;
 }
 
 //--------------------------------------------------------------------
 //
-// TimerThread - Thread that creates dumps based on specified timer
-// interval.
+// DetachStoppingThreads - Waits for the traced threads to stop and
+// detaches from them, a signal about to be delivered is passed on.
 //
 //--------------------------------------------------------------------
-void *TimerThread(void *thread_args /* struct ProcDumpConfiguration* */)
+static void DetachStoppingThreads(std::set<pid_t>& tracees)
 {
-    Trace("TimerThread: Enter [id=%d]", gettid());
-
-    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
-    auto_free struct CoreDumpWriter *writer = NULL;
-    auto_free char* dumpFileName = NULL;
-    std::vector<pthread_t> leakReportThreads;
-
-    writer = NewCoreDumpWriter(TIME, config);
+    std::set<pid_t> detached;
+    int wstatus = 0;
 
-    int rc = 0;
-
-    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    while (tracees.empty() == false)
     {
-        while ((rc = WaitForQuit(config, 0)) == WAIT_TIMEOUT)
+        pid_t stopped = waitpid(-1, &wstatus, __WALL | __WNOTHREAD);
+        if (stopped == -1)
         {
-            Log(info, "Trigger: Timer:%ld(s) on process ID: %d", config->PollingInterval/1000, config->ProcessId);
-            if(config->bRestrackGenerateDump == true)
+            if (errno == EINTR)
             {
-                // Only generate core dump if user did not specify the "nodump" restrack option
-                dumpFileName = WriteCoreDump(writer);
-                if(dumpFileName == NULL)
-                {
-                    SetQuit(config, 1);
-                }
+                continue;
             }
 
-            //
-            // Check to see if restrack is specified, if so, save current resource usage to file.
-            //
-#ifdef __linux__            
-            if(config->bRestrackEnabled == true)
+            break;
+        }
+
+        if (WIFEXITED(wstatus) || WIFSIGNALED(wstatus))
+        {
+            tracees.erase(stopped);
+        }
+        else if (WIFSTOPPED(wstatus))
+        {
+            int event = wstatus >> 16;
+            if (event == PTRACE_EVENT_CLONE)
             {
-                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
-                if (id == 0)
-                {
-                    SetQuit(config, 1);
-                }
-                else
+                // The new thread can report its first stop (and be detached) before the clone event
+                unsigned long newTid = 0;
+                if (ptrace(PTRACE_GETEVENTMSG, stopped, NULL, &newTid) != -1 && detached.count(newTid) == 0)
                 {
-                    leakReportThreads.push_back(id);
+                    tracees.insert(newTid);
                 }
             }
-#endif            
 
-            if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT) {
-                break;
-            }
+            // A signal about to be delivered is passed on, it's handled once the process is continued
+            ptrace(PTRACE_DETACH, stopped, NULL, event == 0 ? WSTOPSIG(wstatus) : 0);
+            tracees.erase(stopped);
+            detached.insert(stopped);
         }
     }
+}
+
+//--------------------------------------------------------------------
+//
+// StopProcessThreads - Stops the process in place of the crash
+// signal of the given thread and detaches from all the threads, they
+// stay stopped until the process is continued.
+//
+//--------------------------------------------------------------------
+static void StopProcessThreads(pid_t tid, std::set<pid_t>& tracees)
+{
+    ptrace(PTRACE_DETACH, tid, NULL, SIGSTOP);
+    tracees.erase(tid);
 
     //
-    // Wait for the leak reporting threads to finish
+    // The other threads report a stop as they join the group stop.
     //
-    WaitThreads(leakReportThreads);
-
-    Trace("TimerThread: Exit [id=%d]", gettid());
-    return NULL;
+    DetachStoppingThreads(tracees);
 }
 
 //--------------------------------------------------------------------
 //
-// DotNetMonitoringThread - Thread that creates dumps based on
-// dotnet triggers.
-//
-// NOTE: .NET only.
-// NOTE: At the moment, .NET triggers are mutually exclusive meaning
-// only one can be specified at a time. For example, you cannot specify
-// both exception based monitoring and GC based monitoring.
+// DetachProcessThreads - Interrupts all the traced threads and detaches
+// from them, the process keeps running.
 //
 //--------------------------------------------------------------------
-void *DotNetMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+static void DetachProcessThreads(std::set<pid_t>& tracees)
 {
-    Trace("DotNetMonitoringThread: Enter [id=%d]", gettid());
-#ifdef __linux__    
-    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
-    auto_free char* fullDumpPath = NULL;
-    auto_cancel_thread pthread_t waitForProfilerCompletion = -1;
-    auto_free char* clientData = NULL;
-
-    int rc = 0;
-
-    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    for (auto it = tracees.begin(); it != tracees.end();)
     {
-        if(config->CoreDumpName == NULL)
+        // A thread that already exited won't report a stop
+        if (ptrace(PTRACE_INTERRUPT, *it, NULL, NULL) == -1)
         {
-            // We don't have a dump name so we just use the path (append a '/' to indicate its a base path)
-            if(config->CoreDumpPath[strlen(config->CoreDumpPath)-1] != '/')
-            {
-                fullDumpPath = (char*) malloc(strlen(config->CoreDumpPath) + 2);    // +1 = '\0', +1 = '/'
-                if(fullDumpPath == NULL)
-                {
-                    Trace("DotNetMonitoringThread: Failed to allocate memory.");
-                    return NULL;
-                }
-
-                snprintf(fullDumpPath, strlen(config->CoreDumpPath) + 2, "%s/", config->CoreDumpPath);
-            }
-            else
-            {
-                fullDumpPath = (char*) malloc(strlen(config->CoreDumpPath) + 1);
-                if(fullDumpPath == NULL)
-                {
-                    Trace("DotNetMonitoringThread: Failed to allocate memory.");
-                    return NULL;
-                }
-
-                snprintf(fullDumpPath, strlen(config->CoreDumpPath) + 1, "%s", config->CoreDumpPath);
-            }
+            it = tracees.erase(it);
         }
         else
         {
-            // We have a dump name, let's append to dump path
-            if(config->CoreDumpPath[strlen(config->CoreDumpPath)] != '/')
-            {
-                fullDumpPath = (char*) malloc(strlen(config->CoreDumpPath) + strlen(config->CoreDumpName) + 2);    // +1 = '\0', +1 = '/'
-                if(fullDumpPath == NULL)
-                {
-                    Trace("DotNetMonitoringThread: Failed to allocate memory.");
-                    return NULL;
-                }
+            ++it;
+        }
+    }
 
-                snprintf(fullDumpPath, strlen(config->CoreDumpPath) + strlen(config->CoreDumpName) + 2, "%s/%s", config->CoreDumpPath, config->CoreDumpName);
+    DetachStoppingThreads(tracees);
+}
+
+//--------------------------------------------------------------------
+//
+// CrashWakeHandler - Handler of CRASH_WAKE_SIGNAL, it only interrupts
+// the waitpid call of the crash monitoring thread.
+//
+//--------------------------------------------------------------------
+static void CrashWakeHandler(int signum)
+{
+}
+
+//--------------------------------------------------------------------
+//
+// CrashWakeThread - Wakes the crash monitoring thread out of waitpid
+// until it's done once procdump quits. The signal is sent again in
+// case it arrived just before the thread went back to waitpid.
+//
+//--------------------------------------------------------------------
+static void* CrashWakeThread(void *thread_args /* struct CrashWake* */)
+{
+    struct CrashWake *wake = (struct CrashWake *)thread_args;
+
+    if (WaitForQuitOrEvent(wake->config, &wake->evtDone, INFINITE_WAIT) != WAIT_OBJECT_0 + 1)
+    {
+        do
+        {
+            syscall(SYS_tgkill, getpid(), wake->tid, CRASH_WAKE_SIGNAL);
+        }
+        while (WaitForSingleObject(&wake->evtDone, CRASH_WAKE_INTERVAL) == WAIT_TIMEOUT);
+    }
+
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// LogCrashRegisters - Logs the registers of the crashing thread.
+//
+//--------------------------------------------------------------------
+static void LogCrashRegisters(pid_t tid)
+{
+    struct user_regs_struct regs = {};
+    struct iovec iov = { &regs, sizeof(regs) };
+
+    if (ptrace(PTRACE_GETREGSET, tid, NT_PRSTATUS, &iov) == -1)
+    {
+        Trace("LogCrashRegisters: Failed to get the registers of thread %d (%s).", tid, strerror(errno));
+        return;
+    }
+
+#if defined(__x86_64__)
+    Log(info, "    rip:0x%016llx rsp:0x%016llx rbp:0x%016llx eflags:0x%llx", regs.rip, regs.rsp, regs.rbp, regs.eflags);
+    Log(info, "    rax:0x%016llx rbx:0x%016llx rcx:0x%016llx rdx:0x%016llx", regs.rax, regs.rbx, regs.rcx, regs.rdx);
+    Log(info, "    rsi:0x%016llx rdi:0x%016llx r8: 0x%016llx r9: 0x%016llx", regs.rsi, regs.rdi, regs.r8, regs.r9);
+    Log(info, "    r10:0x%016llx r11:0x%016llx r12:0x%016llx r13:0x%016llx", regs.r10, regs.r11, regs.r12, regs.r13);
+    Log(info, "    r14:0x%016llx r15:0x%016llx", regs.r14, regs.r15);
+#elif defined(__aarch64__)
+    Log(info, "    pc:0x%016llx sp:0x%016llx pstate:0x%llx", regs.pc, regs.sp, regs.pstate);
+    for (int i = 0; i < 31; i += 4)
+    {
+        char line[128];
+        int len = 0;
+        for (int j = i; j < i + 4 && j < 31; j++)
+        {
+            len += snprintf(line + len, sizeof(line) - len, "%sx%d:0x%016llx", j == i ? "" : " ", j, regs.regs[j]);
+        }
+
+        Log(info, "    %s", line);
+    }
+#endif
+}
+#endif
+
+//--------------------------------------------------------------------
+//
+// CrashMonitoringThread - Thread monitoring for crashes (-crash). All
+// the threads of the target are traced (ptrace) so that a fatal
+// SIGSEGV, SIGBUS or SIGABRT is seen before its default action. The
+// process is then stopped and dumped and the signal is raised again to
+// let it terminate the process as it would have. Neither eBPF nor ptrace
+// can hold a fatal signal without also seeing the others, every signal
+// costs the receiving thread a stop while it's passed on. On quit, the
+// thread is woken out of waitpid and detaches from the process.
+//
+//--------------------------------------------------------------------
+void* CrashMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("CrashMonitoringThread: Enter [id=%d]", gettid());
+#ifdef __linux__
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+    std::set<pid_t> tracees;
+    siginfo_t sigInfo = {};
+    int wstatus = 0;
+    int rc = 0;
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+
+    writer = NewCoreDumpWriter(CRASH, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        struct sigaction wakeAction = {};
+        struct CrashWake wake = {};
+        pthread_t wakeThread = 0;
+
+        // No SA_RESTART, waitpid fails with EINTR
+        wakeAction.sa_handler = CrashWakeHandler;
+        sigaction(CRASH_WAKE_SIGNAL, &wakeAction, NULL);
+
+        wake.config = config;
+        wake.tid = gettid();
+        InitNamedEvent(&wake.evtDone.event, true, false, const_cast<char*>("CrashDone"));
+        wake.evtDone.type = EVENT;
+
+        if (pthread_create(&wakeThread, NULL, CrashWakeThread, &wake) != 0)
+        {
+            Trace("CrashMonitoringThread: failed to create CrashWakeThread.");
+            wakeThread = 0;
+        }
+
+        if (SeizeProcessThreads(config->ProcessId, tracees) == false)
+        {
+            Log(error, "Unable to PTRACE the target process");
+        }
+
+        //
+        // Only wait for the tracees of this thread, other threads of procdump have their own
+        // children (gcore) and tracees (other targets).
+        //
+        while (tracees.empty() == false && IsQuit(config) == false)
+        {
+            pid_t tid = waitpid(-1, &wstatus, __WALL | __WNOTHREAD);
+            if (tid == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                break;
+            }
+
+            if (WIFEXITED(wstatus) || WIFSIGNALED(wstatus))
+            {
+                tracees.erase(tid);
+                continue;
+            }
+
+            if (!WIFSTOPPED(wstatus))
+            {
+                continue;
+            }
+
+            // New threads can report their first stop before the clone event of their creator
+            tracees.insert(tid);
+
+            int signum = WSTOPSIG(wstatus);
+            int event = wstatus >> 16;
+            if (event == PTRACE_EVENT_CLONE)
+            {
+                unsigned long newTid = 0;
+                if (ptrace(PTRACE_GETEVENTMSG, tid, NULL, &newTid) != -1)
+                {
+                    tracees.insert(newTid);
+                }
+
+                ptrace(PTRACE_CONT, tid, NULL, 0);
+                continue;
+            }
+
+            if (event == PTRACE_EVENT_STOP)
+            {
+                // Threads in a group stop stay stopped, other stops (such as a new thread) continue
+                if (signum == SIGSTOP || signum == SIGTSTP || signum == SIGTTIN || signum == SIGTTOU)
+                {
+                    ptrace(PTRACE_LISTEN, tid, NULL, NULL);
+                }
+                else
+                {
+                    ptrace(PTRACE_CONT, tid, NULL, 0);
+                }
+
+                continue;
+            }
+
+            //
+            // Signal delivery stop, every other signal is delivered right away.
+            //
+            if (event != 0 || IsCrashSignal(config->ProcessId, signum) == false)
+            {
+                ptrace(PTRACE_CONT, tid, NULL, event != 0 ? 0 : signum);
+                continue;
+            }
+
+            pthread_mutex_lock(&config->ptrace_mutex);
+
+            ptrace(PTRACE_GETSIGINFO, tid, NULL, &sigInfo);
+            Log(info, "Trigger: Crash signal:%d (thread %d, address %p, code %d) on process ID: %d", signum, tid, sigInfo.si_addr, sigInfo.si_code, config->ProcessId);
+            LogCrashRegisters(tid);
+
+            // We have to detach in a STOP state so we can invoke gcore
+            StopProcessThreads(tid, tracees);
+
+            // The dump isn't interrupted, a quit kills gcore
+            SetEvent(&wake.evtDone.event);
+
+            if(config->bRestrackGenerateDump == true)
+            {
+                // Only generate core dump if user did not specify the "nodump" restrack option
+                dumpFileName = WriteCoreDump(writer);
+            }
+
+            //
+            // Check to see if restrack is specified, if so, save current resource usage to file.
+            //
+            if(config->bRestrackEnabled == true)
+            {
+                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                if (id != 0)
+                {
+                    leakReportThreads.push_back(id);
+                }
+            }
+
+            //
+            // Raise the crash signal again on the same thread, it takes its default action once the
+            // process is continued.
+            //
+            syscall(SYS_tgkill, config->ProcessId, tid, signum);
+            kill(config->ProcessId, SIGCONT);
+
+            pthread_mutex_unlock(&config->ptrace_mutex);
+            break;
+        }
+
+        //
+        // Quit or the waitpid failed, the process keeps running untraced.
+        //
+        DetachProcessThreads(tracees);
+
+        SetEvent(&wake.evtDone.event);
+        if (wakeThread != 0)
+        {
+            pthread_join(wakeThread, NULL);
+        }
+
+        DestroyEvent(&wake.evtDone.event);
+    }
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+#endif
+    Trace("CrashMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// CpuMonitoringThread - Thread monitoring for CPU usage.
+//
+//--------------------------------------------------------------------
+void *CpuMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("CpuMonitoringThread: Enter [id=%d]", gettid());
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    unsigned long totalTime = 0;
+    unsigned long elapsedTime = 0;
+    int cpuUsage;
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+#ifdef __linux__
+    std::vector<pthread_t> leakReportThreads;
+#endif
+
+    writer = NewCoreDumpWriter(CPU, config);
+
+    int rc = 0;
+    struct ProcessStat proc = {0};
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        while ((rc = WaitForQuit(config, config->PollingInterval)) == WAIT_TIMEOUT)
+        {
+            if (GetProcessStat(config->ProcessId, &proc))
+            {
+                cpuUsage = GetCpuUsage(config->ProcessId);
+                Trace("CpuMonitoringThread: CPU usage:%d%% on process ID: %d", cpuUsage, config->ProcessId);
+
+                // CPU Trigger
+                if ((config->bCpuTriggerBelowValue && (cpuUsage < config->CpuThreshold)) ||
+                    (!config->bCpuTriggerBelowValue && (cpuUsage >= config->CpuThreshold)))
+                {
+                    Log(info, "Trigger: CPU usage:%d%% on process ID: %d", cpuUsage, config->ProcessId);
+                    if(config->bRestrackGenerateDump == true)
+                    {
+                        // Only generate core dump if user did not specify the "nodump" restrack option
+                        dumpFileName = WriteCoreDump(writer);
+                        if(dumpFileName == NULL)
+                        {
+                            SetQuit(config, 1);
+                        }
+                    }
+
+                    //
+                    // Check to see if restrack is specified, if so, save current resource usage to file.
+                    //
+#ifdef __linux__                    
+                    if(config->bRestrackEnabled == true)
+                    {
+                        pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                        if (id == 0)
+                        {
+                            SetQuit(config, 1);
+                        }
+                        else
+                        {
+                            leakReportThreads.push_back(id);
+                        }
+                    }
+#endif                    
+
+                    if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
+                    {
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                Log(error, "An error occurred while parsing procfs\n");
+                exit(-1);
+            }
+        }
+    }
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+#ifdef __linux__    
+    WaitThreads(leakReportThreads);
+#endif
+
+    Trace("CpuMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+#ifdef __linux__
+//--------------------------------------------------------------------
+//
+// CpuEbpfMonitoringThread - Thread monitoring for CPU usage measured
+// in-kernel over a rolling window (-cw). The thread blocks until the
+// eBPF program reports that the threshold was crossed, so bursts
+// shorter than the polling interval are caught and no procfs reads
+// are needed. Falls back to polling if the program can't be loaded.
+//
+//--------------------------------------------------------------------
+void *CpuEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("CpuEbpfMonitoringThread: Enter [id=%d]", gettid());
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+    struct TriggerEvent event = {};
+    int rc = 0;
+
+    struct EbpfTrigger* trigger = StartEbpfTrigger(config, TRIGGER_CPU);
+    if (trigger == NULL)
+    {
+        Log(warn, "Failed to measure the CPU usage in-kernel, falling back to polling.");
+        return CpuMonitoringThread(thread_args);
+    }
+
+    writer = NewCoreDumpWriter(CPU, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        //
+        // The event is also signaled when monitoring should stop, which the wait reports.
+        //
+        while ((rc = WaitForQuitOrEvent(config, &trigger->evtTriggered, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+        {
+            ResetEvent(&trigger->evtTriggered.event);
+            if (GetEbpfTriggerEvent(trigger, &event) == false)
+            {
+                continue;
+            }
+
+            Log(info, "Trigger: CPU usage:%d%% over %dms (thread %d) on process ID: %d", (int) event.value, config->CpuWindow, event.pid, config->ProcessId);
+            if(config->bRestrackGenerateDump == true)
+            {
+                // Only generate core dump if user did not specify the "nodump" restrack option
+                dumpFileName = WriteCoreDump(writer);
+                if(dumpFileName == NULL)
+                {
+                    SetQuit(config, 1);
+                }
+            }
+
+            //
+            // Check to see if restrack is specified, if so, save current resource usage to file.
+            //
+            if(config->bRestrackEnabled == true)
+            {
+                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                if (id == 0)
+                {
+                    SetQuit(config, 1);
+                }
+                else
+                {
+                    leakReportThreads.push_back(id);
+                }
+            }
+
+            if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
+            {
+                break;
+            }
+
+            RearmEbpfTrigger(trigger);
+        }
+    }
+
+    StopEbpfTrigger(trigger);
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+    Trace("CpuEbpfMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// CommitEbpfMonitoringThread - Thread monitoring for memory commit
+// measured in-kernel (-mh). The eBPF program follows the memory
+// counters of the process and reports when the current threshold is
+// crossed, the same threshold is reported again once the usage moved
+// back by the hysteresis. Falls back to polling if the program can't
+// be loaded.
+//
+//--------------------------------------------------------------------
+void *CommitEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("CommitEbpfMonitoringThread: Enter [id=%d]", gettid());
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+    struct TriggerEvent event = {};
+    int rc = 0;
+
+    struct EbpfTrigger* trigger = StartEbpfTrigger(config, TRIGGER_MEMORY);
+    if (trigger == NULL)
+    {
+        Log(warn, "Failed to measure the commit usage in-kernel, falling back to polling.");
+        return CommitMonitoringThread(thread_args);
+    }
+
+    writer = NewCoreDumpWriter(COMMIT, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        //
+        // The event is also signaled when monitoring should stop, which the wait reports.
+        //
+        while ((rc = WaitForQuitOrEvent(config, &trigger->evtTriggered, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+        {
+            ResetEvent(&trigger->evtTriggered.event);
+            if (GetEbpfTriggerEvent(trigger, &event) == false)
+            {
+                continue;
+            }
+
+            Log(info, "Trigger: Commit usage:%ldMB (in-kernel) on process ID: %d", (long) (event.value >> 20), config->ProcessId);
+            if(config->bRestrackGenerateDump == true)
+            {
+                // Only generate core dump if user did not specify the "nodump" restrack option
+                dumpFileName = WriteCoreDump(writer);
+                if(dumpFileName == NULL)
+                {
+                    SetQuit(config, 1);
+                }
+            }
+
+            //
+            // Check to see if restrack is specified, if so, save current resource usage to file.
+            //
+            if(config->bRestrackEnabled == true)
+            {
+                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                if (id == 0)
+                {
+                    SetQuit(config, 1);
+                }
+                else
+                {
+                    leakReportThreads.push_back(id);
+                }
+            }
+
+            config->MemoryCurrentThreshold++;
+
+            if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
+            {
+                break;
+            }
+
+            RearmEbpfTrigger(trigger);
+        }
+    }
+
+    StopEbpfTrigger(trigger);
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+    Trace("CommitEbpfMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// SignalEbpfMonitoringThread - Thread monitoring for signals (-sig)
+// intercepted in-kernel. The eBPF program only stops the target for
+// the signals of interest, other signals are delivered without
+// involving procdump and the target isn't traced in between. Falls
+// back to ptrace if the program can't be loaded.
+//
+//--------------------------------------------------------------------
+void *SignalEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("SignalEbpfMonitoringThread: Enter [id=%d]", gettid());
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+    struct TriggerEvent event = {};
+    int signum = -1;
+    int rc = 0;
+
+    struct EbpfTrigger* trigger = StartEbpfTrigger(config, TRIGGER_SIGNAL);
+    if (trigger == NULL)
+    {
+        Log(warn, "Failed to intercept the signals in-kernel, falling back to ptrace.");
+        return SignalMonitoringThread(thread_args);
+    }
+
+    //
+    // The thread stops on quit like the other triggers, cancelling it (see SignalThread) could
+    // leave the target stopped.
+    //
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    writer = NewCoreDumpWriter(SIGNAL, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        //
+        // The event is also signaled when monitoring should stop, which the wait reports.
+        //
+        while ((rc = WaitForQuitOrEvent(config, &trigger->evtTriggered, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+        {
+            ResetEvent(&trigger->evtTriggered.event);
+            if (GetEbpfTriggerEvent(trigger, &event) == false)
+            {
+                continue;
+            }
+
+            signum = event.value & ~TRIGGER_SIGNAL_STOPPED;
+            if ((event.value & TRIGGER_SIGNAL_STOPPED) == 0)
+            {
+                Log(warn, "Signal:%d terminated process ID: %d before it could be dumped (no signal handler).", signum, config->ProcessId);
+                RearmEbpfTrigger(trigger);
+                continue;
+            }
+
+            // Write core dump
+            Log(info, "Trigger: Signal:%d (thread %d) on process ID: %d", signum, event.pid, config->ProcessId);
+
+            if(config->bRestrackGenerateDump == true)
+            {
+                // Only generate core dump if user did not specify the "nodump" restrack option
+                dumpFileName = WriteCoreDump(writer);
+                if(dumpFileName == NULL)
+                {
+                    SetQuit(config, 1);
+                }
+            }
+
+            //
+            // Check to see if restrack is specified, if so, save current resource usage to file.
+            //
+            if(config->bRestrackEnabled == true)
+            {
+                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                if (id != 0)
+                {
+                    leakReportThreads.push_back(id);
+                }
+            }
+
+            // Continue the target, the signal is then handled as usual
+            ContinueEbpfTriggerTarget(trigger);
+
+            //
+            // Once monitoring stops the target must not be stopped anymore, nothing would
+            // continue it.
+            //
+            if (ContinueMonitoring(config) == false)
+            {
+                break;
+            }
+
+            RearmEbpfTrigger(trigger);
+        }
+    }
+
+    StopEbpfTrigger(trigger);
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+    Trace("SignalEbpfMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// ThreadCountEbpfMonitoringThread - Thread monitoring for thread count
+// counted in-kernel. The eBPF program keeps the count seeded from
+// procfs up to date on thread creation and exit and reports when it
+// reaches the threshold, the count is then confirmed from procfs.
+// Falls back to polling if the program can't be loaded.
+//
+//--------------------------------------------------------------------
+void *ThreadCountEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("ThreadCountEbpfMonitoringThread: Enter [id=%d]", gettid());
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    struct ProcessStat proc = {0};
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+    struct TriggerEvent event = {};
+    int rc = 0;
+
+    struct EbpfTrigger* trigger = StartEbpfTrigger(config, TRIGGER_THREAD_COUNT);
+    if (trigger == NULL)
+    {
+        Log(warn, "Failed to count the threads in-kernel, falling back to polling.");
+        return ThreadCountMonitoringThread(thread_args);
+    }
+
+    writer = NewCoreDumpWriter(THREAD, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        //
+        // The event is also signaled when monitoring should stop, which the wait reports.
+        //
+        while ((rc = WaitForQuitOrEvent(config, &trigger->evtTriggered, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+        {
+            ResetEvent(&trigger->evtTriggered.event);
+            if (GetEbpfTriggerEvent(trigger, &event) == false)
+            {
+                continue;
+            }
+
+            if (GetProcessStat(config->ProcessId, &proc) == false)
+            {
+                Trace("ThreadCountEbpfMonitoringThread: Failed to get the stats of process %d.", config->ProcessId);
+                continue;
+            }
+
+            if (proc.num_threads >= config->ThreadThreshold)
+            {
+                Log(info, "Trigger: Thread count:%ld on process ID: %d", (long) proc.num_threads, config->ProcessId);
+
+                if(config->bRestrackGenerateDump == true)
+                {
+                    // Only generate core dump if user did not specify the "nodump" restrack option
+                    dumpFileName = WriteCoreDump(writer);
+                    if(dumpFileName == NULL)
+                    {
+                        SetQuit(config, 1);
+                    }
+                }
+
+                //
+                // Check to see if restrack is specified, if so, save current resource usage to file.
+                //
+                if(config->bRestrackEnabled == true)
+                {
+                    pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                    if (id == 0)
+                    {
+                        SetQuit(config, 1);
+                    }
+                    else
+                    {
+                        leakReportThreads.push_back(id);
+                    }
+                }
+
+                if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
+                {
+                    break;
+                }
+            }
+
+            RearmEbpfTrigger(trigger);
+        }
+    }
+
+    StopEbpfTrigger(trigger);
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+    Trace("ThreadCountEbpfMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// FileDescriptorCountEbpfMonitoringThread - Thread monitoring for file
+// descriptor count counted in-kernel. The eBPF program keeps the
+// count seeded from procfs up to date on the syscalls that create or
+// close descriptors and reports when it reaches the threshold, the
+// count is then confirmed from procfs. Since some descriptors aren't
+// counted (io_uring, ...), the count is also seeded again every
+// FD_COUNT_RESYNC_INTERVAL. Falls back to polling if the program can't
+// be loaded.
+//
+//--------------------------------------------------------------------
+void *FileDescriptorCountEbpfMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("FileDescriptorCountEbpfMonitoringThread: Enter [id=%d]", gettid());
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    struct ProcessStat proc = {0};
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+    struct TriggerEvent event = {};
+    int rc = 0;
+
+    struct EbpfTrigger* trigger = StartEbpfTrigger(config, TRIGGER_FD_COUNT);
+    if (trigger == NULL)
+    {
+        Log(warn, "Failed to count the file descriptors in-kernel, falling back to polling.");
+        return FileDescriptorCountMonitoringThread(thread_args);
+    }
+
+    writer = NewCoreDumpWriter(FILEDESC, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        //
+        // The event is also signaled when monitoring should stop, which the wait reports.
+        //
+        while ((rc = WaitForQuitOrEvent(config, &trigger->evtTriggered, FD_COUNT_RESYNC_INTERVAL)) == WAIT_OBJECT_0 + 1 || rc == WAIT_TIMEOUT)
+        {
+            if (rc == WAIT_TIMEOUT)
+            {
+                ResyncEbpfTrigger(trigger);
+                continue;
+            }
+
+            ResetEvent(&trigger->evtTriggered.event);
+            if (GetEbpfTriggerEvent(trigger, &event) == false)
+            {
+                continue;
+            }
+
+            if (GetProcessStat(config->ProcessId, &proc) == false)
+            {
+                Trace("FileDescriptorCountEbpfMonitoringThread: Failed to get the stats of process %d.", config->ProcessId);
+                continue;
+            }
+
+            if (proc.num_filedescriptors >= config->FileDescriptorThreshold)
+            {
+                Log(info, "Trigger: File descriptor count:%ld on process ID: %d", (long) proc.num_filedescriptors, config->ProcessId);
+
+                if(config->bRestrackGenerateDump == true)
+                {
+                    // Only generate core dump if user did not specify the "nodump" restrack option
+                    dumpFileName = WriteCoreDump(writer);
+                    if(dumpFileName == NULL)
+                    {
+                        SetQuit(config, 1);
+                    }
+                }
+
+                //
+                // Check to see if restrack is specified, if so, save current resource usage to file.
+                //
+                if(config->bRestrackEnabled == true)
+                {
+                    pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                    if (id == 0)
+                    {
+                        SetQuit(config, 1);
+                    }
+                    else
+                    {
+                        leakReportThreads.push_back(id);
+                    }
+                }
+
+                if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
+                {
+                    break;
+                }
+            }
+
+            RearmEbpfTrigger(trigger);
+        }
+    }
+
+    StopEbpfTrigger(trigger);
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+    Trace("FileDescriptorCountEbpfMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// ProbeMonitoringThread - Thread monitoring for hits of the -uprobe
+// function, the -usdt probe or the -se syscall errors. The eBPF
+// program counts the hits (or their rate per second) and reports when
+// -ph is reached. With -pl, it reports calls of the -uprobe function
+// that run longer than the latency instead. There is no polling
+// equivalent, monitoring stops if the probe can't be attached.
+//
+//--------------------------------------------------------------------
+void *ProbeMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("ProbeMonitoringThread: Enter [id=%d]", gettid());
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+    struct TriggerEvent event = {};
+    int rc = 0;
+
+    unsigned int type = TRIGGER_PROBE;
+    if (config->ProbeLatency != -1)
+    {
+        type = TRIGGER_LATENCY;
+    }
+    else if (config->SyscallErrorCount > 0)
+    {
+        type = TRIGGER_SYSCALL_ERROR;
+    }
+
+    struct EbpfTrigger* trigger = StartEbpfTrigger(config, type);
+    if (trigger == NULL)
+    {
+        if (type == TRIGGER_SYSCALL_ERROR)
+        {
+            Log(error, "Failed to trace the syscall errors of process ID: %d.", config->ProcessId);
+        }
+        else
+        {
+            Log(error, "Failed to attach the probe %s on process ID: %d.", config->Usdt != NULL ? config->Usdt : config->Uprobe, config->ProcessId);
+        }
+        SetQuit(config, 1);
+        Trace("ProbeMonitoringThread: Exit [id=%d]", gettid());
+        return NULL;
+    }
+
+    writer = NewCoreDumpWriter(type == TRIGGER_SYSCALL_ERROR ? SYSCALL : PROBE, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        //
+        // The event is also signaled when monitoring should stop, which the wait reports.
+        //
+        while ((rc = WaitForQuitOrEvent(config, &trigger->evtTriggered, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+        {
+            ResetEvent(&trigger->evtTriggered.event);
+            if (GetEbpfTriggerEvent(trigger, &event) == false)
+            {
+                continue;
+            }
+
+            if(event.type == TRIGGER_LATENCY)
+            {
+                Log(info, "Trigger: Uprobe %s latency:%lu ms (thread %d) on process ID: %d", config->Uprobe, (unsigned long) (event.value / 1000000), event.pid, config->ProcessId);
+                LogEbpfTriggerStack(trigger, &event);
+            }
+            else if(event.type == TRIGGER_SYSCALL_ERROR)
+            {
+                int syscall = event.detail >> 16;
+                int error = event.detail & 0xffff;
+                const char* syscallName = GetSyscallName(syscall);
+                const char* errorName = GetErrnoName(error);
+
+                Log(info, "Trigger: Syscall error %s%s%d in %s%s%d %s:%lu (thread %d) on process ID: %d",
+                    errorName != NULL ? errorName : "", errorName != NULL ? "/" : "", error,
+                    syscallName != NULL ? syscallName : "", syscallName != NULL ? "/" : "", syscall,
+                    config->bProbeHitRate ? "errors/s" : "errors", (unsigned long) event.value, event.pid, config->ProcessId);
+                LogEbpfTriggerStack(trigger, &event);
+            }
+            else if(config->Usdt != NULL)
+            {
+                Log(info, "Trigger: USDT probe %s %s:%lu (thread %d) on process ID: %d", config->Usdt, config->bProbeHitRate ? "hits/s" : "hits", (unsigned long) event.value, event.pid, config->ProcessId);
+            }
+            else
+            {
+                Log(info, "Trigger: Uprobe %s %s:%lu (thread %d) on process ID: %d", config->Uprobe, config->bProbeHitRate ? "calls/s" : "calls", (unsigned long) event.value, event.pid, config->ProcessId);
+            }
+
+            if(config->bRestrackGenerateDump == true)
+            {
+                // Only generate core dump if user did not specify the "nodump" restrack option
+                dumpFileName = WriteCoreDump(writer);
+                if(dumpFileName == NULL)
+                {
+                    SetQuit(config, 1);
+                }
+            }
+
+            //
+            // Check to see if restrack is specified, if so, save current resource usage to file.
+            //
+            if(config->bRestrackEnabled == true)
+            {
+                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                if (id == 0)
+                {
+                    SetQuit(config, 1);
+                }
+                else
+                {
+                    leakReportThreads.push_back(id);
+                }
+            }
+
+            if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
+            {
+                break;
+            }
+
+            RearmEbpfTrigger(trigger);
+        }
+    }
+
+    StopEbpfTrigger(trigger);
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+    Trace("ProbeMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// NativeExceptionMonitoringThread - Thread monitoring for C++
+// exceptions (-ne). The eBPF program stops the process at the throw
+// site, the type of the exception is then matched against the -f
+// filters like .NET exceptions and each filter creates up to -n dumps.
+// The program already skips new types that can't match, types that
+// don't match (or whose filters have no dumps left) are filtered out
+// in-kernel from then on. There is no polling
+// equivalent, monitoring stops if __cxa_throw can't be attached.
+//
+//--------------------------------------------------------------------
+void *NativeExceptionMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("NativeExceptionMonitoringThread: Enter [id=%d]", gettid());
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+    std::vector<std::string> filters;
+    std::vector<int> collectedDumps;
+    std::string exceptionName;
+    struct TriggerEvent event = {};
+    char* savePtr = NULL;
+    int rc = 0;
+
+    //
+    // Partial matches like the .NET exception filters (see GetEncodedExceptionFilter), any
+    // exception if no filter is specified.
+    //
+    char* cpy = strdup(config->ExceptionFilter != NULL ? config->ExceptionFilter : "*");
+    if (cpy == NULL)
+    {
+        Log(error, INTERNAL_ERROR);
+        SetQuit(config, 1);
+        Trace("NativeExceptionMonitoringThread: Exit [id=%d]", gettid());
+        return NULL;
+    }
+
+    for (char* token = strtok_r(cpy, ",", &savePtr); token != NULL; token = strtok_r(NULL, ",", &savePtr))
+    {
+        std::string filter = token;
+        if (filter.front() != '*')
+        {
+            filter.insert(0, "*");
+        }
+        if (filter.back() != '*')
+        {
+            filter.append("*");
+        }
+
+        filters.push_back(filter);
+        collectedDumps.push_back(0);
+    }
+    free(cpy);
+
+    struct EbpfTrigger* trigger = StartEbpfTrigger(config, TRIGGER_EXCEPTION);
+    if (trigger == NULL)
+    {
+        Log(error, "Failed to attach to __cxa_throw of process ID: %d.", config->ProcessId);
+        SetQuit(config, 1);
+        Trace("NativeExceptionMonitoringThread: Exit [id=%d]", gettid());
+        return NULL;
+    }
+
+    //
+    // Cancelling the thread could leave the target stopped, see SignalEbpfMonitoringThread.
+    //
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    writer = NewCoreDumpWriter(EXCEPTION, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        //
+        // The event is also signaled when monitoring should stop, which the wait reports.
+        //
+        while ((rc = WaitForQuitOrEvent(config, &trigger->evtTriggered, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+        {
+            ResetEvent(&trigger->evtTriggered.event);
+            if (GetEbpfTriggerEvent(trigger, &event) == false)
+            {
+                continue;
+            }
+
+            int filter = -1;
+            if (GetEbpfTriggerExceptionType(trigger, &event, exceptionName) == true)
+            {
+                for (size_t i = 0; i < filters.size(); i++)
+                {
+                    if (collectedDumps[i] < config->NumberOfDumpsToCollect && WildcardSearch(const_cast<char*>(exceptionName.c_str()), const_cast<char*>(filters[i].c_str())))
+                    {
+                        filter = i;
+                        break;
+                    }
+                }
+            }
+
+            if (filter == -1)
+            {
+                Trace("NativeExceptionMonitoringThread: Ignoring exception %s.", exceptionName.c_str());
+                IgnoreEbpfTriggerExceptionType(trigger, &event);
+            }
+            else
+            {
+                Log(info, "Trigger: Exception %s (thread %d) on process ID: %d", exceptionName.c_str(), event.pid, config->ProcessId);
+                LogEbpfTriggerStack(trigger, &event);
+
+                if(config->bRestrackGenerateDump == true)
+                {
+                    // Only generate core dump if user did not specify the "nodump" restrack option
+                    dumpFileName = WriteCoreDump(writer);
+                    if(dumpFileName == NULL)
+                    {
+                        SetQuit(config, 1);
+                    }
+                }
+
+                //
+                // Check to see if restrack is specified, if so, save current resource usage to file.
+                //
+                if(config->bRestrackEnabled == true)
+                {
+                    pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                    if (id != 0)
+                    {
+                        leakReportThreads.push_back(id);
+                    }
+                }
+
+                collectedDumps[filter]++;
+            }
+
+            // Continue the target, the exception is then thrown as usual
+            ContinueEbpfTriggerTarget(trigger);
+
+            //
+            // Once monitoring stops the target must not be stopped anymore, nothing would
+            // continue it.
+            //
+            if (ContinueMonitoring(config) == false)
+            {
+                break;
+            }
+
+            RearmEbpfTrigger(trigger);
+        }
+    }
+
+    StopEbpfTrigger(trigger);
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+    Trace("NativeExceptionMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+#endif
+
+//--------------------------------------------------------------------
+//
+// TimerThread - Thread that creates dumps based on specified timer
+// interval.
+//
+//--------------------------------------------------------------------
+void *TimerThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("TimerThread: Enter [id=%d]", gettid());
+
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+
+    writer = NewCoreDumpWriter(TIME, config);
+
+    int rc = 0;
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        while ((rc = WaitForQuit(config, 0)) == WAIT_TIMEOUT)
+        {
+            Log(info, "Trigger: Timer:%ld(s) on process ID: %d", config->PollingInterval/1000, config->ProcessId);
+            if(config->bRestrackGenerateDump == true)
+            {
+                // Only generate core dump if user did not specify the "nodump" restrack option
+                dumpFileName = WriteCoreDump(writer);
+                if(dumpFileName == NULL)
+                {
+                    SetQuit(config, 1);
+                }
+            }
+
+            //
+            // Check to see if restrack is specified, if so, save current resource usage to file.
+            //
+#ifdef __linux__            
+            if(config->bRestrackEnabled == true)
+            {
+                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                if (id == 0)
+                {
+                    SetQuit(config, 1);
+                }
+                else
+                {
+                    leakReportThreads.push_back(id);
+                }
+            }
+#endif            
+
+            if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT) {
+                break;
+            }
+        }
+    }
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+    Trace("TimerThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+//--------------------------------------------------------------------
+//
+// DotNetMonitoringThread - Thread that creates dumps based on
+// dotnet triggers.
+//
+// NOTE: .NET only.
+// NOTE: At the moment, .NET triggers are mutually exclusive meaning
+// only one can be specified at a time. For example, you cannot specify
+// both exception based monitoring and GC based monitoring.
+//
+//--------------------------------------------------------------------
+void *DotNetMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("DotNetMonitoringThread: Enter [id=%d]", gettid());
+#ifdef __linux__    
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+    auto_free char* fullDumpPath = NULL;
+    auto_cancel_thread pthread_t waitForProfilerCompletion = -1;
+    auto_free char* clientData = NULL;
+
+    int rc = 0;
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        if(config->CoreDumpName == NULL)
+        {
+            // We don't have a dump name so we just use the path (append a '/' to indicate its a base path)
+            if(config->CoreDumpPath[strlen(config->CoreDumpPath)-1] != '/')
+            {
+                fullDumpPath = (char*) malloc(strlen(config->CoreDumpPath) + 2);    // +1 = '\0', +1 = '/'
+                if(fullDumpPath == NULL)
+                {
+                    Trace("DotNetMonitoringThread: Failed to allocate memory.");
+                    return NULL;
+                }
+
+                snprintf(fullDumpPath, strlen(config->CoreDumpPath) + 2, "%s/", config->CoreDumpPath);
+            }
+            else
+            {
+                fullDumpPath = (char*) malloc(strlen(config->CoreDumpPath) + 1);
+                if(fullDumpPath == NULL)
+                {
+                    Trace("DotNetMonitoringThread: Failed to allocate memory.");
+                    return NULL;
+                }
+
+                snprintf(fullDumpPath, strlen(config->CoreDumpPath) + 1, "%s", config->CoreDumpPath);
+            }
+        }
+        else
+        {
+            // We have a dump name, let's append to dump path
+            if(config->CoreDumpPath[strlen(config->CoreDumpPath)] != '/')
+            {
+                fullDumpPath = (char*) malloc(strlen(config->CoreDumpPath) + strlen(config->CoreDumpName) + 2);    // +1 = '\0', +1 = '/'
+                if(fullDumpPath == NULL)
+                {
+                    Trace("DotNetMonitoringThread: Failed to allocate memory.");
+                    return NULL;
+                }
+
+                snprintf(fullDumpPath, strlen(config->CoreDumpPath) + strlen(config->CoreDumpName) + 2, "%s/%s", config->CoreDumpPath, config->CoreDumpName);
             }
             else
             {
@@ -1581,6 +2895,129 @@ void *DotNetMonitoringThread(void *thread_args /* struct ProcDumpConfiguration*
     return NULL;
 }
 
+//--------------------------------------------------------------------
+//
+// RestrackMemoryMonitoringThread - Thread monitoring the outstanding
+// allocations tracked by restrack (-rm). The totals are maintained as
+// the restrack events are handled so each check is O(1).
+//
+//--------------------------------------------------------------------
+void *RestrackMemoryMonitoringThread(void *thread_args /* struct ProcDumpConfiguration* */)
+{
+    Trace("RestrackMemoryMonitoringThread: Enter [id=%d]", gettid());
+#ifdef __linux__
+    struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
+
+    int rc = 0;
+    auto_free struct CoreDumpWriter *writer = NULL;
+    auto_free char* dumpFileName = NULL;
+    std::vector<pthread_t> leakReportThreads;
+    uint64_t threshold = 0;
+    uint64_t weight = 1;
+    unsigned int samplingShift = 0;
+    unsigned int previousSamplingShift = 0;
+    uint64_t outstandingBytes = 0;
+    uint64_t stacksOverThreshold = 0;
+    uint64_t baselineBytes = 0;
+    uint64_t baselineTime = 0;
+    struct timespec now = {};
+
+    writer = NewCoreDumpWriter(RESTRACK, config);
+
+    if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
+    {
+        while ((rc = WaitForQuit(config, config->PollingInterval)) == WAIT_TIMEOUT)
+        {
+            //
+            // The threshold is scaled down once the maximum number of tracked resources (-rc)
+            // is reached and the resources are sampled.
+            //
+            pthread_mutex_lock(&config->memAllocMapMutex);
+            outstandingBytes = config->restrackOutstandingBytes;
+            stacksOverThreshold = config->restrackStacksOverThreshold;
+            threshold = GetRestrackThresholdBytes(config);
+            samplingShift = config->restrackSamplingShift;
+            weight = (1ULL << samplingShift) * (config->SampleRate > 1 ? config->SampleRate : 1);
+            pthread_mutex_unlock(&config->memAllocMapMutex);
+
+            bool bTrigger = false;
+            switch(config->RestrackThresholdType)
+            {
+                case RestrackThresholdTotal:
+                    bTrigger = outstandingBytes >= threshold;
+                    break;
+
+                case RestrackThresholdStack:
+                    bTrigger = stacksOverThreshold > 0;
+                    break;
+
+                case RestrackThresholdGrowth:
+                    //
+                    // The growth is measured from a baseline that moves every minute, so growing
+                    // by the threshold within the current minute triggers right away.
+                    //
+                    clock_gettime(CLOCK_MONOTONIC, &now);
+                    if(samplingShift != previousSamplingShift)
+                    {
+                        baselineBytes >>= samplingShift - previousSamplingShift;
+                        previousSamplingShift = samplingShift;
+                    }
+
+                    if(baselineTime == 0 || (uint64_t) now.tv_sec - baselineTime >= 60)
+                    {
+                        baselineTime = now.tv_sec;
+                        baselineBytes = outstandingBytes;
+                    }
+
+                    bTrigger = outstandingBytes > baselineBytes && outstandingBytes - baselineBytes >= threshold;
+                    break;
+            }
+
+            if (bTrigger == true)
+            {
+                Log(info, "Trigger: Restrack outstanding allocations:%ldMB%s on process ID: %d", (long) ((outstandingBytes * weight) >> 20), config->RestrackThresholdType == RestrackThresholdStack ? " (call stack above threshold)" : "", config->ProcessId);
+
+                if(config->bRestrackGenerateDump == true)
+                {
+                    // Only generate core dump if user did not specify the "nodump" restrack option
+                    dumpFileName = WriteCoreDump(writer);
+                    if(dumpFileName == NULL)
+                    {
+                        SetQuit(config, 1);
+                    }
+                }
+
+                pthread_t id = WriteRestrackSnapshot(config, writer->Type);
+                if (id == 0)
+                {
+                    SetQuit(config, 1);
+                }
+                else
+                {
+                    leakReportThreads.push_back(id);
+                }
+
+                // The growth that triggered is not counted again
+                baselineTime = 0;
+
+                if ((rc = WaitForQuit(config, config->ThresholdSeconds * 1000)) != WAIT_TIMEOUT)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    //
+    // Wait for the leak reporting threads to finish
+    //
+    WaitThreads(leakReportThreads);
+
+#endif
+    Trace("RestrackMemoryMonitoringThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
 //--------------------------------------------------------------------
 //
 // RestrackThread - Thread that handles resource tracking
@@ -1591,52 +3028,27 @@ void *RestrackThread(void *thread_args /* struct ProcDumpConfiguration* */)
     Trace("RestrackThread: Enter [id=%d]", gettid());
 #ifdef __linux__    
     struct ProcDumpConfiguration *config = (struct ProcDumpConfiguration *)thread_args;
-    auto_free char* fullDumpPath = NULL;
-    struct procdump_ebpf* skel = NULL;
     int rc = 0;
 
-    if ((skel = RunRestrack(config)) == NULL)
-    {
-        Trace("RestrackThread: Failed to run restrack eBPF program.");
-        return NULL;
-    }
-
-	//
-    // Set up ring buffer polling
     //
-	struct ring_buffer *ringBuffer = ring_buffer__new(bpf_map__fd(skel->maps.ringBuffer), RestrackHandleEvent, NULL, NULL);
-	if (!ringBuffer)
+    // All monitored processes share a single restrack eBPF program. Register
+    // this process with it and let the engine dispatch the events.
+    //
+    if (RestrackAddTarget(config) == false)
     {
-        Trace("RestrackThread: Failed to create ring buffer.");
-		return NULL;
+        Trace("RestrackThread: Failed to add process %d to restrack.", config->ProcessId);
+        return NULL;
     }
 
     if ((rc = WaitForQuitOrEvent(config, &config->evtStartMonitoring, INFINITE_WAIT)) == WAIT_OBJECT_0 + 1)
     {
-        while ((rc = WaitForQuit(config, 0)) == WAIT_TIMEOUT)
+        while ((rc = WaitForQuit(config, 1000)) == WAIT_TIMEOUT)
         {
-            //
-            // Loop and poll eBPF buffer for memory allocation events
-            //
-            int err = ring_buffer__poll(ringBuffer, 100);
-            if (err == -EINTR)
-            {
-                err = 0;
-                break;
-            }
-            if (err < 0)
-            {
-                printf("RestrackThread: Error polling ring buffer: %d\n", err);
-                break;
-            }
-
-            if ((rc = WaitForQuit(config, 1000)) != WAIT_TIMEOUT)
-            {
-                break;
-            }
         }
     }
 
+    RestrackRemoveTarget(config);
+
 #endif
     Trace("RestrackThread: Exit [id=%d]", gettid());
     return NULL;
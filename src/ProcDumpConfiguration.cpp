@@ -43,6 +43,13 @@ void ApplyDefaults(struct ProcDumpConfiguration *self)
     {
         self->SampleRate = DEFAULT_SAMPLE_RATE;
     }
+
+#ifdef __linux__
+    if((self->Uprobe != NULL || self->Usdt != NULL || self->SyscallErrorCount > 0) && self->ProbeLatency == -1 && self->ProbeHits == -1)
+    {
+        self->ProbeHits = 1;
+    }
+#endif
 }
 
 //--------------------------------------------------------------------
@@ -170,6 +177,7 @@ void InitProcDumpConfiguration(struct ProcDumpConfiguration *self)
     self->FileDescriptorThreshold =     -1;
     self->SignalNumber =                NULL;
     self->SignalCount =                 0;
+    self->bDumpOnCrash =                false;
     self->ThresholdSeconds =            -1;
     self->bMemoryTriggerBelowValue =    false;
     self->bTimerThreshold =             false;
@@ -186,8 +194,32 @@ void InitProcDumpConfiguration(struct ProcDumpConfiguration *self)
     self->ExcludeFilter =               NULL;
     self->bRestrackEnabled =            false;
     self->bRestrackGenerateDump =       true;
+    self->bRestrackDiff =               false;
+    self->bRestrackChurn =              false;
     self->bLeakReportInProgress =       false;
     self->SampleRate =                  0;
+    self->RestrackMinAge =              0;
+#ifdef __linux__
+    self->RestrackFormat =              RestrackFormatText;
+    self->RestrackReportFile =          NULL;
+    self->RestrackThreshold =           -1;
+    self->RestrackThresholdType =       RestrackThresholdTotal;
+    self->RestrackMaxResources =        0;
+    self->CpuWindow =                   -1;
+    self->MemoryHysteresis =            -1;
+    self->Uprobe =                      NULL;
+    self->Usdt =                        NULL;
+    self->ProbeArgument =               -1;
+    self->ProbeArgumentValue =          0;
+    self->ProbeHits =                   -1;
+    self->bProbeHitRate =               false;
+    self->ProbeLatency =                -1;
+    self->SyscallErrors =               NULL;
+    self->SyscallErrorCount =           0;
+    self->Syscalls =                    NULL;
+    self->SyscallCount =                0;
+    self->bDumpOnNativeException =      false;
+#endif
     self->CoreDumpMask =                -1;
 
     self->socketPath =                  NULL;
@@ -203,6 +235,15 @@ void InitProcDumpConfiguration(struct ProcDumpConfiguration *self)
     {
         self->memAllocMap.clear();
     }
+    self->restrackPreviousGroups.clear();
+    self->restrackPreviousSnapshotTime = 0;
+    self->restrackChurnWindowStart = 0;
+    self->restrackOutstandingBytes = 0;
+    self->restrackStackBytes.clear();
+    self->restrackStacksOverThreshold = 0;
+    self->restrackSamplingShift = 0;
+    self->restrackDroppedCount = 0;
+    self->restrackEvictedCount = 0;
 #endif    
 }
 
@@ -264,6 +305,38 @@ void FreeProcDumpConfiguration(struct ProcDumpConfiguration *self)
         self->ExcludeFilter = NULL;
     }
 
+#ifdef __linux__
+    if(self->RestrackReportFile)
+    {
+        free(self->RestrackReportFile);
+        self->RestrackReportFile = NULL;
+    }
+
+    if(self->Uprobe)
+    {
+        free(self->Uprobe);
+        self->Uprobe = NULL;
+    }
+
+    if(self->Usdt)
+    {
+        free(self->Usdt);
+        self->Usdt = NULL;
+    }
+
+    if(self->SyscallErrors)
+    {
+        free(self->SyscallErrors);
+        self->SyscallErrors = NULL;
+    }
+
+    if(self->Syscalls)
+    {
+        free(self->Syscalls);
+        self->Syscalls = NULL;
+    }
+#endif
+
     if(self->CoreDumpPath)
     {
         free(self->CoreDumpPath);
@@ -297,6 +370,8 @@ void FreeProcDumpConfiguration(struct ProcDumpConfiguration *self)
         }
     }
     self->memAllocMap.clear();
+    self->restrackPreviousGroups.clear();
+    self->restrackStackBytes.clear();
 #endif
 
     Trace("FreeProcDumpConfiguration: Exit");
@@ -360,8 +435,45 @@ struct ProcDumpConfiguration * CopyProcDumpConfiguration(struct ProcDumpConfigur
 
         copy->bRestrackEnabled = self->bRestrackEnabled;
         copy->bRestrackGenerateDump = self->bRestrackGenerateDump;
+        copy->bRestrackDiff = self->bRestrackDiff;
+        copy->bRestrackChurn = self->bRestrackChurn;
         copy->bLeakReportInProgress = self->bLeakReportInProgress;
         copy->SampleRate = self->SampleRate;
+        copy->RestrackMinAge = self->RestrackMinAge;
+#ifdef __linux__
+        copy->RestrackFormat = self->RestrackFormat;
+        copy->RestrackThreshold = self->RestrackThreshold;
+        copy->RestrackThresholdType = self->RestrackThresholdType;
+        copy->RestrackMaxResources = self->RestrackMaxResources;
+        copy->CpuWindow = self->CpuWindow;
+        copy->MemoryHysteresis = self->MemoryHysteresis;
+        copy->Uprobe = self->Uprobe == NULL ? NULL : strdup(self->Uprobe);
+        copy->Usdt = self->Usdt == NULL ? NULL : strdup(self->Usdt);
+        copy->ProbeArgument = self->ProbeArgument;
+        copy->ProbeArgumentValue = self->ProbeArgumentValue;
+        copy->ProbeHits = self->ProbeHits;
+        copy->bProbeHitRate = self->bProbeHitRate;
+        copy->ProbeLatency = self->ProbeLatency;
+        if(self->SyscallErrors != NULL)
+        {
+            copy->SyscallErrors = (int*) malloc(self->SyscallErrorCount*sizeof(int));
+            if(copy->SyscallErrors != NULL)
+            {
+                copy->SyscallErrorCount = self->SyscallErrorCount;
+                memcpy(copy->SyscallErrors, self->SyscallErrors, self->SyscallErrorCount*sizeof(int));
+            }
+        }
+        if(self->Syscalls != NULL)
+        {
+            copy->Syscalls = (int*) malloc(self->SyscallCount*sizeof(int));
+            if(copy->Syscalls != NULL)
+            {
+                copy->SyscallCount = self->SyscallCount;
+                memcpy(copy->Syscalls, self->Syscalls, self->SyscallCount*sizeof(int));
+            }
+        }
+        copy->bDumpOnNativeException = self->bDumpOnNativeException;
+#endif
         copy->CoreDumpMask = self->CoreDumpMask;
         copy->bMemoryTriggerBelowValue = self->bMemoryTriggerBelowValue;
         copy->MemoryThresholdCount = self->MemoryThresholdCount;
@@ -398,6 +510,8 @@ struct ProcDumpConfiguration * CopyProcDumpConfiguration(struct ProcDumpConfigur
             memcpy(copy->SignalNumber, self->SignalNumber, self->SignalCount*sizeof(int));
         }
 
+        copy->bDumpOnCrash = self->bDumpOnCrash;
+
         copy->PollingInterval = self->PollingInterval;
         copy->CoreDumpPath = self->CoreDumpPath == NULL ? NULL : strdup(self->CoreDumpPath);
         copy->CoreDumpName = self->CoreDumpName == NULL ? NULL : strdup(self->CoreDumpName);
@@ -408,6 +522,12 @@ struct ProcDumpConfiguration * CopyProcDumpConfiguration(struct ProcDumpConfigur
         copy->statusSocket = self->statusSocket;
 #ifdef __linux__        
         copy->memAllocMap = self->memAllocMap;
+        copy->restrackOutstandingBytes = self->restrackOutstandingBytes;
+        copy->restrackStackBytes = self->restrackStackBytes;
+        copy->restrackStacksOverThreshold = self->restrackStacksOverThreshold;
+        copy->restrackSamplingShift = self->restrackSamplingShift;
+        copy->restrackDroppedCount = self->restrackDroppedCount;
+        copy->restrackEvictedCount = self->restrackEvictedCount;
 #endif
         return copy;
     }
@@ -461,6 +581,158 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
 
             i++;
         }
+#ifdef __linux__
+        else if( 0 == strcasecmp( argv[i], "/cw" ) ||
+                    0 == strcasecmp( argv[i], "-cw" ))
+        {
+            if( i+1 >= argc || self->CpuWindow != -1 ) return PrintUsage();
+            if(!ConvertToInt(argv[i+1], &self->CpuWindow)) return PrintUsage();
+            if(self->CpuWindow < MIN_CPU_WINDOW || self->CpuWindow > MAX_CPU_WINDOW)
+            {
+                Log(error, "Invalid CPU window specified (%d-%d ms).", MIN_CPU_WINDOW, MAX_CPU_WINDOW);
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/uprobe" ) ||
+                    0 == strcasecmp( argv[i], "-uprobe" ))
+        {
+            if( i+1 >= argc || self->Uprobe != NULL ) return PrintUsage();
+
+            self->Uprobe = strdup(argv[i+1]);
+            if(self->Uprobe == NULL)
+            {
+                Log(error, INTERNAL_ERROR);
+                Trace("GetOptions: failed to strdup Uprobe");
+                return -1;
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/usdt" ) ||
+                    0 == strcasecmp( argv[i], "-usdt" ))
+        {
+            if( i+1 >= argc || self->Usdt != NULL ) return PrintUsage();
+
+            self->Usdt = strdup(argv[i+1]);
+            if(self->Usdt == NULL)
+            {
+                Log(error, INTERNAL_ERROR);
+                Trace("GetOptions: failed to strdup Usdt");
+                return -1;
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/pa" ) ||
+                    0 == strcasecmp( argv[i], "-pa" ))
+        {
+            if( i+1 >= argc || self->ProbeArgument != -1 ) return PrintUsage();
+
+            char* value = NULL;
+            char* end = NULL;
+            self->ProbeArgument = strtol(argv[i+1], &value, 10);
+            if(value == argv[i+1] || *value != '=') return PrintUsage();
+
+            errno = 0;
+            value++;
+            self->ProbeArgumentValue = strtoll(value, &end, 0);
+            if(*value == '\0' || *end != '\0' || errno != 0) return PrintUsage();
+            if(self->ProbeArgument < 1 || self->ProbeArgument > MAX_USDT_ARGUMENTS)
+            {
+                Log(error, "Invalid USDT argument specified (1-%d).", MAX_USDT_ARGUMENTS);
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/pl" ) ||
+                    0 == strcasecmp( argv[i], "-pl" ))
+        {
+            if( i+1 >= argc || self->ProbeLatency != -1 ) return PrintUsage();
+            if(!ConvertToInt(argv[i+1], &self->ProbeLatency)) return PrintUsage();
+            if(self->ProbeLatency <= 0)
+            {
+                Log(error, "Invalid probe latency specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/se" ) ||
+                    0 == strcasecmp( argv[i], "-se" ))
+        {
+            if( i+1 >= argc || self->SyscallErrorCount != 0 ) return PrintUsage();
+            self->SyscallErrors = GetSeparatedValues(argv[i+1], const_cast<char*>(","), &self->SyscallErrorCount, ConvertToErrno);
+
+            if(self->SyscallErrors == NULL || self->SyscallErrorCount == 0) return PrintUsage();
+
+            for(int i = 0; i < self->SyscallErrorCount; i++)
+            {
+                if(self->SyscallErrors[i] <= 0 || self->SyscallErrors[i] >= TRIGGER_ERRNOS)
+                {
+                    Log(error, "Invalid errno specified.");
+                    return PrintUsage();
+                }
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/ss" ) ||
+                    0 == strcasecmp( argv[i], "-ss" ))
+        {
+            if( i+1 >= argc || self->SyscallCount != 0 ) return PrintUsage();
+            self->Syscalls = GetSeparatedValues(argv[i+1], const_cast<char*>(","), &self->SyscallCount, ConvertToSyscall);
+
+            if(self->Syscalls == NULL || self->SyscallCount == 0) return PrintUsage();
+
+            for(int i = 0; i < self->SyscallCount; i++)
+            {
+                if(self->Syscalls[i] < 0 || self->Syscalls[i] >= TRIGGER_SYSCALLS)
+                {
+                    Log(error, "Invalid syscall specified.");
+                    return PrintUsage();
+                }
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/ph" ) ||
+                    0 == strcasecmp( argv[i], "-ph" ))
+        {
+            if( i+1 >= argc || self->ProbeHits != -1 ) return PrintUsage();
+
+            char* hits = argv[i+1];
+            if(strncasecmp(hits, "rate:", 5) == 0)
+            {
+                self->bProbeHitRate = true;
+                hits += 5;
+            }
+
+            if(!ConvertToInt(hits, &self->ProbeHits)) return PrintUsage();
+            if(self->ProbeHits <= 0)
+            {
+                Log(error, "Invalid probe hit count specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/mh" ) ||
+                    0 == strcasecmp( argv[i], "-mh" ))
+        {
+            if( i+1 >= argc || self->MemoryHysteresis != -1 ) return PrintUsage();
+            if(!ConvertToInt(argv[i+1], &self->MemoryHysteresis)) return PrintUsage();
+            if(self->MemoryHysteresis < 0)
+            {
+                Log(error, "Invalid memory hysteresis specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+#endif
         else if( 0 == strcasecmp( argv[i], "/m" ) ||
                     0 == strcasecmp( argv[i], "-m" ) ||
                     0 == strcasecmp( argv[i], "/ml" ) ||
@@ -597,10 +869,27 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
                 return PrintUsage();
             }
 
-            if(strcasecmp(argv[i+1], "nodump") == 0 )
+            while(i+1 < argc)
             {
-                self->bRestrackGenerateDump = false;
-                i++;
+                if(strcasecmp(argv[i+1], "nodump") == 0 )
+                {
+                    self->bRestrackGenerateDump = false;
+                    i++;
+                }
+                else if(strcasecmp(argv[i+1], "diff") == 0 )
+                {
+                    self->bRestrackDiff = true;
+                    i++;
+                }
+                else if(strcasecmp(argv[i+1], "churn") == 0 )
+                {
+                    self->bRestrackChurn = true;
+                    i++;
+                }
+                else
+                {
+                    break;
+                }
             }
 
             self->bRestrackEnabled = true;
@@ -618,6 +907,102 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
 
             i++;
         }
+        else if( 0 == strcasecmp( argv[i], "/ra" ) ||
+                    0 == strcasecmp( argv[i], "-ra" ))
+        {
+            if( i+1 >= argc  ) return PrintUsage();
+            if(!ConvertToInt(argv[i+1], &self->RestrackMinAge)) return PrintUsage();
+            if(self->RestrackMinAge < 0)
+            {
+                Log(error, "Invalid minimum resource age specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/rc" ) ||
+                    0 == strcasecmp( argv[i], "-rc" ))
+        {
+            if( i+1 >= argc  ) return PrintUsage();
+            if(!ConvertToInt(argv[i+1], &self->RestrackMaxResources)) return PrintUsage();
+            if(self->RestrackMaxResources <= 0)
+            {
+                Log(error, "Invalid maximum number of tracked resources specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/rf" ) ||
+                    0 == strcasecmp( argv[i], "-rf" ))
+        {
+            if( i+1 >= argc  ) return PrintUsage();
+            if(strcasecmp(argv[i+1], "text") == 0)
+            {
+                self->RestrackFormat = RestrackFormatText;
+            }
+            else if(strcasecmp(argv[i+1], "pprof") == 0)
+            {
+                self->RestrackFormat = RestrackFormatPprof;
+            }
+            else if(strcasecmp(argv[i+1], "folded") == 0)
+            {
+                self->RestrackFormat = RestrackFormatFolded;
+            }
+            else if(strcasecmp(argv[i+1], "raw") == 0)
+            {
+                self->RestrackFormat = RestrackFormatRaw;
+            }
+            else
+            {
+                Log(error, "Invalid restrack report format specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/rm" ) ||
+                    0 == strcasecmp( argv[i], "-rm" ))
+        {
+            if( i+1 >= argc || self->RestrackThreshold != -1 ) return PrintUsage();
+
+            char* threshold = argv[i+1];
+            if(strncasecmp(threshold, "stack:", 6) == 0)
+            {
+                self->RestrackThresholdType = RestrackThresholdStack;
+                threshold += 6;
+            }
+            else if(strncasecmp(threshold, "growth:", 7) == 0)
+            {
+                self->RestrackThresholdType = RestrackThresholdGrowth;
+                threshold += 7;
+            }
+
+            if(!ConvertToInt(threshold, &self->RestrackThreshold)) return PrintUsage();
+            if(self->RestrackThreshold <= 0)
+            {
+                Log(error, "Invalid restrack memory threshold specified.");
+                return PrintUsage();
+            }
+
+            i++;
+        }
+        else if( 0 == strcasecmp( argv[i], "/restrack-report" ) ||
+                    0 == strcasecmp( argv[i], "-restrack-report" ) ||
+                    0 == strcasecmp( argv[i], "--restrack-report" ))
+        {
+            if( i+1 >= argc || self->RestrackReportFile != NULL ) return PrintUsage();
+
+            self->RestrackReportFile = strdup(argv[i+1]);
+            if(self->RestrackReportFile == NULL)
+            {
+                Log(error, INTERNAL_ERROR);
+                Trace("GetOptions: failed to strdup RestrackReportFile");
+                return -1;
+            }
+
+            i++;
+        }
         else if( 0 == strcasecmp( argv[i], "/sig" ) ||
                     0 == strcasecmp( argv[i], "-sig" ))
         {
@@ -638,6 +1023,12 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
 
             i++;
         }
+        else if( 0 == strcasecmp( argv[i], "/crash" ) ||
+                    0 == strcasecmp( argv[i], "-crash" ))
+        {
+            if( self->bDumpOnCrash ) return PrintUsage();
+            self->bDumpOnCrash = true;
+        }
         else if( 0 == strcasecmp( argv[i], "/mc" ) ||
                     0 == strcasecmp( argv[i], "-mc" ))
         {
@@ -753,6 +1144,12 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
             dotnetTriggerCount++;
             self->bDumpOnException = true;
         }
+        else if( 0 == strcasecmp( argv[i], "/ne" ) ||
+                    0 == strcasecmp( argv[i], "-ne" ))
+        {
+            if( i+1 >= argc) return PrintUsage();
+            self->bDumpOnNativeException = true;
+        }
         else if( 0 == strcasecmp( argv[i], "/f" ) ||
                    0 == strcasecmp( argv[i], "-f" ))
         {
@@ -958,13 +1355,31 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
     }
 
 #ifdef __linux__
-    // If exception filter is provided with no -e switch exit
-    if((self->ExceptionFilter && self->bDumpOnException == false))
+    // If exception filter is provided with no -e or -ne switch exit
+    if((self->ExceptionFilter && self->bDumpOnException == false && self->bDumpOnNativeException == false))
     {
-        Log(error, "Please use the -e switch when specifying an exception filter (-f)");
+        Log(error, "Please use the -e or -ne switch when specifying an exception filter (-f)");
         return PrintUsage();
     }
 
+    // Offline restrack reports only take the report options and no target
+    if(self->RestrackReportFile != NULL)
+    {
+        if(bProcessSpecified || self->bRestrackEnabled || self->SampleRate > 0)
+        {
+            Log(error, "The -restrack-report switch generates a report from a capture and cannot be combined with a target or -restrack.");
+            return PrintUsage();
+        }
+
+        if(self->RestrackFormat == RestrackFormatRaw)
+        {
+            Log(error, "Please specify a text, pprof or folded report format (-rf) with -restrack-report.");
+            return PrintUsage();
+        }
+
+        return 0;
+    }
+
     // If sample rate is specified it also requires restrack
     if((self->SampleRate > 0 && self->bRestrackEnabled == false))
     {
@@ -972,6 +1387,50 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
         return PrintUsage();
     }
 
+    // If a report format is specified it also requires restrack
+    if((self->RestrackFormat != RestrackFormatText && self->bRestrackEnabled == false))
+    {
+        Log(error, "Please use the -restrack switch when specifying a report format (-rf)");
+        return PrintUsage();
+    }
+
+    // If minimum resource age is specified it also requires restrack
+    if((self->RestrackMinAge > 0 && self->bRestrackEnabled == false))
+    {
+        Log(error, "Please use the -restrack switch when specifying a minimum resource age (-ra)");
+        return PrintUsage();
+    }
+
+    // If the maximum number of tracked resources is specified it also requires restrack
+    if((self->RestrackMaxResources > 0 && self->bRestrackEnabled == false))
+    {
+        Log(error, "Please use the -restrack switch when specifying the maximum number of tracked resources (-rc)");
+        return PrintUsage();
+    }
+
+    // Churn mode counts allocations rather than tracking the outstanding resources
+    if(self->bRestrackChurn == true)
+    {
+        if(self->bRestrackDiff == true || self->RestrackMinAge > 0 || self->RestrackThreshold != -1)
+        {
+            Log(error, "The restrack churn option cannot be combined with diff, -ra or -rm.");
+            return PrintUsage();
+        }
+
+        if(self->RestrackFormat == RestrackFormatRaw)
+        {
+            Log(error, "Please specify a text, pprof or folded report format (-rf) with the restrack churn option.");
+            return PrintUsage();
+        }
+    }
+
+    // The restrack memory trigger uses the allocations tracked by restrack
+    if((self->RestrackThreshold != -1 && self->bRestrackEnabled == false))
+    {
+        Log(error, "Please use the -restrack switch when specifying a restrack memory threshold (-rm)");
+        return PrintUsage();
+    }
+
 
     // Make sure exclude filter is provided with switches that supports exclusion.
     if((self->ExcludeFilter && self->bRestrackEnabled == false))
@@ -1005,23 +1464,85 @@ int GetOptions(struct ProcDumpConfiguration *self, int argc, char *argv[])
         (self->ThreadThreshold == -1) &&
         (self->FileDescriptorThreshold == -1) &&
         (self->DumpGCGeneration == -1) &&
-        (self->SignalCount == 0))
+#ifdef __linux__
+        (self->RestrackThreshold == -1) &&
+        (self->Uprobe == NULL) &&
+        (self->Usdt == NULL) &&
+        (self->SyscallErrorCount == 0) &&
+        (self->bDumpOnNativeException == false) &&
+#endif
+        (self->SignalCount == 0) &&
+        (self->bDumpOnCrash == false))
     {
         self->bTimerThreshold = true;
     }
 
 #ifdef __linux__
+    // The CPU window measures the usage in-kernel, which only applies to the -c trigger
+    if(self->CpuWindow != -1 && (self->CpuThreshold == -1 || self->bCpuTriggerBelowValue == true))
+    {
+        Log(error, "Please use the -c switch when specifying a CPU window (-cw)");
+        return PrintUsage();
+    }
+
+    // The memory hysteresis measures the commit usage in-kernel, which doesn't apply to the .NET memory trigger
+    if(self->MemoryHysteresis != -1 && (self->MemoryThreshold == NULL || self->bMonitoringGCMemory == true))
+    {
+        Log(error, "Please use the -m or -ml switch when specifying a memory hysteresis (-mh)");
+        return PrintUsage();
+    }
+
+    // The hit count applies to the probe triggers
+    if(self->ProbeHits != -1 && self->Uprobe == NULL && self->Usdt == NULL && self->SyscallErrorCount == 0)
+    {
+        Log(error, "Please use the -uprobe, -usdt or -se switch when specifying a hit count (-ph)");
+        return PrintUsage();
+    }
+
+    // The probe and syscall error triggers share the monitor (and hit count)
+    if((self->Uprobe != NULL) + (self->Usdt != NULL) + (self->SyscallErrorCount > 0) > 1)
+    {
+        Log(error, "Only one of the -uprobe, -usdt and -se switches can be specified.");
+        return PrintUsage();
+    }
+
+    // The syscall filter applies to the syscall errors
+    if(self->SyscallCount > 0 && self->SyscallErrorCount == 0)
+    {
+        Log(error, "Please use the -se switch when specifying syscalls (-ss)");
+        return PrintUsage();
+    }
+
+    // The latency is the duration of the calls of the -uprobe function, each slow call triggers
+    if(self->ProbeLatency != -1 && (self->Uprobe == NULL || self->ProbeHits != -1))
+    {
+        Log(error, "Please use the -uprobe switch without -ph when specifying a probe latency (-pl)");
+        return PrintUsage();
+    }
+
+    // Only USDT probes have arguments
+    if(self->ProbeArgument != -1 && self->Usdt == NULL)
+    {
+        Log(error, "Please use the -usdt switch when specifying a probe argument filter (-pa)");
+        return PrintUsage();
+    }
+
     // Signal trigger can only be specified alone
-    if(self->SignalCount > 0 || self->bDumpOnException)
+    if(self->SignalCount > 0 || self->bDumpOnException || self->bDumpOnNativeException || self->bDumpOnCrash)
     {
-        if(self->CpuThreshold != -1 || self->ThreadThreshold != -1 || self->FileDescriptorThreshold != -1 || self->MemoryThreshold != NULL)
+        if((self->SignalCount > 0) + self->bDumpOnException + self->bDumpOnNativeException + self->bDumpOnCrash > 1)
+        {
+            Log(error, "Only one of the Signal/Exception/Crash triggers can be specified.");
+            return PrintUsage();
+        }
+        if(self->CpuThreshold != -1 || self->ThreadThreshold != -1 || self->FileDescriptorThreshold != -1 || self->MemoryThreshold != NULL || self->RestrackThreshold != -1 || self->Uprobe != NULL || self->Usdt != NULL || self->SyscallErrorCount > 0)
         {
-            Log(error, "Signal/Exception trigger must be the only trigger specified.");
+            Log(error, "Signal/Exception/Crash trigger must be the only trigger specified.");
             return PrintUsage();
         }
         if(self->PollingInterval != -1)
         {
-            Log(error, "Polling interval has no meaning during Signal/Exception monitoring.");
+            Log(error, "Polling interval has no meaning during Signal/Exception/Crash monitoring.");
             return PrintUsage();
         }
 
@@ -1057,6 +1578,10 @@ bool PrintConfiguration(struct ProcDumpConfiguration *self)
         {
             printf("** NOTE ** Signal triggers use PTRACE which will impact the performance of the target process\n\n");
         }
+        else if(self->bDumpOnCrash)
+        {
+            printf("** NOTE ** The crash trigger uses PTRACE which stops the receiving thread of the target process for every signal\n\n");
+        }
 
         if (self->bProcessGroup)
         {
@@ -1080,7 +1605,16 @@ bool PrintConfiguration(struct ProcDumpConfiguration *self)
             }
             else
             {
-                printf("%-40s>= %d%%\n", "CPU Threshold:", self->CpuThreshold);
+#ifdef __linux__
+                if (self->CpuWindow != -1)
+                {
+                    printf("%-40s>= %d%% (%d ms window)\n", "CPU Threshold:", self->CpuThreshold, self->CpuWindow);
+                }
+                else
+#endif
+                {
+                    printf("%-40s>= %d%%\n", "CPU Threshold:", self->CpuThreshold);
+                }
             }
         }
         else
@@ -1116,6 +1650,13 @@ bool PrintConfiguration(struct ProcDumpConfiguration *self)
                 }
             }
 
+#ifdef __linux__
+            if (self->MemoryHysteresis != -1)
+            {
+                printf(" (%d MB hysteresis)", self->MemoryHysteresis);
+            }
+#endif
+
             printf("\n");
         }
         else
@@ -1173,13 +1714,27 @@ bool PrintConfiguration(struct ProcDumpConfiguration *self)
         // Restrack
         if (self->bRestrackEnabled == true)
         {
-            printf("%-40s%s\n", "Resource tracking:", "On");
+            printf("%-40s%s\n", "Resource tracking:", self->bRestrackChurn ? "On (allocation churn)" : "On");
             printf("%-40s%d\n", "Resource tracking sample rate:", self->SampleRate);
+            printf("%-40s%d\n", "Resource tracking minimum age (s):", self->RestrackMinAge);
+            printf("%-40s%d\n", "Resource tracking maximum resources:", self->RestrackMaxResources > 0 ? self->RestrackMaxResources : RESTRACK_DEFAULT_MAX_RESOURCES);
+            printf("%-40s%s\n", "Resource tracking report format:", self->RestrackFormat == RestrackFormatPprof ? "pprof" : (self->RestrackFormat == RestrackFormatFolded ? "folded" : (self->RestrackFormat == RestrackFormatRaw ? "raw" : "text")));
+            if (self->RestrackThreshold != -1)
+            {
+                printf("%-40s>= %d MB%s\n", "Resource tracking memory threshold:", self->RestrackThreshold, self->RestrackThresholdType == RestrackThresholdStack ? " (any call stack)" : (self->RestrackThresholdType == RestrackThresholdGrowth ? " (growth per minute)" : ""));
+            }
+            else
+            {
+                printf("%-40s%s\n", "Resource tracking memory threshold:", "n/a");
+            }
         }
         else
         {
             printf("%-40s%s\n", "Resource tracking:", "n/a");
             printf("%-40s%s\n", "Resource tracking sample rate:", "n/a");
+            printf("%-40s%s\n", "Resource tracking minimum age (s):", "n/a");
+            printf("%-40s%s\n", "Resource tracking report format:", "n/a");
+            printf("%-40s%s\n", "Resource tracking memory threshold:", "n/a");
         }
         // Signal
         if (self->SignalCount > 0)
@@ -1202,6 +1757,96 @@ bool PrintConfiguration(struct ProcDumpConfiguration *self)
         {
             printf("%-40s%s\n", "Signal:", "n/a");
         }
+        // Probe
+        if (self->Uprobe != NULL)
+        {
+            if (self->ProbeLatency != -1)
+            {
+                printf("%-40s%s (>= %d ms per call)\n", "Uprobe:", self->Uprobe, self->ProbeLatency);
+            }
+            else
+            {
+                printf("%-40s%s (%d %s)\n", "Uprobe:", self->Uprobe, self->ProbeHits, self->bProbeHitRate ? "calls/s" : "calls");
+            }
+        }
+        else
+        {
+            printf("%-40s%s\n", "Uprobe:", "n/a");
+        }
+        // USDT probe
+        if (self->Usdt != NULL)
+        {
+            printf("%-40s%s (%d %s", "USDT probe:", self->Usdt, self->ProbeHits, self->bProbeHitRate ? "hits/s" : "hits");
+            if (self->ProbeArgument != -1)
+            {
+                printf(" with arg%d == %lld", self->ProbeArgument, self->ProbeArgumentValue);
+            }
+            printf(")\n");
+        }
+        else
+        {
+            printf("%-40s%s\n", "USDT probe:", "n/a");
+        }
+        // Syscall errors
+        if (self->SyscallErrorCount > 0)
+        {
+            printf("%-40s", "Syscall error(s):");
+            for(int i=0; i<self->SyscallErrorCount; i++)
+            {
+                const char* name = GetErrnoName(self->SyscallErrors[i]);
+                if(name != NULL)
+                {
+                    printf("%s", name);
+                }
+                else
+                {
+                    printf("%d", self->SyscallErrors[i]);
+                }
+                if(i < self->SyscallErrorCount -1)
+                {
+                    printf(",");
+                }
+            }
+            printf(" (%d %s", self->ProbeHits, self->bProbeHitRate ? "errors/s" : "errors");
+            if (self->SyscallCount > 0)
+            {
+                printf(" in ");
+                for(int i=0; i<self->SyscallCount; i++)
+                {
+                    const char* name = GetSyscallName(self->Syscalls[i]);
+                    if(name != NULL)
+                    {
+                        printf("%s", name);
+                    }
+                    else
+                    {
+                        printf("%d", self->Syscalls[i]);
+                    }
+                    if(i < self->SyscallCount -1)
+                    {
+                        printf(",");
+                    }
+                }
+            }
+            printf(")\n");
+        }
+        else
+        {
+            printf("%-40s%s\n", "Syscall error:", "n/a");
+        }
+        // Crash
+        printf("%-40s%s\n", "Crash monitor:", self->bDumpOnCrash ? "On" : "n/a");
+        // Native exception
+        if (self->bDumpOnNativeException)
+        {
+            printf("%-40s%s\n", "Native exception monitor:", "On");
+            printf("%-40s%s\n", "Exception filter:", self->ExceptionFilter ? self->ExceptionFilter : "n/a");
+        }
+        else
+        {
+            printf("%-40s%s\n", "Native exception monitor:", "n/a");
+        }
+
         // Exception
         if (self->bDumpOnException)
         {
@@ -1270,16 +1915,35 @@ int PrintUsage()
     printf("   procdump [-n Count]\n");
     printf("            [-s Seconds]\n");
     printf("            [-c|-cl CPU_Usage]\n");
+#ifdef __linux__
+    printf("            [-cw CPU_Window]\n");
+#endif
     printf("            [-m|-ml Commit_Usage1[,Commit_Usage2...]]\n");
+#ifdef __linux__
+    printf("            [-mh Memory_Hysteresis]\n");
+#endif
     printf("            [-tc Thread_Threshold]\n");
     printf("            [-fc FileDescriptor_Threshold]\n");
 #ifdef __linux__    
     printf("            [-gcm [<GCGeneration>: | LOH: | POH:]Memory_Usage1[,Memory_Usage2...]]\n");
     printf("            [-gcgen Generation]\n");
-    printf("            [-restrack [nodump]]\n");
+    printf("            [-restrack [nodump] [diff] [churn]]\n");
     printf("            [-sr Sample_Rate]\n");
+    printf("            [-ra Minimum_Age]\n");
+    printf("            [-rc Max_Resources]\n");
+    printf("            [-rf text|pprof|folded|raw]\n");
+    printf("            [-rm [stack: | growth:]Memory_Usage]\n");
     printf("            [-sig Signal_Number1[,Signal_Number2...]]\n");
+    printf("            [-uprobe [Binary:]Symbol]\n");
+    printf("            [-usdt [Binary:]Provider:Probe]\n");
+    printf("            [-pa Argument=Value]\n");
+    printf("            [-ph [rate:]Hits]\n");
+    printf("            [-pl Latency]\n");
+    printf("            [-se Errno1[,Errno2...]]\n");
+    printf("            [-ss Syscall1[,Syscall2...]]\n");
+    printf("            [-crash]\n");
     printf("            [-e]\n");
+    printf("            [-ne]\n");
     printf("            [-f Include_Filter,...]\n");
     printf("            [-fx Exclude_Filter]\n");
     printf("            [-mc Custom_Dump_Mask]\n");
@@ -1294,24 +1958,50 @@ int PrintUsage()
     printf("             {{[-w] Process_Name | PID} [Dump_File | Dump_Folder]}\n");
 #endif
     printf("            }\n");
+#ifdef __linux__
+    printf("\n");
+    printf("Report Usage: \n");
+    printf("   procdump -restrack-report Restrack_Capture\n");
+    printf("            [-rf text|pprof|folded]\n");
+    printf("            [-ra Minimum_Age]\n");
+    printf("            [-fx Exclude_Filter]\n");
+#endif
     printf("\n");
     printf("Options:\n");
     printf("   -n      Number of dumps to write before exiting.\n");
     printf("   -s      Consecutive seconds before dump is written (default is 10).\n");
     printf("   -c      CPU threshold above which to create a dump of the process.\n");
     printf("   -cl     CPU threshold below which to create a dump of the process.\n");
+#ifdef __linux__
+    printf("   -cw     Window (ms) over which the -c CPU usage is measured in-kernel (eBPF), the dump is created as soon as the threshold is crossed.\n");
+#endif
     printf("   -tc     Thread count threshold above which to create a dump of the process.\n");
     printf("   -fc     File descriptor count threshold above which to create a dump of the process.\n");
 #ifdef __linux__
     printf("   -m      Memory commit threshold(s) (MB) above which to create dumps.\n");
     printf("   -ml     Memory commit threshold(s) (MB) below which to create dumps.\n");
+    printf("   -mh     Hysteresis (MB) of the -m or -ml commit usage measured in-kernel (eBPF), the dump is created as soon as the threshold is crossed and the usage has to move back by the hysteresis before the same threshold triggers again.\n");
     printf("   -gcm    [.NET] GC memory threshold(s) (MB) above which to create dumps for the specified generation or heap (default is total .NET memory usage).\n");
     printf("   -gcgen  [.NET] Create dump when the garbage collection of the specified generation starts and finishes.\n");
-    printf("   -restrack Enable memory leak tracking (malloc family of APIs). Use the nodump option to prevent dump generation and only produce restrack report(s).\n");
+    printf("   -restrack Enable resource leak tracking (memory, file descriptors and threads). Use the nodump option to prevent dump generation and only produce restrack report(s). Use the diff option to only report the changes since the previous restrack report. Use the churn option to report the most frequent allocation call stacks since the previous report instead of the outstanding resources.\n");
     printf("   -sr     Sample rate when using -restrack.\n");
+    printf("   -ra     Minimum age (seconds) of the resources included in -restrack reports.\n");
+    printf("   -rc     Maximum number of resources tracked by -restrack (default is %d). Once reached, resources are sampled and the report counts are scaled accordingly.\n", RESTRACK_DEFAULT_MAX_RESOURCES);
+    printf("   -rf     Format of the -restrack reports: text (default), pprof (gzip'ed protobuf, .restrack.pb.gz), folded (folded stacks for flame graphs, .restrack.folded) or raw (unsymbolized capture, .restrack.raw, see -restrack-report).\n");
+    printf("   -rm     Restrack memory threshold (MB) above which to create a dump: outstanding allocations tracked by -restrack (default), outstanding allocations of any single call stack (stack:) or growth of the outstanding allocations within a minute (growth:). Scaled by the -sr sample rate.\n");
+    printf("   -restrack-report Generates a report (-rf, -ra and -fx apply) from a raw capture (-rf raw). Symbols are resolved from the modules at the paths recorded in the capture.\n");
     printf("   -sig    Comma separated list of signal number(s) during which any signal results in a dump of the process.\n");
+    printf("   -uprobe Create dump when the process calls the specified function (eBPF uprobe, C++ functions by their mangled name). The binary is a path or a library name and defaults to the executable of the process.\n");
+    printf("   -usdt   Create dump when the process hits the specified USDT probe (eBPF). The binary is a path or a library name and defaults to the executable of the process.\n");
+    printf("   -pa     Only count the -usdt probe hits where the argument (1-based) equals the value (decimal or 0x hex).\n");
+    printf("   -ph     Number of hits of the -uprobe function, -usdt probe or -se errors at which to create a dump (default is 1). Use the rate: prefix to create a dump when the hits per second exceed the value instead.\n");
+    printf("   -pl     Duration (ms) of a call of the -uprobe function above which to create a dump. The dump is created while the call is still running and the user stack of the thread is logged if it was running.\n");
+    printf("   -se     Comma separated list of errnos (names such as EMFILE or numbers), create dump when syscalls of the process fail with one of them (eBPF). Use -ph for the number or rate of errors and -ss to only count some syscalls. The user stack of the failing thread is logged.\n");
+    printf("   -ss     Comma separated list of syscalls (common names such as connect or numbers) whose -se errors are counted (default is all).\n");
+    printf("   -crash  Create dump when the process crashes (SIGSEGV, SIGBUS or SIGABRT without a signal handler), before the signal terminates it.\n");
     printf("   -e      [.NET] Create dump when the process encounters an exception.\n");
-    printf("   -f      Filter (include) on the content of .NET exceptions (comma separated). Wildcards (*) are supported.\n");
+    printf("   -ne     Create dump when the process throws a C++ exception (eBPF uprobe on __cxa_throw). The whole process is stopped until the dump is written. Types that can't match -f are filtered in-kernel, the process is stopped briefly the first time each other type is thrown while it's matched against -f.\n");
+    printf("   -f      Filter (include) on the content of .NET exceptions or the type of -ne C++ exceptions (comma separated). Wildcards (*) are supported.\n");
     printf("   -fx     Filter (exclude) on the content of -restrack call stacks. Wildcards (*) are supported.\n");
     printf("   -mc     Custom core dump mask (in hex) indicating what memory should be included in the core dump. Please see 'man core' (/proc/[pid]/coredump_filter) for available options.\n");
     printf("   -pgid   Process ID specified refers to a process group ID.\n");
@@ -46,6 +46,14 @@ int main(int argc, char *argv[])
     // Register exit handler
     atexit(OnExit);
 
+#ifdef __linux__
+    // Generate a report from a restrack capture instead of monitoring
+    if (g_config.RestrackReportFile != NULL)
+    {
+        exit(RestrackOfflineReport(&g_config));
+    }
+#endif
+
     // monitor for all specified processes
     MonitorProcesses(&g_config);
 }
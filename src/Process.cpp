@@ -57,6 +57,46 @@ bool GetUids(pid_t pid, struct ProcessStat* proc)
     return false;
 }
 
+#ifdef __linux__
+//--------------------------------------------------------------------
+//
+// GetProcessSignalMasks - Gets the masks of the signals caught and
+//                         ignored by the given pid (bit n-1 for
+//                         signal n)
+//
+//--------------------------------------------------------------------
+bool GetProcessSignalMasks(pid_t pid, uint64_t* caught, uint64_t* ignored)
+{
+    std::ostringstream path;
+    path << "/proc/" << pid << "/status";
+
+    std::ifstream statusFile(path.str());
+    if (!statusFile.is_open())
+    {
+        Trace("GetProcessSignalMasks: Failed to open status file for pid: %d", pid);
+        return false;
+    }
+
+    int found = 0;
+    std::string line;
+    while (std::getline(statusFile, line))
+    {
+        if (line.find("SigCgt:") == 0)
+        {
+            *caught = strtoull(line.c_str() + 7, NULL, 16);
+            found++;
+        }
+        else if (line.find("SigIgn:") == 0)
+        {
+            *ignored = strtoull(line.c_str() + 7, NULL, 16);
+            found++;
+        }
+    }
+
+    return found == 2;
+}
+#endif
+
 //--------------------------------------------------------------------
 //
 // GetNumFileDescriptors - Gets the process stats for the given pid
@@ -11,6 +11,7 @@
 
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <elf.h>
 
 #include "Includes.h"
 
@@ -20,38 +21,196 @@
 #include "bcc_syms.h"
 
 #include <vector>
+#include <unordered_set>
 #include <algorithm>
 #include <string>
 #include <fstream>
 #include <memory>
-
-typedef struct {
-    unsigned int type;
-    unsigned long allocCount;
-    unsigned long allocSize;
-    unsigned long totalAllocSize;
-    unsigned int callStackLen;
-    __u64 stackTrace[MAX_CALL_STACK_FRAMES];
-} groupedAllocEntry;
-
-typedef struct {
-    std::string symbolName;
-    std::string demangledSymbolName;
-    char* fullName;
-    uint64_t offset;
-    __u64 pc;
-} stackFrame;
+#include <atomic>
 
 typedef struct {
     ProcDumpConfiguration* config;
     const char* filename;
 } leakThreadArgs;
 
+//
+// The sections of the restrack report, one per tracked resource type.
+//
+typedef struct {
+    unsigned int type;
+    const char* title;
+} restrackReportSection;
+
+static const restrackReportSection restrackReportSections[] =
+{
+    { RESTRACK_ALLOC, "Memory" },
+    { RESTRACK_FD_OPEN, "File Descriptors" },
+    { RESTRACK_THREAD_CREATE, "Threads" },
+    { RESTRACK_ALLOC_CHURN, "Allocation Churn" },
+};
+
+//
+// Number of call stacks in the text churn report
+//
+#define RESTRACK_CHURN_TOP      50
+
 
-extern std::unordered_map<int, ProcDumpConfiguration*> activeConfigurations;
-extern pthread_mutex_t activeConfigurationsMutex;
 extern struct ProcDumpConfiguration g_config;
 
+//
+// The restrack engine is shared by all monitored processes. The eBPF program is loaded once
+// and filters on the set of target PIDs (targetPidMap). Events are dispatched to the
+// configuration of the process they belong to.
+//
+// engineMutex protects the lifetime of the engine (loading/unloading) and the allocator links.
+// targetsMutex protects the targets map. bStop is read by the polling thread without a lock.
+//
+struct RestrackEngine
+{
+    struct procdump_ebpf* skel;
+    struct ring_buffer* ringBuffer;
+    pthread_t pollingThread;
+    std::atomic<bool> bStop;
+    int targetCount;
+    std::unordered_map<pid_t, ProcDumpConfiguration*> targets;
+    std::unordered_map<pid_t, std::vector<struct bpf_link*>> targetLinks;
+    std::unordered_set<pid_t> perfMapTargets;       // .NET targets we enabled the perf map of
+    pthread_mutex_t engineMutex;
+    pthread_mutex_t targetsMutex;
+};
+
+static RestrackEngine restrackEngine = { NULL, NULL, 0, {false}, 0, {}, {}, {}, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER };
+
+//
+// Allocator entry points we look for in the modules of the target process. The type
+// determines which eBPF programs are attached (the arguments differ between them).
+//
+enum RestrackAllocatorType
+{
+    AllocatorMalloc,            // (size)
+    AllocatorFree,              // (ptr)
+    AllocatorCalloc,            // (count, size)
+    AllocatorRealloc,           // (ptr, size)
+    AllocatorReallocArray,      // (ptr, count, size)
+    AllocatorAlignedAlloc,      // (alignment, size)
+    AllocatorPosixMemalign      // (memptr, alignment, size)
+};
+
+struct RestrackAllocatorFunction
+{
+    const char* name;
+    enum RestrackAllocatorType type;
+};
+
+static const struct RestrackAllocatorFunction restrackAllocatorFunctions[] =
+{
+    // libc
+    { "malloc", AllocatorMalloc },
+    { "valloc", AllocatorMalloc },
+    { "pvalloc", AllocatorMalloc },
+    { "free", AllocatorFree },
+    { "cfree", AllocatorFree },
+    { "calloc", AllocatorCalloc },
+    { "realloc", AllocatorRealloc },
+    { "reallocarray", AllocatorReallocArray },
+    { "aligned_alloc", AllocatorAlignedAlloc },
+    { "memalign", AllocatorAlignedAlloc },
+    { "posix_memalign", AllocatorPosixMemalign },
+
+    // C++ operator new/delete
+    { "_Znwm", AllocatorMalloc },
+    { "_Znam", AllocatorMalloc },
+    { "_ZnwmRKSt9nothrow_t", AllocatorMalloc },
+    { "_ZnamRKSt9nothrow_t", AllocatorMalloc },
+    { "_ZnwmSt11align_val_t", AllocatorMalloc },
+    { "_ZnamSt11align_val_t", AllocatorMalloc },
+    { "_ZnwmSt11align_val_tRKSt9nothrow_t", AllocatorMalloc },
+    { "_ZnamSt11align_val_tRKSt9nothrow_t", AllocatorMalloc },
+    { "_ZdlPv", AllocatorFree },
+    { "_ZdaPv", AllocatorFree },
+    { "_ZdlPvm", AllocatorFree },
+    { "_ZdaPvm", AllocatorFree },
+    { "_ZdlPvRKSt9nothrow_t", AllocatorFree },
+    { "_ZdaPvRKSt9nothrow_t", AllocatorFree },
+    { "_ZdlPvSt11align_val_t", AllocatorFree },
+    { "_ZdaPvSt11align_val_t", AllocatorFree },
+    { "_ZdlPvmSt11align_val_t", AllocatorFree },
+    { "_ZdaPvmSt11align_val_t", AllocatorFree },
+
+    // jemalloc (prefixed and non standard API)
+    { "je_malloc", AllocatorMalloc },
+    { "je_valloc", AllocatorMalloc },
+    { "je_mallocx", AllocatorMalloc },
+    { "mallocx", AllocatorMalloc },
+    { "je_free", AllocatorFree },
+    { "je_dallocx", AllocatorFree },
+    { "dallocx", AllocatorFree },
+    { "je_sdallocx", AllocatorFree },
+    { "sdallocx", AllocatorFree },
+    { "je_calloc", AllocatorCalloc },
+    { "je_realloc", AllocatorRealloc },
+    { "je_rallocx", AllocatorRealloc },
+    { "rallocx", AllocatorRealloc },
+    { "je_aligned_alloc", AllocatorAlignedAlloc },
+    { "je_memalign", AllocatorAlignedAlloc },
+    { "je_posix_memalign", AllocatorPosixMemalign },
+
+    // tcmalloc
+    { "tc_malloc", AllocatorMalloc },
+    { "tc_valloc", AllocatorMalloc },
+    { "tc_pvalloc", AllocatorMalloc },
+    { "tc_new", AllocatorMalloc },
+    { "tc_newarray", AllocatorMalloc },
+    { "tc_new_nothrow", AllocatorMalloc },
+    { "tc_newarray_nothrow", AllocatorMalloc },
+    { "tc_free", AllocatorFree },
+    { "tc_cfree", AllocatorFree },
+    { "tc_free_sized", AllocatorFree },
+    { "tc_delete", AllocatorFree },
+    { "tc_deletearray", AllocatorFree },
+    { "tc_delete_nothrow", AllocatorFree },
+    { "tc_deletearray_nothrow", AllocatorFree },
+    { "tc_calloc", AllocatorCalloc },
+    { "tc_realloc", AllocatorRealloc },
+    { "tc_memalign", AllocatorAlignedAlloc },
+    { "tc_posix_memalign", AllocatorPosixMemalign },
+
+    // mimalloc
+    { "mi_malloc", AllocatorMalloc },
+    { "mi_zalloc", AllocatorMalloc },
+    { "mi_malloc_aligned", AllocatorMalloc },
+    { "mi_free", AllocatorFree },
+    { "mi_calloc", AllocatorCalloc },
+    { "mi_realloc", AllocatorRealloc },
+};
+
+struct RestrackModule
+{
+    std::string path;
+    uint64_t devMajor;
+    uint64_t devMinor;
+    uint64_t inode;
+};
+
+struct RestrackModulesPayload
+{
+    pid_t pid;
+    std::vector<RestrackModule>* modules;
+};
+
+struct RestrackAllocatorSymbol
+{
+    uint64_t address;
+    const struct RestrackAllocatorFunction* function;
+};
+
+struct RestrackLoadSection
+{
+    uint64_t address;
+    uint64_t size;
+    uint64_t offset;
+};
+
 
 
 // ------------------------------------------------------------------------------------------
@@ -69,6 +228,20 @@ static int libbpf_print_fn(enum libbpf_print_level level, const char *format, va
     return 0;
 }
 
+// ------------------------------------------------------------------------------------------
+// SetLibbpfPrint
+//
+// Sets up extended eBPF error logging if diagnostics logging is enabled. Shared by the
+// restrack and trigger eBPF programs.
+// ------------------------------------------------------------------------------------------
+void SetLibbpfPrint(struct ProcDumpConfiguration *config)
+{
+    if(config->DiagnosticsLoggingEnabled != none)
+    {
+        libbpf_set_print(libbpf_print_fn);
+    }
+}
+
 
 // ------------------------------------------------------------------------------------------
 // SetMaxRLimit
@@ -85,6 +258,29 @@ void SetMaxRLimit()
     setrlimit(RLIMIT_MEMLOCK, &lim);
 }
 
+// ------------------------------------------------------------------------------------------
+// InitRestrackSymbolCache
+//
+// Persists the symbol tables of the modules (keyed by build id) under the procdump temp
+// directory so that later reports, targets and procdump instances don't parse the same
+// binaries again. The directory is only used if it's private to us.
+// ------------------------------------------------------------------------------------------
+void InitRestrackSymbolCache()
+{
+    const char* prefixTmpFolder = getenv("TMPDIR");
+    std::string dir = std::string(prefixTmpFolder != NULL ? prefixTmpFolder : "/tmp") + "/procdump/symcache";
+
+    struct stat st = {};
+    mkdir(dir.c_str(), 0700);
+    if(lstat(dir.c_str(), &st) < 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 077) != 0)
+    {
+        Trace("InitRestrackSymbolCache: Symbol cache directory %s is not usable.", dir.c_str());
+        return;
+    }
+
+    bcc_symcache_set_cache_dir(dir.c_str());
+}
+
 //--------------------------------------------------------------------
 //
 // StopRestrack
@@ -102,7 +298,9 @@ void StopRestrack(struct procdump_ebpf* skel)
 // RunRestrack
 //
 // Loads the restrack eBPF program and attaches to the memory alloc
-// APIs.
+// APIs. The program is shared by all the processes being tracked,
+// processes are added and removed using RestrackAddTarget and
+// RestrackRemoveTarget.
 //
 //--------------------------------------------------------------------
 struct procdump_ebpf* RunRestrack(struct ProcDumpConfiguration *config)
@@ -111,14 +309,12 @@ struct procdump_ebpf* RunRestrack(struct ProcDumpConfiguration *config)
     struct procdump_ebpf *skel = NULL;
 
     SetMaxRLimit();
+    InitRestrackSymbolCache();
 
     //
     // Setup extended error logging
     //
-    if(config->DiagnosticsLoggingEnabled != none)
-    {
-        libbpf_set_print(libbpf_print_fn);
-    }
+    SetLibbpfPrint(config);
 
     //
     // Open the eBPF program
@@ -130,21 +326,31 @@ struct procdump_ebpf* RunRestrack(struct ProcDumpConfiguration *config)
     }
 
     //
-    // Set eBPF program globals
+    // Set eBPF program globals. Target PIDs are specified using procdump's view of
+    // the PID (and not the target's) so we use procdump's pid namespace.
     //
-    std::string path = "/proc/" + std::to_string(config->ProcessId) + "/ns/pid";
     struct stat sb = {};
-    if (stat(path.c_str(), &sb) == -1)
+    if (stat("/proc/self/ns/pid", &sb) == -1)
     {
-        Trace("Failed to stat %s (%s)\n", path.c_str(), strerror(errno));
+        Trace("Failed to stat /proc/self/ns/pid (%s)\n", strerror(errno));
+        procdump_ebpf__destroy(skel);
         return NULL;
     }
 
     skel->bss->dev = sb.st_dev;
     skel->bss->inode = sb.st_ino;
-    skel->bss->target_PID = config->ProcessId;
     skel->bss->sampleRate = config->SampleRate;
     skel->bss->currentSampleCount = 1;
+    skel->bss->churnMode = config->bRestrackChurn;
+
+    //
+    // The churn maps are only needed in churn mode (the stack trace map is preallocated)
+    //
+    if(config->bRestrackChurn == false)
+    {
+        bpf_map__set_max_entries(skel->maps.churnStackMap, 1);
+        bpf_map__set_max_entries(skel->maps.churnMap, 1);
+    }
     if(config->DiagnosticsLoggingEnabled != none)
     {
         skel->bss->isLoggingEnabled = true;
@@ -153,6 +359,7 @@ struct procdump_ebpf* RunRestrack(struct ProcDumpConfiguration *config)
     ret = procdump_ebpf__load(skel);
     if (ret)
     {
+        procdump_ebpf__destroy(skel);
         return NULL;
     }
 
@@ -166,388 +373,1628 @@ struct procdump_ebpf* RunRestrack(struct ProcDumpConfiguration *config)
     return skel;
 }
 
-
 // ------------------------------------------------------------------------------------------
-// RestrackHandleEvent
+// RestrackModuleCallback
 //
-// Handles events from the Restrack eBPF program
+// Called for every executable mapping of the target. Collects the unique, file backed modules.
 // ------------------------------------------------------------------------------------------
-int RestrackHandleEvent(void *ctx, void *data, size_t data_sz)
+static int RestrackModuleCallback(mod_info* mod, int enterNs, void* payload)
 {
-    ResourceInformation* event = (ResourceInformation*) data;
+    struct RestrackModulesPayload* modulesPayload = (struct RestrackModulesPayload*) payload;
 
-    if(event->resourceType == RESTRACK_ALLOC)
+    //
+    // perf maps (JIT code) don't have an inode and have no allocator symbols
+    //
+    if(mod->inode == 0)
     {
-        //
-        // We need to make a copy of the data otherwise the ring buffer might free/overwrite.
-        //
-        event = (ResourceInformation*) malloc(sizeof(ResourceInformation));
-        memcpy(event, data, sizeof(ResourceInformation));
+        return 0;
+    }
 
-        //
-        // Add to allocation map
-        //
-        pthread_mutex_lock(&activeConfigurationsMutex);
-        if(activeConfigurations.find(event->pid) != activeConfigurations.end())
+    for(auto& module : *modulesPayload->modules)
+    {
+        if(module.inode == mod->inode && module.devMajor == mod->dev_major && module.devMinor == mod->dev_minor)
         {
-            pthread_mutex_lock(&activeConfigurations[event->pid]->memAllocMapMutex);
-            activeConfigurations[event->pid]->memAllocMap[(uintptr_t) event->allocAddress] = event;
-            pthread_mutex_unlock(&activeConfigurations[event->pid]->memAllocMapMutex);
-
-            if(activeConfigurations[event->pid]->DiagnosticsLoggingEnabled != none)
-            {
-                Trace("Got event: Alloc size: %ld 0x%lx\n", event->allocSize, event->allocAddress);
-            }
+            return 0;
         }
+    }
 
-        pthread_mutex_unlock(&activeConfigurationsMutex);
+    RestrackModule module;
+    module.devMajor = mod->dev_major;
+    module.devMinor = mod->dev_minor;
+    module.inode = mod->inode;
+
+    //
+    // The module path is in the target's mount namespace
+    //
+    if(enterNs)
+    {
+        module.path = "/proc/" + std::to_string(modulesPayload->pid) + "/root" + mod->name;
     }
-    else if (event->resourceType == RESTRACK_FREE)
+    else
     {
-        pthread_mutex_lock(&activeConfigurationsMutex);
-        if(activeConfigurations.find(event->pid) != activeConfigurations.end())
-        {
-            if(activeConfigurations[event->pid]->memAllocMap.find((uintptr_t) event->allocAddress) != activeConfigurations[event->pid]->memAllocMap.end())
-            {
-                //
-                // If in the allocation map, remove the allocation
-                //
-                pthread_mutex_lock(&activeConfigurations[event->pid]->memAllocMapMutex);
-                free(activeConfigurations[event->pid]->memAllocMap[(uintptr_t) event->allocAddress]);
-                activeConfigurations[event->pid]->memAllocMap.erase((uintptr_t) event->allocAddress);
-                pthread_mutex_unlock(&activeConfigurations[event->pid]->memAllocMapMutex);
-
-                if(activeConfigurations[event->pid]->DiagnosticsLoggingEnabled != none)
-                {
-                    Trace("Got event: free 0x%lx\n", event->allocAddress);
-                }
-            }
-        }
-        pthread_mutex_unlock(&activeConfigurationsMutex);
+        module.path = mod->name;
     }
 
-	return 0;
+    modulesPayload->modules->push_back(module);
+    return 0;
 }
 
 // ------------------------------------------------------------------------------------------
-// strlwr
+// RestrackSymbolCallback
 //
-// Convert string to lowercase.
+// Called for every function symbol in a module. Collects the allocator entry points.
 // ------------------------------------------------------------------------------------------
-inline int strlwr(char* str, size_t len)
+static int RestrackSymbolCallback(const char* name, uint64_t address, uint64_t size, void* payload)
 {
-    for (size_t i = 0; i < len; ++i)
+    static std::unordered_map<std::string, const struct RestrackAllocatorFunction*> functions;
+    std::vector<RestrackAllocatorSymbol>* symbols = (std::vector<RestrackAllocatorSymbol>*) payload;
+
+    if(functions.empty())
     {
-        str[i] = tolower(str[i]);
+        for(auto& function : restrackAllocatorFunctions)
+        {
+            functions[function.name] = &function;
+        }
+    }
+
+    auto it = functions.find(name);
+    if(it != functions.end() && address != 0)
+    {
+        RestrackAllocatorSymbol symbol = { address, it->second };
+        symbols->push_back(symbol);
     }
+
     return 0;
 }
 
 // ------------------------------------------------------------------------------------------
-// WildcardSearch
-//
-// Same wild card search as the Windows version.
+// RestrackLoadSectionCallback
 // ------------------------------------------------------------------------------------------
-bool WildcardSearch(char* entry, char* search)
+static int RestrackLoadSectionCallback(uint64_t address, uint64_t size, uint64_t offset, void* payload)
 {
-    if ((entry == NULL) || (search == NULL))
-        return false;
-
-    char* classLowerMalloc = (char*)malloc(sizeof(char)*(strlen(entry)+1));
-    if (classLowerMalloc == NULL)
-        return false;
+    std::vector<RestrackLoadSection>* sections = (std::vector<RestrackLoadSection>*) payload;
+    RestrackLoadSection section = { address, size, offset };
+    sections->push_back(section);
+    return 0;
+}
 
-    char* searchLowerMalloc = (char*)malloc(sizeof(char)*(strlen(search)+1));
-    if (searchLowerMalloc == NULL)
+// ------------------------------------------------------------------------------------------
+// RestrackGetAllocatorPrograms
+//
+// Returns the entry and exit programs used for the specified allocator type.
+// ------------------------------------------------------------------------------------------
+static void RestrackGetAllocatorPrograms(struct procdump_ebpf* skel, enum RestrackAllocatorType type, struct bpf_program** entry, struct bpf_program** exit)
+{
+    switch(type)
     {
-        free(classLowerMalloc);
-        return false;
+        case AllocatorMalloc:
+            *entry = skel->progs.uprobe_malloc;
+            *exit = skel->progs.uretprobe_malloc;
+            break;
+        case AllocatorFree:
+            *entry = skel->progs.uprobe_free;
+            *exit = NULL;
+            break;
+        case AllocatorCalloc:
+            *entry = skel->progs.uprobe_calloc;
+            *exit = skel->progs.uretprobe_calloc;
+            break;
+        case AllocatorRealloc:
+            *entry = skel->progs.uprobe_realloc;
+            *exit = skel->progs.uretprobe_realloc;
+            break;
+        case AllocatorReallocArray:
+            *entry = skel->progs.uprobe_reallocarray;
+            *exit = skel->progs.uretprobe_reallocarray;
+            break;
+        case AllocatorAlignedAlloc:
+            *entry = skel->progs.uprobe_aligned_alloc;
+            *exit = skel->progs.uretprobe_malloc;
+            break;
+        case AllocatorPosixMemalign:
+            *entry = skel->progs.uprobe_posix_memalign;
+            *exit = skel->progs.uretprobe_posix_memalign;
+            break;
     }
+}
 
-    char* classLower = classLowerMalloc;
-    strcpy(classLower, entry);
-    strlwr(classLower, (strlen(entry)+1));
+// ------------------------------------------------------------------------------------------
+// RestrackAttachAllocators
+//
+// Discovers the allocator entry points in the modules mapped by the target (shared
+// libraries as well as statically linked allocators in the executable) and attaches the
+// matching uprobes to them. In churn mode the free functions are skipped since nothing is
+// outstanding. Returns the number of functions attached.
+// ------------------------------------------------------------------------------------------
+static int RestrackAttachAllocators(struct procdump_ebpf* skel, pid_t pid, bool bChurn, std::vector<struct bpf_link*>& links)
+{
+    std::vector<RestrackModule> modules;
+    struct RestrackModulesPayload modulesPayload = { pid, &modules };
+    struct bcc_symbol_option symbolOption = {};
+    int attached = 0;
 
-    char* searchLower = searchLowerMalloc;
-    strcpy(searchLower, search);
-    strlwr(searchLower, (strlen(search)+1));
+    symbolOption.use_debug_file = 1;
+    symbolOption.check_debug_file_crc = 1;
+    symbolOption.lazy_symbolize = 0;
+    symbolOption.use_symbol_type = (1 << STT_FUNC);
 
-    while ((*searchLower != '\0') && (*classLower != '\0'))
+    if(bcc_procutils_each_module(pid, RestrackModuleCallback, &modulesPayload) != 0)
     {
-        if (*searchLower != '*')
-        {
-            // Straight (case insensitive) compare
-            if (*searchLower != *classLower)
-            {
-                free(classLowerMalloc);
-                classLowerMalloc = NULL;
-
-                free(searchLowerMalloc);
-                searchLowerMalloc = NULL;
+        Trace("RestrackAttachAllocators: Failed to enumerate modules of process %d.", pid);
+        return 0;
+    }
 
-                return false;
-            }
+    for(auto& module : modules)
+    {
+        std::vector<RestrackAllocatorSymbol> symbols;
+        std::vector<RestrackLoadSection> sections;
+        std::vector<uint64_t> offsets;
 
-            searchLower++;
-            classLower++;
+        int type = bcc_elf_get_type(module.path.c_str());
+        if(type != ET_EXEC && type != ET_DYN)
+        {
             continue;
         }
 
-        //
-        // Wildcard processing
-        //
-
-ContinueWildcard:
-        searchLower++;
-
-        // The wildcard is on the end; e.g. '*' 'blah*' or '*blah*'
-        // Must be a match
-        if (*searchLower == '\0')
+        if(bcc_elf_foreach_sym(module.path.c_str(), RestrackSymbolCallback, &symbolOption, &symbols) < 0 || symbols.empty())
         {
-            free(classLowerMalloc);
-            classLowerMalloc = NULL;
-
-            free(searchLowerMalloc);
-            searchLowerMalloc = NULL;
-            return true;
+            continue;
         }
 
-        // Double Wildcard; e.g. '**' 'blah**' or '*blah**'
-        if (*searchLower == '*')
-            goto ContinueWildcard;
-
-        // Find the length of the sub-string to search for
-        int endpos = 0;
-        while ((searchLower[endpos] != '\0') && (searchLower[endpos] != '*'))
-            endpos++;
+        if(bcc_elf_foreach_load_section(module.path.c_str(), RestrackLoadSectionCallback, &sections) < 0)
+        {
+            continue;
+        }
 
-        // Find a match of the sub-search string anywhere within the class string
-        int cc = 0; // Offset in to the Class
-        int ss = 0; // Offset in to the Sub-Search
-        while (ss < endpos)
+        for(auto& symbol : symbols)
         {
-            if (classLower[ss+cc] == '\0')
+            //
+            // Translate the symbol's virtual address to the file offset uprobes expect
+            //
+            uint64_t offset = 0;
+            for(auto& section : sections)
             {
-                free(classLowerMalloc);
-                classLowerMalloc = NULL;
-
-                free(searchLowerMalloc);
-                searchLowerMalloc = NULL;
-
-                return false;
+                if(symbol.address >= section.address && symbol.address < section.address + section.size)
+                {
+                    offset = symbol.address - section.address + section.offset;
+                    break;
+                }
             }
 
-            if (searchLower[ss] != classLower[ss+cc])
+            if(bChurn == true && symbol.function->type == AllocatorFree)
             {
-                cc++;
-                ss = 0;
                 continue;
             }
-            ss++;
-        }
 
-        // If we get here, we found a match; move each string forward
-        searchLower += ss;
-        classLower += (ss + cc);
-    }
+            //
+            // Aliases (for example, tc_malloc and malloc) share the same code, only attach once
+            //
+            if(offset == 0 || std::find(offsets.begin(), offsets.end(), offset) != offsets.end())
+            {
+                continue;
+            }
+            offsets.push_back(offset);
 
-    // Do we have a trailing wildcard?
-    // This happens when Class = ABC.XYZ and Search = *XYZ*
-    // Needed as the trailing wildcard code (above) doesn't run after the ss/cc search as Class is null
-    while (*searchLower == '*')
-    {
-        searchLower++;
-    }
+            struct bpf_program* entry = NULL;
+            struct bpf_program* exit = NULL;
+            RestrackGetAllocatorPrograms(skel, symbol.function->type, &entry, &exit);
 
-    // If Class and Search have no residual, this is a match.
-    if ((*searchLower == '\0') && (*classLower == '\0'))
-    {
-        free(classLowerMalloc);
-        classLowerMalloc = NULL;
+            LIBBPF_OPTS(bpf_uprobe_opts, entryOpts, .retprobe = false);
+            struct bpf_link* entryLink = bpf_program__attach_uprobe_opts(entry, pid, module.path.c_str(), offset, &entryOpts);
+            if(entryLink == NULL)
+            {
+                Trace("RestrackAttachAllocators: Failed to attach to %s in %s (%s).", symbol.function->name, module.path.c_str(), strerror(errno));
+                continue;
+            }
 
-        free(searchLowerMalloc);
-        searchLowerMalloc = NULL;
+            if(exit != NULL)
+            {
+                LIBBPF_OPTS(bpf_uprobe_opts, exitOpts, .retprobe = true);
+                struct bpf_link* exitLink = bpf_program__attach_uprobe_opts(exit, pid, module.path.c_str(), offset, &exitOpts);
+                if(exitLink == NULL)
+                {
+                    Trace("RestrackAttachAllocators: Failed to attach return probe to %s in %s (%s).", symbol.function->name, module.path.c_str(), strerror(errno));
+                    bpf_link__destroy(entryLink);
+                    continue;
+                }
 
-        return true;
-    }
+                links.push_back(exitLink);
+            }
 
-    free(classLowerMalloc);
-    classLowerMalloc = NULL;
+            links.push_back(entryLink);
+            attached++;
 
-    free(searchLowerMalloc);
-    searchLowerMalloc = NULL;
+            Trace("RestrackAttachAllocators: Attached to %s in %s at offset 0x%lx.", symbol.function->name, module.path.c_str(), offset);
+        }
+    }
 
-    return false;
+    return attached;
 }
 
 // ------------------------------------------------------------------------------------------
-// ReportLeaks
+// RestrackPollingThread
 //
-// Reports on leaks
+// Polls the shared ring buffer and dispatches the events to the tracked processes.
 // ------------------------------------------------------------------------------------------
-void* ReportLeaks(void* args)
+void* RestrackPollingThread(void* args)
 {
-    Trace("ReportLeaks:Enter");
-    leakThreadArgs* leakArgs = (leakThreadArgs*) args;
-    ProcDumpConfiguration* config = leakArgs->config;
-    const char* filename = leakArgs->filename;
+    Trace("RestrackPollingThread: Enter [id=%d]", gettid());
+
+    while(restrackEngine.bStop == false)
+    {
+        int err = ring_buffer__poll(restrackEngine.ringBuffer, 100);
+        if (err == -EINTR)
+        {
+            continue;
+        }
+        if (err < 0)
+        {
+            Log(error, "RestrackPollingThread: Error polling ring buffer: %d\n", err);
+            break;
+        }
+    }
+
+    Trace("RestrackPollingThread: Exit [id=%d]", gettid());
+    return NULL;
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackEnablePerfMap
+//
+// JIT'ed frames are symbolized from the perf map of the target (/tmp/perf-<pid>.map). .NET
+// only writes it when started with DOTNET_PerfMapEnabled, otherwise we ask the runtime to
+// write it (.NET 8 and later). Returns true if we enabled it and should disable it later.
+// ------------------------------------------------------------------------------------------
+static bool RestrackEnablePerfMap(pid_t pid)
+{
+    auto_free char* socketName = NULL;
+    if(IsCoreClrProcess(pid, &socketName) == false || IsCoreClrPerfMapEnabled(pid) == true)
+    {
+        return false;
+    }
+
+    if(SetCoreClrPerfMap(socketName, true) == false)
+    {
+        Log(warn, "Failed to enable the perf map of .NET process %d, managed frames will not be symbolized (requires .NET 8 or DOTNET_PerfMapEnabled=1).", pid);
+        return false;
+    }
+
+    Trace("RestrackEnablePerfMap: Enabled the perf map of %d.", pid);
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackAddTarget
+//
+// Adds the process to the set of processes tracked by the shared restrack engine. The eBPF
+// program, ring buffer and polling thread are created when the first target is added.
+// ------------------------------------------------------------------------------------------
+bool RestrackAddTarget(struct ProcDumpConfiguration *config)
+{
+    bool ret = false;
+    __u8 tracked = 1;
+
+    pthread_mutex_lock(&restrackEngine.engineMutex);
+
+    if(restrackEngine.targetCount == 0)
+    {
+        if((restrackEngine.skel = RunRestrack(config)) == NULL)
+        {
+            Trace("RestrackAddTarget: Failed to run restrack eBPF program.");
+            pthread_mutex_unlock(&restrackEngine.engineMutex);
+            return false;
+        }
+
+        restrackEngine.ringBuffer = ring_buffer__new(bpf_map__fd(restrackEngine.skel->maps.ringBuffer), RestrackHandleEvent, NULL, NULL);
+        if (!restrackEngine.ringBuffer)
+        {
+            Trace("RestrackAddTarget: Failed to create ring buffer.");
+            StopRestrack(restrackEngine.skel);
+            restrackEngine.skel = NULL;
+            pthread_mutex_unlock(&restrackEngine.engineMutex);
+            return false;
+        }
+
+        restrackEngine.bStop = false;
+        if(pthread_create(&restrackEngine.pollingThread, NULL, RestrackPollingThread, NULL) != 0)
+        {
+            Trace("RestrackAddTarget: Failed to create polling thread.");
+            ring_buffer__free(restrackEngine.ringBuffer);
+            restrackEngine.ringBuffer = NULL;
+            StopRestrack(restrackEngine.skel);
+            restrackEngine.skel = NULL;
+            pthread_mutex_unlock(&restrackEngine.engineMutex);
+            return false;
+        }
+    }
+
+    pthread_mutex_lock(&restrackEngine.targetsMutex);
+    restrackEngine.targets[config->ProcessId] = config;
+    pthread_mutex_unlock(&restrackEngine.targetsMutex);
+
+    if(bpf_map__update_elem(restrackEngine.skel->maps.targetPidMap, &config->ProcessId, sizeof(config->ProcessId), &tracked, sizeof(tracked), BPF_ANY) == 0)
+    {
+        restrackEngine.targetCount++;
+        ret = true;
+
+        //
+        // Memory mappings are tracked by the syscall tracepoints, heap allocations need uprobes
+        // on the allocators the target actually uses.
+        //
+        std::vector<struct bpf_link*>& links = restrackEngine.targetLinks[config->ProcessId];
+        if(RestrackAttachAllocators(restrackEngine.skel, config->ProcessId, config->bRestrackChurn, links) == 0)
+        {
+            Log(warn, "Restrack did not find any known allocator functions in process %d, only memory mappings will be tracked.", config->ProcessId);
+        }
+
+        struct timespec now = {};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        config->restrackChurnWindowStart = now.tv_sec * 1000ULL + now.tv_nsec / 1000000;
+
+        if(RestrackEnablePerfMap(config->ProcessId) == true)
+        {
+            restrackEngine.perfMapTargets.insert(config->ProcessId);
+        }
+    }
+    else
+    {
+        Trace("RestrackAddTarget: Failed to add target %d.", config->ProcessId);
+        pthread_mutex_lock(&restrackEngine.targetsMutex);
+        restrackEngine.targets.erase(config->ProcessId);
+        pthread_mutex_unlock(&restrackEngine.targetsMutex);
+    }
+
+    bool bStarted = ret == true && restrackEngine.targetCount == 1;
+
+    pthread_mutex_unlock(&restrackEngine.engineMutex);
+
+    if(bStarted == true)
+    {
+        Trace("RestrackAddTarget: Restrack engine started.");
+    }
+
+    return ret;
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackRemoveTarget
+//
+// Removes the process from the set of processes tracked by the shared restrack engine. Once
+// this returns no more events are dispatched to the configuration. The engine is torn down
+// when the last target is removed.
+// ------------------------------------------------------------------------------------------
+void RestrackRemoveTarget(struct ProcDumpConfiguration *config)
+{
+    pthread_mutex_lock(&restrackEngine.engineMutex);
+
+    pthread_mutex_lock(&restrackEngine.targetsMutex);
+    bool found = restrackEngine.targets.erase(config->ProcessId) > 0;
+    pthread_mutex_unlock(&restrackEngine.targetsMutex);
+
+    if(found == true)
+    {
+        bpf_map__delete_elem(restrackEngine.skel->maps.targetPidMap, &config->ProcessId, sizeof(config->ProcessId), 0);
+        restrackEngine.targetCount--;
+
+        auto links = restrackEngine.targetLinks.find(config->ProcessId);
+        if(links != restrackEngine.targetLinks.end())
+        {
+            for(auto link : links->second)
+            {
+                bpf_link__destroy(link);
+            }
+            restrackEngine.targetLinks.erase(links);
+        }
+
+        if(restrackEngine.perfMapTargets.erase(config->ProcessId) > 0)
+        {
+            auto_free char* socketName = NULL;
+            if(IsCoreClrProcess(config->ProcessId, &socketName) == true)
+            {
+                SetCoreClrPerfMap(socketName, false);
+            }
+        }
+
+        bcc_symcache_release_perf_map(config->ProcessId);
+
+        if(restrackEngine.targetCount == 0)
+        {
+            restrackEngine.bStop = true;
+            pthread_join(restrackEngine.pollingThread, NULL);
+
+            ring_buffer__free(restrackEngine.ringBuffer);
+            restrackEngine.ringBuffer = NULL;
+
+            StopRestrack(restrackEngine.skel);
+            restrackEngine.skel = NULL;
+            Trace("RestrackRemoveTarget: Restrack engine stopped.");
+        }
+    }
+
+    pthread_mutex_unlock(&restrackEngine.engineMutex);
+}
+
+
+// ------------------------------------------------------------------------------------------
+// RestrackResourceKey
+//
+// Returns the key of a resource in the allocation map. File descriptors and thread ids are
+// small numbers that could clash with each other so they are tagged in the upper bits which
+// are never part of a user mode address.
+// ------------------------------------------------------------------------------------------
+static inline uintptr_t RestrackResourceKey(unsigned int type, unsigned long resource)
+{
+    switch(type)
+    {
+        case RESTRACK_FD_OPEN:
+        case RESTRACK_FD_CLOSE:
+            return (1UL << 63) | resource;
+        case RESTRACK_THREAD_CREATE:
+        case RESTRACK_THREAD_EXIT:
+            return (1UL << 62) | resource;
+        default:
+            return resource;
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// GetRestrackThresholdBytes
+//
+// Returns the restrack memory threshold (-rm) in tracked bytes. With a sample rate only one
+// in SampleRate allocations is tracked, and once the maximum number of tracked resources
+// (-rc) is reached only one in 2^restrackSamplingShift, so the threshold is scaled down
+// accordingly. Called with memAllocMapMutex held.
+// ------------------------------------------------------------------------------------------
+uint64_t GetRestrackThresholdBytes(ProcDumpConfiguration* config)
+{
+    uint64_t threshold = ((uint64_t) config->RestrackThreshold << 20) >> config->restrackSamplingShift;
+    return config->SampleRate > 1 ? threshold / config->SampleRate : threshold;
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackStackHash
+//
+// FNV-1a hash of the call stack of an allocation.
+// ------------------------------------------------------------------------------------------
+static inline uint64_t RestrackStackHash(const ResourceInformation* event)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    long len = event->callStackLen < MAX_CALL_STACK_FRAMES ? event->callStackLen : MAX_CALL_STACK_FRAMES;
+    for(long i = 0; i < len; i++)
+    {
+        hash = (hash ^ event->stackTrace[i]) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackAccount
+//
+// Maintains the running totals of the outstanding allocations used by the restrack memory
+// trigger (-rm) so that checking them is O(1). Called with memAllocMapMutex held for every
+// allocation added to or removed from memAllocMap.
+// ------------------------------------------------------------------------------------------
+static void RestrackAccount(ProcDumpConfiguration* config, const ResourceInformation* event, bool bAdd)
+{
+    if(event->resourceType != RESTRACK_ALLOC)
+    {
+        return;
+    }
+
+    if(bAdd == true)
+    {
+        config->restrackOutstandingBytes += event->allocSize;
+    }
+    else
+    {
+        config->restrackOutstandingBytes -= event->allocSize;
+    }
+
+    if(config->RestrackThreshold == -1 || config->RestrackThresholdType != RestrackThresholdStack)
+    {
+        return;
+    }
+
+    //
+    // Rather than looking for the largest stack on every check, keep count of the stacks
+    // currently at or above the threshold.
+    //
+    uint64_t threshold = GetRestrackThresholdBytes(config);
+    auto it = config->restrackStackBytes.emplace(RestrackStackHash(event), 0).first;
+    bool bWasOver = it->second >= threshold;
+
+    if(bAdd == true)
+    {
+        it->second += event->allocSize;
+    }
+    else
+    {
+        it->second -= event->allocSize;
+    }
+
+    bool bIsOver = it->second >= threshold;
+    if(bIsOver != bWasOver)
+    {
+        config->restrackStacksOverThreshold += bIsOver ? 1 : -1;
+    }
+
+    if(it->second == 0)
+    {
+        config->restrackStackBytes.erase(it);
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackIsSampled
+//
+// Returns true if the resource is kept when one in 2^shift resources is tracked. The decision
+// only depends on the resource so the release of a resource that wasn't kept is ignored and
+// every resource is kept with the same probability, the kept ones stand for 2^shift each.
+// ------------------------------------------------------------------------------------------
+static inline bool RestrackIsSampled(uintptr_t key, unsigned int shift)
+{
+    if(shift == 0)
+    {
+        return true;
+    }
+
+    //
+    // splitmix64 finalizer, allocations are aligned so the low bits of the key are mostly zero.
+    //
+    uint64_t hash = key;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash = hash ^ (hash >> 31);
+
+    return (hash >> (64 - shift)) == 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackDownsample
+//
+// Halves the fraction of the resources that are tracked and evicts the ones that are no
+// longer sampled. Called with memAllocMapMutex held when memAllocMap is over the maximum
+// number of tracked resources (-rc).
+// ------------------------------------------------------------------------------------------
+static void RestrackDownsample(ProcDumpConfiguration* config)
+{
+    unsigned int shift = config->restrackSamplingShift + 1;
+
+    for(auto it = config->memAllocMap.begin(); it != config->memAllocMap.end(); )
+    {
+        if(RestrackIsSampled(it->first, shift) == false)
+        {
+            RestrackAccount(config, it->second, false);
+            free(it->second);
+            it = config->memAllocMap.erase(it);
+            config->restrackEvictedCount++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    config->restrackSamplingShift = shift;
+
+    //
+    // The memory threshold (-rm) is scaled by the sampling, recount the call stacks above it.
+    //
+    if(config->RestrackThreshold != -1 && config->RestrackThresholdType == RestrackThresholdStack)
+    {
+        uint64_t threshold = GetRestrackThresholdBytes(config);
+        config->restrackStacksOverThreshold = 0;
+        for(const auto& pair : config->restrackStackBytes)
+        {
+            if(pair.second >= threshold)
+            {
+                config->restrackStacksOverThreshold++;
+            }
+        }
+    }
+
+    Log(warn, "Restrack is tracking more than %d resources in process %d, only 1 in %llu resources are tracked from now on.", config->RestrackMaxResources > 0 ? config->RestrackMaxResources : RESTRACK_DEFAULT_MAX_RESOURCES, config->ProcessId, 1ULL << shift);
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackHandleEvent
+//
+// Handles events from the Restrack eBPF program and dispatches them to the allocation map
+// of the process they belong to.
+// ------------------------------------------------------------------------------------------
+int RestrackHandleEvent(void *ctx, void *data, size_t data_sz)
+{
+    ResourceInformation* event = (ResourceInformation*) data;
+
+    pthread_mutex_lock(&restrackEngine.targetsMutex);
+
+    auto target = restrackEngine.targets.find(event->pid);
+    if(target == restrackEngine.targets.end())
+    {
+        pthread_mutex_unlock(&restrackEngine.targetsMutex);
+        return 0;
+    }
+
+    ProcDumpConfiguration* config = target->second;
+
+    uintptr_t key = RestrackResourceKey(event->resourceType, event->allocAddress);
+
+    if(event->resourceType == RESTRACK_ALLOC || event->resourceType == RESTRACK_FD_OPEN || event->resourceType == RESTRACK_THREAD_CREATE)
+    {
+        //
+        // We need to make a copy of the data otherwise the ring buffer might free/overwrite.
+        // Only the captured frames are copied, most call stacks are much shorter than the
+        // maximum.
+        //
+        size_t callStackLen = event->callStackLen < MAX_CALL_STACK_FRAMES ? event->callStackLen : MAX_CALL_STACK_FRAMES;
+        size_t size = offsetof(ResourceInformation, stackTrace) + callStackLen * sizeof(__u64);
+
+        pthread_mutex_lock(&config->memAllocMapMutex);
+
+        //
+        // Once the maximum number of tracked resources was reached, only the sampled resources
+        // are added.
+        //
+        if(RestrackIsSampled(key, config->restrackSamplingShift) == false)
+        {
+            config->restrackDroppedCount++;
+        }
+        else
+        {
+            event = (ResourceInformation*) malloc(size);
+            if(event != NULL)
+            {
+                memcpy(event, data, size);
+                event->callStackLen = callStackLen;
+
+                //
+                // Add to allocation map. If the resource is already in the map we missed the release
+                // (for example, it wasn't sampled or a descriptor was implicitly closed by dup2) so
+                // we replace the entry.
+                //
+                auto it = config->memAllocMap.find(key);
+                if(it != config->memAllocMap.end())
+                {
+                    RestrackAccount(config, it->second, false);
+                    free(it->second);
+                    it->second = event;
+                }
+                else
+                {
+                    config->memAllocMap[key] = event;
+                }
+                RestrackAccount(config, event, true);
+
+                if(config->DiagnosticsLoggingEnabled != none)
+                {
+                    Trace("Got event: Alloc type: %d size: %ld 0x%lx\n", event->resourceType, event->allocSize, event->allocAddress);
+                }
+
+                size_t maxResources = config->RestrackMaxResources > 0 ? config->RestrackMaxResources : RESTRACK_DEFAULT_MAX_RESOURCES;
+                while(config->memAllocMap.size() > maxResources && config->restrackSamplingShift + 1 < RESTRACK_MAX_SAMPLING_SHIFT)
+                {
+                    RestrackDownsample(config);
+                }
+            }
+        }
+
+        pthread_mutex_unlock(&config->memAllocMapMutex);
+    }
+    else if (event->resourceType == RESTRACK_FREE || event->resourceType == RESTRACK_FD_CLOSE || event->resourceType == RESTRACK_THREAD_EXIT)
+    {
+        //
+        // If in the allocation map, remove the allocation
+        //
+        pthread_mutex_lock(&config->memAllocMapMutex);
+        auto it = config->memAllocMap.find(key);
+        if(it != config->memAllocMap.end())
+        {
+            RestrackAccount(config, it->second, false);
+            free(it->second);
+            config->memAllocMap.erase(it);
+
+            if(config->DiagnosticsLoggingEnabled != none)
+            {
+                Trace("Got event: free type: %d 0x%lx\n", event->resourceType, event->allocAddress);
+            }
+        }
+        pthread_mutex_unlock(&config->memAllocMapMutex);
+    }
+
+    pthread_mutex_unlock(&restrackEngine.targetsMutex);
+
+	return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// strlwr
+//
+// Convert string to lowercase.
+// ------------------------------------------------------------------------------------------
+inline int strlwr(char* str, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        str[i] = tolower(str[i]);
+    }
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// WildcardSearch
+//
+// Same wild card search as the Windows version.
+// ------------------------------------------------------------------------------------------
+bool WildcardSearch(char* entry, char* search)
+{
+    if ((entry == NULL) || (search == NULL))
+        return false;
+
+    char* classLowerMalloc = (char*)malloc(sizeof(char)*(strlen(entry)+1));
+    if (classLowerMalloc == NULL)
+        return false;
+
+    char* searchLowerMalloc = (char*)malloc(sizeof(char)*(strlen(search)+1));
+    if (searchLowerMalloc == NULL)
+    {
+        free(classLowerMalloc);
+        return false;
+    }
+
+    char* classLower = classLowerMalloc;
+    strcpy(classLower, entry);
+    strlwr(classLower, (strlen(entry)+1));
+
+    char* searchLower = searchLowerMalloc;
+    strcpy(searchLower, search);
+    strlwr(searchLower, (strlen(search)+1));
+
+    while ((*searchLower != '\0') && (*classLower != '\0'))
+    {
+        if (*searchLower != '*')
+        {
+            // Straight (case insensitive) compare
+            if (*searchLower != *classLower)
+            {
+                free(classLowerMalloc);
+                classLowerMalloc = NULL;
+
+                free(searchLowerMalloc);
+                searchLowerMalloc = NULL;
+
+                return false;
+            }
+
+            searchLower++;
+            classLower++;
+            continue;
+        }
+
+        //
+        // Wildcard processing
+        //
+
+ContinueWildcard:
+        searchLower++;
+
+        // The wildcard is on the end; e.g. '*' 'blah*' or '*blah*'
+        // Must be a match
+        if (*searchLower == '\0')
+        {
+            free(classLowerMalloc);
+            classLowerMalloc = NULL;
+
+            free(searchLowerMalloc);
+            searchLowerMalloc = NULL;
+            return true;
+        }
+
+        // Double Wildcard; e.g. '**' 'blah**' or '*blah**'
+        if (*searchLower == '*')
+            goto ContinueWildcard;
+
+        // Find the length of the sub-string to search for
+        int endpos = 0;
+        while ((searchLower[endpos] != '\0') && (searchLower[endpos] != '*'))
+            endpos++;
+
+        // Find a match of the sub-search string anywhere within the class string
+        int cc = 0; // Offset in to the Class
+        int ss = 0; // Offset in to the Sub-Search
+        while (ss < endpos)
+        {
+            if (classLower[ss+cc] == '\0')
+            {
+                free(classLowerMalloc);
+                classLowerMalloc = NULL;
+
+                free(searchLowerMalloc);
+                searchLowerMalloc = NULL;
+
+                return false;
+            }
+
+            if (searchLower[ss] != classLower[ss+cc])
+            {
+                cc++;
+                ss = 0;
+                continue;
+            }
+            ss++;
+        }
+
+        // If we get here, we found a match; move each string forward
+        searchLower += ss;
+        classLower += (ss + cc);
+    }
+
+    // Do we have a trailing wildcard?
+    // This happens when Class = ABC.XYZ and Search = *XYZ*
+    // Needed as the trailing wildcard code (above) doesn't run after the ss/cc search as Class is null
+    while (*searchLower == '*')
+    {
+        searchLower++;
+    }
+
+    // If Class and Search have no residual, this is a match.
+    if ((*searchLower == '\0') && (*classLower == '\0'))
+    {
+        free(classLowerMalloc);
+        classLowerMalloc = NULL;
+
+        free(searchLowerMalloc);
+        searchLowerMalloc = NULL;
+
+        return true;
+    }
+
+    free(classLowerMalloc);
+    classLowerMalloc = NULL;
+
+    free(searchLowerMalloc);
+    searchLowerMalloc = NULL;
+
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------
+// GetRestrackSectionTitle
+//
+// Returns the title of the report section of the specified resource type.
+// ------------------------------------------------------------------------------------------
+const char* GetRestrackSectionTitle(unsigned int type)
+{
+    for (const auto& section : restrackReportSections)
+    {
+        if(section.type == type)
+        {
+            return section.title;
+        }
+    }
+
+    return "Unknown";
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackGroupKey
+//
+// Returns the key identifying a group of resources (type, size and call stack).
+// ------------------------------------------------------------------------------------------
+static std::string RestrackGroupKey(unsigned int type, unsigned long size, unsigned int callStackLen, const __u64* stackTrace)
+{
+    std::string key;
+    key.reserve(sizeof(type) + sizeof(size) + callStackLen * sizeof(__u64));
+    key.append((const char*) &type, sizeof(type));
+    key.append((const char*) &size, sizeof(size));
+    key.append((const char*) stackTrace, callStackLen * sizeof(__u64));
+    return key;
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackAgeBucket
+//
+// Returns the age histogram bucket (<1s, <1m, <10m, older) of the specified age.
+// ------------------------------------------------------------------------------------------
+static inline int RestrackAgeBucket(uint64_t ageNs)
+{
+    static const uint64_t bucketLimits[RESTRACK_AGE_BUCKETS - 1] = { 1000000000ULL, 60 * 1000000000ULL, 600 * 1000000000ULL };
+
+    for(int i=0; i<RESTRACK_AGE_BUCKETS - 1; i++)
+    {
+        if(ageNs < bucketLimits[i])
+        {
+            return i;
+        }
+    }
+
+    return RESTRACK_AGE_BUCKETS - 1;
+}
+
+// ------------------------------------------------------------------------------------------
+// GroupResource
+//
+// Adds a resource to the group with the same type, size and call stack. Each resource counts
+// as weight resources (the sampling weight once the maximum number of tracked resources was
+// reached).
+// ------------------------------------------------------------------------------------------
+void GroupResource(std::unordered_map<std::string, groupedAllocEntry>& groups, unsigned int type, unsigned long size, uint64_t ageNs, unsigned int callStackLen, const unsigned long long* stackTrace, uint64_t weight)
+{
+    if(callStackLen > MAX_CALL_STACK_FRAMES)
+    {
+        callStackLen = MAX_CALL_STACK_FRAMES;
+    }
+
+    groupedAllocEntry& entry = groups[RestrackGroupKey(type, size, callStackLen, stackTrace)];
+    if(entry.allocCount == 0)
+    {
+        entry.type = type;
+        entry.allocSize = size;
+        entry.callStackLen = callStackLen;
+        memcpy(entry.stackTrace, stackTrace, sizeof(__u64) * callStackLen);
+    }
+
+    entry.allocCount += weight;
+    entry.totalAllocSize += size * weight;
+    entry.ageHistogram[RestrackAgeBucket(ageNs)] += weight;
+}
+
+// ------------------------------------------------------------------------------------------
+// GroupResources
+//
+// Groups the outstanding resources of the target by type, size and call stack. Resources
+// younger than the minimum age (-ra) are left out.
+// ------------------------------------------------------------------------------------------
+static void GroupResources(ProcDumpConfiguration* config, uint64_t nowNs, std::unordered_map<std::string, groupedAllocEntry>& groups)
+{
+    uint64_t minAgeNs = (uint64_t) config->RestrackMinAge * 1000000000ULL;
+    uint64_t weight = 1ULL << config->restrackSamplingShift;
+
+    for (const auto& pair : config->memAllocMap)
+    {
+        ResourceInformation* resource = pair.second;
+        uint64_t ageNs = nowNs > resource->timestamp ? nowNs - resource->timestamp : 0;
+        if(ageNs < minAgeNs)
+        {
+            continue;
+        }
+
+        GroupResource(groups, resource->resourceType, resource->allocSize, ageNs, resource->callStackLen < 0 ? 0 : resource->callStackLen, resource->stackTrace, weight);
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// CollectChurn
+//
+// Moves the allocations counted in-kernel for the target (churn mode) into groups, one per
+// call stack, and removes them from the maps so that every report covers the window since
+// the previous one. Allocations counted between the lookup and the delete are lost. The
+// stack map dedups identical stacks, so processes with the same layout (forked workers)
+// share stack ids and a stack is only removed once no other target references it.
+// ------------------------------------------------------------------------------------------
+static void CollectChurn(ProcDumpConfiguration* config, std::unordered_map<std::string, groupedAllocEntry>& groups)
+{
+    int numCpus = libbpf_num_possible_cpus();
+    if(numCpus <= 0)
+    {
+        Trace("CollectChurn: Failed to get the number of cpus.");
+        return;
+    }
+
+    std::vector<struct ChurnValue> values(numCpus);
+    std::vector<struct ChurnKey> keys;
+    std::unordered_set<int> sharedStackIds;
+    __u64 stackTrace[MAX_CALL_STACK_FRAMES];
+
+    pthread_mutex_lock(&restrackEngine.engineMutex);
+
+    if(restrackEngine.skel == NULL)
+    {
+        pthread_mutex_unlock(&restrackEngine.engineMutex);
+        return;
+    }
+
+    struct bpf_map* churnMap = restrackEngine.skel->maps.churnMap;
+    struct bpf_map* stackMap = restrackEngine.skel->maps.churnStackMap;
+
+    //
+    // The keys of all the targets are in the same map, collect ours before deleting anything
+    //
+    struct ChurnKey key = {};
+    struct ChurnKey nextKey = {};
+    struct ChurnKey* previousKey = NULL;
+    while(bpf_map__get_next_key(churnMap, previousKey, &nextKey, sizeof(nextKey)) == 0)
+    {
+        if(nextKey.pid == (unsigned int) config->ProcessId)
+        {
+            keys.push_back(nextKey);
+        }
+        else
+        {
+            sharedStackIds.insert(nextKey.stackId);
+        }
+
+        key = nextKey;
+        previousKey = &key;
+    }
+
+    for(auto& churnKey : keys)
+    {
+        if(bpf_map__lookup_elem(churnMap, &churnKey, sizeof(churnKey), values.data(), values.size() * sizeof(struct ChurnValue), 0) != 0)
+        {
+            continue;
+        }
+        bpf_map__delete_elem(churnMap, &churnKey, sizeof(churnKey), 0);
+
+        //
+        // Stacks that couldn't be captured (for example, the stack map was full) are grouped
+        // under an empty call stack
+        //
+        unsigned int callStackLen = 0;
+        if(churnKey.stackId >= 0)
+        {
+            __u32 stackId = churnKey.stackId;
+            memset(stackTrace, 0, sizeof(stackTrace));
+            if(bpf_map__lookup_elem(stackMap, &stackId, sizeof(stackId), stackTrace, sizeof(stackTrace), 0) == 0)
+            {
+                while(callStackLen < MAX_CALL_STACK_FRAMES && stackTrace[callStackLen] != 0)
+                {
+                    callStackLen++;
+                }
+            }
+            if(sharedStackIds.count(churnKey.stackId) == 0)
+            {
+                bpf_map__delete_elem(stackMap, &stackId, sizeof(stackId), 0);
+            }
+        }
+
+        groupedAllocEntry& entry = groups[RestrackGroupKey(RESTRACK_ALLOC_CHURN, 0, callStackLen, stackTrace)];
+        if(entry.allocCount == 0)
+        {
+            entry.type = RESTRACK_ALLOC_CHURN;
+            entry.callStackLen = callStackLen;
+            memcpy(entry.stackTrace, stackTrace, sizeof(__u64) * callStackLen);
+        }
+
+        for(auto& value : values)
+        {
+            entry.allocCount += value.count;
+            entry.totalAllocSize += value.bytes;
+        }
+    }
+
+    pthread_mutex_unlock(&restrackEngine.engineMutex);
+}
+
+// ------------------------------------------------------------------------------------------
+// ResolveCallStack
+//
+// Gets the symbol information for the frames of a grouped call stack. Returns false if the
+// call stack contains a frame that matches the exclude filter.
+// ------------------------------------------------------------------------------------------
+bool ResolveCallStack(ProcDumpConfiguration* config, void* symResolver, const groupedAllocEntry& entry, std::vector<stackFrame>& callStack)
+{
+    bool excluded = false;
 
-    std::ofstream file(filename);
-    if (!file)
+    for(unsigned int i=0; i<entry.callStackLen; i++)
     {
-        Trace("ReportLeaks: Failed to open file: %s", filename);
-        return NULL;
-    }
+        if(entry.stackTrace[i] > 0)
+        {
+            bcc_symbol sym = {};
+            bcc_symcache_resolve(symResolver, entry.stackTrace[i], &sym);
 
-    config->bLeakReportInProgress = true;
+            stackFrame frame = {};
+            frame.offset = sym.offset;
+            if(sym.name != NULL)
+            {
+                frame.symbolName = sym.name;
+            }
 
-    if(config->memAllocMap.size() > 0)
-    {
-        void* symResolver = bcc_symcache_new(config->ProcessId, NULL);
+            if(sym.demangle_name != NULL)
+            {
+                frame.demangledSymbolName = sym.demangle_name;
+            }
 
-        //
-        // Since its a snapshot, copy the alloc map so we can avoid synchronization issues.
-        //
-        pthread_mutex_lock(&config->memAllocMapMutex);
+            if(sym.module != NULL)
+            {
+                frame.moduleName = sym.module;
+            }
 
-        std::vector<groupedAllocEntry> groupedAllocations;
+            frame.pc = entry.stackTrace[i];
 
-        //
-        // Group the call stacks
-        //
-        for (const auto& pair : config->memAllocMap)
-        {
-            bool found = false;
-            for(int i=0; i<(int) groupedAllocations.size(); i++)
+            //
+            // If the stack contains an ignore frame, don't print it
+            //
+            if(config->ExcludeFilter != NULL && excluded == false)
             {
-                if(groupedAllocations[i].callStackLen == pair.second->callStackLen && (groupedAllocations[i].allocSize == pair.second->allocSize || groupedAllocations[i].allocSize == 0))
+                int len = snprintf(NULL, 0, "\t[0x%llx] %s+0x%lx\n", entry.stackTrace[i], frame.demangledSymbolName.c_str(), frame.offset);
+                auto_free char* fullName = (char*) malloc(len+1);
+                if(fullName != NULL)
                 {
-                    bool match = true;
-                    for(int j=0; j<pair.second->callStackLen; j++)
-                    {
-                        if(groupedAllocations[i].stackTrace[j] != pair.second->stackTrace[j])
-                        {
-                            match = false;
-                            break;
-                        }
-                    }
-
-                    if(match == true)
-                    {
-                        groupedAllocations[i].allocCount++;
-                        groupedAllocations[i].totalAllocSize += pair.second->allocSize;
-                        found = true;
-                        break;
-                    }
+                    snprintf(fullName, len, "\t[0x%llx] %s+0x%lx\n", entry.stackTrace[i], frame.demangledSymbolName.c_str(), frame.offset);
+                    excluded = WildcardSearch(fullName, config->ExcludeFilter);
                 }
             }
 
-            if(found == false)
-            {
-                groupedAllocEntry entry = {};
-                entry.type = pair.second->resourceType;
-                entry.allocCount = 1;
-                entry.allocSize = pair.second->allocSize;
-                entry.totalAllocSize = pair.second->allocSize;
-                entry.callStackLen = pair.second->callStackLen;
-                memcpy(entry.stackTrace, pair.second->stackTrace, sizeof(__u64) * pair.second->callStackLen);
-                groupedAllocations.push_back(entry);
-            }
+            callStack.push_back(frame);
         }
+    }
 
-        pthread_mutex_unlock(&config->memAllocMapMutex);
+    return excluded == false;
+}
+
+// ------------------------------------------------------------------------------------------
+// WriteCallStack
+// ------------------------------------------------------------------------------------------
+static void WriteCallStack(std::ofstream& file, const std::vector<stackFrame>& callStack)
+{
+    for (const auto& st : callStack)
+    {
+        if(st.demangledSymbolName.length() > 0)
+        {
+            file << "\t[0x" << std::hex << st.pc << "] " << st.demangledSymbolName.c_str() << "+0x" << std::hex << st.offset << "\n";
+        }
+        else
+        {
+            file << "\t[0x" << std::hex << st.pc << "]\n";
+        }
+    }
+
+    file << "\n";
+}
 
+// ------------------------------------------------------------------------------------------
+// WriteAgeHistogram
+// ------------------------------------------------------------------------------------------
+static void WriteAgeHistogram(std::ofstream& file, const groupedAllocEntry& group)
+{
+    static const char* bucketNames[RESTRACK_AGE_BUCKETS] = { "<1s", "<1m", "<10m", "older" };
 
-        // Sort the vector based on the totalAllocSize field in ascending order
-        std::sort(groupedAllocations.begin(), groupedAllocations.end(), [](const groupedAllocEntry& a, const groupedAllocEntry& b) {
-            return a.totalAllocSize > b.totalAllocSize;
-        });
+    file << " age:";
+    for(int i=0; i<RESTRACK_AGE_BUCKETS; i++)
+    {
+        file << " " << bucketNames[i] << ":0x" << std::hex << group.ageHistogram[i];
+    }
+}
 
-        //
-        // Print out the leaks
-        //
+// ------------------------------------------------------------------------------------------
+// WriteSignedHex
+// ------------------------------------------------------------------------------------------
+static void WriteSignedHex(std::ofstream& file, long value)
+{
+    file << (value < 0 ? "-0x" : "+0x") << std::hex << (value < 0 ? -value : value);
+}
+
+// ------------------------------------------------------------------------------------------
+// WriteLeakReport
+//
+// Writes the outstanding resources, each resource type in its own section.
+// ------------------------------------------------------------------------------------------
+static void WriteLeakReport(std::ofstream& file, ProcDumpConfiguration* config, void* symResolver, std::vector<const groupedAllocEntry*>& groups)
+{
+    // Sort the groups based on the totalAllocSize field in descending order
+    std::sort(groups.begin(), groups.end(), [](const groupedAllocEntry* a, const groupedAllocEntry* b) {
+        return a->totalAllocSize > b->totalAllocSize;
+    });
+
+    for (const auto& section : restrackReportSections)
+    {
         unsigned long totalLeak = 0;
-        for (const auto& pair : groupedAllocations)
+        unsigned long totalCount = 0;
+
+        for (const auto group : groups)
         {
             std::vector<stackFrame> callStack;
-            for(unsigned int i=0; i<pair.callStackLen; i++)
+            if(group->type != section.type || ResolveCallStack(config, symResolver, *group, callStack) == false)
             {
-                //
-                // Now we get the symbol information for the allocation call stacks that are outstanding.
-                //
-                if(pair.stackTrace[i] > 0)
-                {
-                    bcc_symbol sym;
-                    bcc_symcache_resolve(symResolver, pair.stackTrace[i], &sym);
+                continue;
+            }
 
-                    stackFrame frame = {};
-                    frame.offset = sym.offset;
-                    if(sym.name != NULL)
-                    {
-                        frame.symbolName = sym.name;
-                    }
+            if(totalCount == 0)
+            {
+                file << "=== " << section.title << " ===\n\n";
+            }
 
-                    if(sym.demangle_name != NULL)
-                    {
-                        frame.demangledSymbolName = sym.demangle_name;
-                    }
+            totalLeak += group->totalAllocSize;
+            totalCount += group->allocCount;
 
-                    frame.pc = pair.stackTrace[i];
+            if(section.type == RESTRACK_ALLOC)
+            {
+                file << "+++ Leaked Allocation [allocation size: 0x" << std::hex << group->allocSize << " count:0x" << std::hex << group->allocCount << " total size:0x" << std::hex << group->totalAllocSize;
+            }
+            else
+            {
+                file << "+++ Leaked " << section.title << " [count:0x" << std::hex << group->allocCount;
+            }
 
-                    int len = snprintf(NULL, 0, "\t[0x%llx] %s+0x%lx\n", pair.stackTrace[i], frame.demangledSymbolName.c_str(), frame.offset);
-                    frame.fullName = (char*) malloc(len+1);
-                    snprintf(frame.fullName, len, "\t[0x%llx] %s+0x%lx\n", pair.stackTrace[i], frame.demangledSymbolName.c_str(), frame.offset);
+            WriteAgeHistogram(file, *group);
+            file << "]\n";
 
-                    callStack.push_back(frame);
-                }
+            WriteCallStack(file, callStack);
+        }
+
+        if(totalCount > 0)
+        {
+            if(section.type == RESTRACK_ALLOC)
+            {
+                file << "\nTotal leaked: 0x" << std::hex << totalLeak << "\n\n";
             }
+            else
+            {
+                file << "\nTotal leaked " << section.title << ": 0x" << std::hex << totalCount << "\n\n";
+            }
+        }
+    }
+}
 
-            //
-            // If the stack contains an ignore frame, don't print it
-            //
-            bool found = false;
-            if(config->ExcludeFilter != NULL)
+// ------------------------------------------------------------------------------------------
+// WriteDifferentialReport
+//
+// Writes the change in outstanding resources since the previous snapshot. Only the groups
+// that changed are symbolized. New and grown groups come first, sorted by growth.
+// ------------------------------------------------------------------------------------------
+static void WriteDifferentialReport(std::ofstream& file, ProcDumpConfiguration* config, void* symResolver, const std::unordered_map<std::string, groupedAllocEntry>& previous, const std::unordered_map<std::string, groupedAllocEntry>& current, uint64_t elapsedMs)
+{
+    typedef struct {
+        const groupedAllocEntry* group;     // current group, or previous one if it's gone
+        bool bNew;
+        bool bGone;
+        long deltaCount;
+        long deltaSize;
+        long growth;                        // bytes for memory, count for the other types
+    } groupDelta;
+
+    std::vector<groupDelta> deltas;
+    groupedAllocEntry empty = {};
+
+    for (const auto& pair : current)
+    {
+        auto it = previous.find(pair.first);
+        const groupedAllocEntry& before = it != previous.end() ? it->second : empty;
+
+        groupDelta delta = {};
+        delta.group = &pair.second;
+        delta.bNew = it == previous.end();
+        delta.deltaCount = (long) pair.second.allocCount - (long) before.allocCount;
+        delta.deltaSize = (long) pair.second.totalAllocSize - (long) before.totalAllocSize;
+        delta.growth = pair.second.type == RESTRACK_ALLOC ? delta.deltaSize : delta.deltaCount;
+
+        if(delta.deltaCount != 0 || delta.deltaSize != 0)
+        {
+            deltas.push_back(delta);
+        }
+    }
+
+    for (const auto& pair : previous)
+    {
+        if(current.find(pair.first) == current.end())
+        {
+            groupDelta delta = {};
+            delta.group = &pair.second;
+            delta.bGone = true;
+            delta.deltaCount = -(long) pair.second.allocCount;
+            delta.deltaSize = -(long) pair.second.totalAllocSize;
+            delta.growth = pair.second.type == RESTRACK_ALLOC ? delta.deltaSize : delta.deltaCount;
+            deltas.push_back(delta);
+        }
+    }
+
+    std::sort(deltas.begin(), deltas.end(), [](const groupDelta& a, const groupDelta& b) {
+        return a.growth > b.growth;
+    });
+
+    file << "Differential report, changes since the previous snapshot (" << std::dec << elapsedMs / 1000 << " seconds ago).\n\n";
+
+    if(deltas.empty())
+    {
+        file << "No changes detected.\n";
+        return;
+    }
+
+    for (const auto& section : restrackReportSections)
+    {
+        long totalGrowth = 0;
+        bool bHeader = false;
+
+        for (const auto& delta : deltas)
+        {
+            std::vector<stackFrame> callStack;
+            if(delta.group->type != section.type || ResolveCallStack(config, symResolver, *delta.group, callStack) == false)
             {
-                for (const auto& st : callStack)
-                {
-                    if(WildcardSearch(st.fullName, config->ExcludeFilter) == true)
-                    {
-                        found = true;
-                        break;
-                    }
-                }
+                continue;
             }
 
-            if(found == false)
+            if(bHeader == false)
             {
-                totalLeak += pair.totalAllocSize;
+                file << "=== " << section.title << " ===\n\n";
+                bHeader = true;
+            }
 
-                file << "+++ Leaked Allocation [allocation size: 0x" << std::hex << pair.allocSize << " count:0x" << std::hex << pair.allocCount << " total size:0x" << std::hex << pair.totalAllocSize << "]\n";
+            totalGrowth += delta.growth;
 
-                for (const auto& st : callStack)
-                {
-                    if(st.demangledSymbolName.length() > 0)
-                    {
-                        file << "\t[0x" << std::hex << st.pc << "] " << st.demangledSymbolName.c_str() << "+0x" << std::hex << st.offset << "\n";
-                    }
-                    else
-                    {
-                        file << "\t[0x" << std::hex << st.pc << "]\n";
-                    }
-                }
+            const char* change = delta.bNew ? "+++ New" : (delta.growth > 0 ? "+++ Grown" : "--- Shrunk");
+            unsigned long count = delta.bGone ? 0 : delta.group->allocCount;
+            unsigned long totalSize = delta.bGone ? 0 : delta.group->totalAllocSize;
+
+            if(section.type == RESTRACK_ALLOC)
+            {
+                file << change << " Allocation [allocation size: 0x" << std::hex << delta.group->allocSize << " count:0x" << std::hex << count << " (";
+                WriteSignedHex(file, delta.deltaCount);
+                file << ") total size:0x" << std::hex << totalSize << " (";
+                WriteSignedHex(file, delta.deltaSize);
+                file << ")";
+            }
+            else
+            {
+                file << change << " " << section.title << " [count:0x" << std::hex << count << " (";
+                WriteSignedHex(file, delta.deltaCount);
+                file << ")";
+            }
 
-                file << "\n";
+            if(elapsedMs > 0)
+            {
+                file << " rate:";
+                WriteSignedHex(file, (long) (delta.growth * 1000 / (long) elapsedMs));
+                file << (section.type == RESTRACK_ALLOC ? " bytes/s" : "/s");
+            }
+
+            if(delta.bGone == false)
+            {
+                WriteAgeHistogram(file, *delta.group);
             }
+
+            file << "]\n";
+
+            WriteCallStack(file, callStack);
+        }
+
+        if(bHeader == true)
+        {
+            file << "\nTotal growth: ";
+            WriteSignedHex(file, totalGrowth);
+            file << "\n\n";
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// WriteChurnReport
+//
+// Writes the call stacks that allocated the most during the window (churn mode), with their
+// allocation and byte rates.
+// ------------------------------------------------------------------------------------------
+static void WriteChurnReport(std::ofstream& file, ProcDumpConfiguration* config, void* symResolver, std::vector<const groupedAllocEntry*>& groups, uint64_t elapsedMs)
+{
+    unsigned long totalCount = 0;
+    unsigned long totalSize = 0;
+    unsigned int written = 0;
+    double seconds = elapsedMs > 0 ? elapsedMs / 1000.0 : 1.0;
+
+    std::sort(groups.begin(), groups.end(), [](const groupedAllocEntry* a, const groupedAllocEntry* b) {
+        return a->allocCount > b->allocCount;
+    });
+
+    for (const auto group : groups)
+    {
+        totalCount += group->allocCount;
+        totalSize += group->totalAllocSize;
+    }
+
+    file << "=== " << GetRestrackSectionTitle(RESTRACK_ALLOC_CHURN) << " ===\n\n";
+    file << "Window: " << std::dec << elapsedMs / 1000 << "s";
+    if(config->SampleRate > 1)
+    {
+        file << " (1 in " << std::dec << config->SampleRate << " allocations sampled)";
+    }
+    file << "\n\n";
+
+    for (const auto group : groups)
+    {
+        if(written == RESTRACK_CHURN_TOP)
+        {
+            break;
+        }
+
+        std::vector<stackFrame> callStack;
+        if(ResolveCallStack(config, symResolver, *group, callStack) == false)
+        {
+            continue;
+        }
+
+        file << "+++ Allocations [count:0x" << std::hex << group->allocCount << " (" << std::dec << (unsigned long) (group->allocCount / seconds) << "/s)";
+        file << " total size:0x" << std::hex << group->totalAllocSize << " (" << std::dec << (unsigned long) (group->totalAllocSize / seconds) << " bytes/s)]\n";
+
+        WriteCallStack(file, callStack);
+        written++;
+    }
+
+    file << "\nTotal allocations: 0x" << std::hex << totalCount << " (" << std::dec << (unsigned long) (totalCount / seconds) << "/s)";
+    file << " total size: 0x" << std::hex << totalSize << " (" << std::dec << (unsigned long) (totalSize / seconds) << " bytes/s)\n\n";
+}
+
+// ------------------------------------------------------------------------------------------
+// WriteSamplingNote
+//
+// Notes in the report that the maximum number of tracked resources (-rc) was reached, the
+// counts of the report are estimates scaled by the sampling weight from then on.
+// ------------------------------------------------------------------------------------------
+static void WriteSamplingNote(std::ofstream& file, ProcDumpConfiguration* config)
+{
+    pthread_mutex_lock(&config->memAllocMapMutex);
+    unsigned int shift = config->restrackSamplingShift;
+    uint64_t dropped = config->restrackDroppedCount;
+    uint64_t evicted = config->restrackEvictedCount;
+    pthread_mutex_unlock(&config->memAllocMapMutex);
+
+    if(shift == 0)
+    {
+        return;
+    }
+
+    file << "Maximum number of tracked resources reached, 1 in " << std::dec << (1ULL << shift) << " resources sampled. Counts and sizes are scaled accordingly.\n";
+    if(dropped > 0 || evicted > 0)
+    {
+        file << "Resources not tracked: " << std::dec << dropped << " not sampled, " << evicted << " evicted when the sampling rate was lowered.\n";
+    }
+    file << "\n";
+}
+
+// ------------------------------------------------------------------------------------------
+// WriteRestrackReport
+//
+// Writes a report of the grouped resources in the configured format (-rf). If the previous
+// groups are specified, the text report only contains the changes since then. If the
+// mappings are not specified, the current mappings of the target are used.
+// ------------------------------------------------------------------------------------------
+bool WriteRestrackReport(ProcDumpConfiguration* config, const char* filename, void* symResolver, const std::unordered_map<std::string, groupedAllocEntry>& groups, const std::unordered_map<std::string, groupedAllocEntry>* previousGroups, uint64_t elapsedMs, const std::vector<RestrackCaptureMapping>* mappings)
+{
+    std::vector<const groupedAllocEntry*> sortedGroups;
+    sortedGroups.reserve(groups.size());
+    for (const auto& pair : groups)
+    {
+        sortedGroups.push_back(&pair.second);
+    }
+
+    if(config->RestrackFormat == RestrackFormatPprof)
+    {
+        //
+        // The machine readable formats always contain the full snapshot, the tools that consume
+        // them (for example, pprof -diff_base) compute differences themselves.
+        //
+        if(mappings != NULL)
+        {
+            return WriteRestrackPprof(filename, config, symResolver, sortedGroups, *mappings);
         }
 
-        file << "\nTotal leaked: 0x" << std::hex << totalLeak << "\n";
+        std::vector<RestrackCaptureMapping> currentMappings;
+        GetRestrackMappings(config->ProcessId, currentMappings);
+        return WriteRestrackPprof(filename, config, symResolver, sortedGroups, currentMappings);
+    }
+    else if(config->RestrackFormat == RestrackFormatFolded)
+    {
+        return WriteRestrackFolded(filename, config, symResolver, sortedGroups);
+    }
+
+    std::ofstream file(filename);
+    if (!file)
+    {
+        Trace("WriteRestrackReport: Failed to open file: %s", filename);
+        return false;
+    }
+
+    if(config->bRestrackChurn == false)
+    {
+        WriteSamplingNote(file, config);
+    }
+
+    if(config->bRestrackChurn == true)
+    {
+        WriteChurnReport(file, config, symResolver, sortedGroups, elapsedMs);
+    }
+    else if(previousGroups != NULL)
+    {
+        WriteDifferentialReport(file, config, symResolver, *previousGroups, groups, elapsedMs);
+    }
+    else if(sortedGroups.size() > 0)
+    {
+        WriteLeakReport(file, config, symResolver, sortedGroups);
     }
     else
     {
         file << "No leaks detected.\n";
     }
 
-    Log(info, "Leak report generated: %s", filename);
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// ReportLeaks
+//
+// Reports on leaks. If differential reports are enabled (-restrack diff), every report after
+// the first one only contains the changes since the previous report. Raw captures (-rf raw)
+// are written without symbolizing, they are turned into reports with -restrack-report.
+// ------------------------------------------------------------------------------------------
+void* ReportLeaks(void* args)
+{
+    Trace("ReportLeaks:Enter");
+    leakThreadArgs* leakArgs = (leakThreadArgs*) args;
+    ProcDumpConfiguration* config = leakArgs->config;
+    const char* filename = leakArgs->filename;
+    bool ret = false;
+
+    config->bLeakReportInProgress = true;
+
+    if(config->RestrackFormat == RestrackFormatRaw)
+    {
+        //
+        // Only the live table is copied while holding the lock, the mappings and build ids
+        // are read afterwards.
+        //
+        RestrackCapture capture;
+
+        pthread_mutex_lock(&config->memAllocMapMutex);
+        CaptureResources(config, capture);
+        pthread_mutex_unlock(&config->memAllocMapMutex);
+
+        ret = WriteRestrackCapture(filename, config, capture);
+    }
+    else
+    {
+        std::unordered_map<std::string, groupedAllocEntry> groups;
+        std::unordered_map<std::string, groupedAllocEntry> previousGroups;
+        bool bHavePrevious = false;
+        uint64_t elapsedMs = 0;
+        struct timespec now = {};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t nowNs = now.tv_sec * 1000000000ULL + now.tv_nsec;
+        uint64_t nowMs = nowNs / 1000000;
+
+        //
+        // In churn mode the allocations were counted in-kernel since the previous report. The
+        // maps are read before taking memAllocMapMutex, RestrackRemoveTarget holds the engine
+        // lock while waiting for the polling thread which takes memAllocMapMutex.
+        //
+        if(config->bRestrackChurn == true)
+        {
+            CollectChurn(config, groups);
+            elapsedMs = nowMs - config->restrackChurnWindowStart;
+            config->restrackChurnWindowStart = nowMs;
+        }
+
+        //
+        // Group the call stacks. Since its a snapshot, we only hold the lock while grouping.
+        //
+        pthread_mutex_lock(&config->memAllocMapMutex);
+
+        if(config->bRestrackChurn == false)
+        {
+            GroupResources(config, nowNs, groups);
+        }
+
+        if(config->bRestrackDiff == true)
+        {
+            bHavePrevious = config->restrackPreviousSnapshotTime != 0;
+            elapsedMs = nowMs - config->restrackPreviousSnapshotTime;
+            previousGroups.swap(config->restrackPreviousGroups);
+            config->restrackPreviousGroups = groups;
+            config->restrackPreviousSnapshotTime = nowMs;
+        }
+
+        pthread_mutex_unlock(&config->memAllocMapMutex);
+
+        void* symResolver = bcc_symcache_new(config->ProcessId, NULL);
+        ret = WriteRestrackReport(config, filename, symResolver, groups, bHavePrevious ? &previousGroups : NULL, elapsedMs, NULL);
+        bcc_free_symcache(symResolver, config->ProcessId);
+    }
+
+    if(ret == true)
+    {
+        Log(info, "Leak report generated: %s", filename);
+    }
+    else
+    {
+        Log(error, "Failed to write leak report: %s", filename);
+    }
 
     free(const_cast<char*>(leakArgs->filename));
     free(leakArgs);
@@ -569,7 +2016,19 @@ pthread_t WriteRestrackSnapshot(ProcDumpConfiguration* config, ECoreDumpType typ
     //
     char* dumpFileName = GetCoreDumpName(config, type);
     std::unique_ptr<char[]> owndumpFileName(dumpFileName);
-    std::string filename = (std::string(dumpFileName) + ".restrack");
+    std::string filename = std::string(dumpFileName) + ".restrack";
+    if(config->RestrackFormat == RestrackFormatPprof)
+    {
+        filename += ".pb.gz";
+    }
+    else if(config->RestrackFormat == RestrackFormatFolded)
+    {
+        filename += ".folded";
+    }
+    else if(config->RestrackFormat == RestrackFormatRaw)
+    {
+        filename += ".raw";
+    }
 
     //
     // Create a thread to write the snapshot to avoid delays in the calling thread.
@@ -0,0 +1,407 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// RestrackCapture.cpp
+//
+// Raw restrack captures (-rf raw). A capture contains the live resource
+// table, the interned call stacks and the executable mappings (with
+// build ids) of the target. Nothing is symbolized at capture time, the
+// capture is turned into a report later with -restrack-report, possibly
+// on another machine.
+//
+//--------------------------------------------------------------------
+
+#include "Includes.h"
+
+#include "bcc_elf.h"
+#include "bcc_proc.h"
+#include "bcc_syms.h"
+
+#include <unordered_set>
+
+#define RESTRACK_CAPTURE_BUFFER_SIZE    (1024 * 1024)
+#define RESTRACK_MAX_BUILD_ID           256
+
+typedef struct {
+    pid_t pid;
+    std::vector<RestrackCaptureMapping>* mappings;
+} captureMappingsPayload;
+
+// ------------------------------------------------------------------------------------------
+// CaptureMappingCallback
+//
+// Collects the executable mappings of the target along with the build ids of the files.
+// ------------------------------------------------------------------------------------------
+static int CaptureMappingCallback(mod_info* mod, int enterNs, void* payload)
+{
+    captureMappingsPayload* mappingsPayload = (captureMappingsPayload*) payload;
+
+    RestrackCaptureMapping mapping;
+    mapping.start = mod->start_addr;
+    mapping.end = mod->end_addr;
+    mapping.fileOffset = mod->file_offset;
+    mapping.path = mod->name;
+
+    //
+    // The build id is the same for all the mappings of a file
+    //
+    if(mappingsPayload->mappings->empty() == false && mappingsPayload->mappings->back().path == mapping.path)
+    {
+        mapping.buildId = mappingsPayload->mappings->back().buildId;
+    }
+    else if(mapping.path.length() > 0 && mapping.path[0] == '/')
+    {
+        char buildId[RESTRACK_MAX_BUILD_ID] = {};
+        std::string path = mapping.path;
+        if(enterNs)
+        {
+            path = "/proc/" + std::to_string(mappingsPayload->pid) + "/root" + mapping.path;
+        }
+
+        if(bcc_elf_get_buildid(path.c_str(), buildId) == 0)
+        {
+            mapping.buildId = buildId;
+        }
+    }
+
+    mappingsPayload->mappings->push_back(mapping);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// GetRestrackMappings
+//
+// Gets the executable mappings of the specified process.
+// ------------------------------------------------------------------------------------------
+void GetRestrackMappings(pid_t pid, std::vector<RestrackCaptureMapping>& mappings)
+{
+    captureMappingsPayload payload = { pid, &mappings };
+    bcc_procutils_each_module(pid, CaptureMappingCallback, &payload);
+}
+
+// ------------------------------------------------------------------------------------------
+// CaptureResources
+//
+// Copies the live resource table of the target, interning the call stacks. Must be called
+// with memAllocMapMutex held.
+// ------------------------------------------------------------------------------------------
+void CaptureResources(ProcDumpConfiguration* config, RestrackCapture& capture)
+{
+    std::unordered_map<std::string, uint32_t> stackIndexes;
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    memset(&capture.header, 0, sizeof(RestrackCaptureHeader));
+    memcpy(capture.header.magic, RESTRACK_CAPTURE_MAGIC, sizeof(capture.header.magic));
+    capture.header.version = RESTRACK_CAPTURE_VERSION;
+    capture.header.pid = config->ProcessId;
+    capture.header.captureTime = now.tv_sec * 1000000000ULL + now.tv_nsec;
+    capture.header.sampleRate = config->SampleRate;
+    capture.header.samplingShift = config->restrackSamplingShift;
+
+    capture.stackOffsets.push_back(0);
+    capture.resources.reserve(config->memAllocMap.size());
+
+    for (const auto& pair : config->memAllocMap)
+    {
+        ResourceInformation* resource = pair.second;
+        unsigned int callStackLen = resource->callStackLen < 0 ? 0 : resource->callStackLen;
+        if(callStackLen > MAX_CALL_STACK_FRAMES)
+        {
+            callStackLen = MAX_CALL_STACK_FRAMES;
+        }
+
+        std::string key((const char*) resource->stackTrace, callStackLen * sizeof(__u64));
+        uint32_t stackIndex = 0;
+
+        auto it = stackIndexes.find(key);
+        if(it != stackIndexes.end())
+        {
+            stackIndex = it->second;
+        }
+        else
+        {
+            stackIndex = capture.stackOffsets.size() - 1;
+            stackIndexes[key] = stackIndex;
+            capture.stackFrames.insert(capture.stackFrames.end(), resource->stackTrace, resource->stackTrace + callStackLen);
+            capture.stackOffsets.push_back(capture.stackFrames.size());
+        }
+
+        RestrackCaptureResource captured = {};
+        captured.resource = pair.first;
+        captured.size = resource->allocSize;
+        captured.timestamp = resource->timestamp;
+        captured.type = resource->resourceType;
+        captured.stackIndex = stackIndex;
+        capture.resources.push_back(captured);
+    }
+
+    capture.header.stackCount = capture.stackOffsets.size() - 1;
+    capture.header.resourceCount = capture.resources.size();
+}
+
+// ------------------------------------------------------------------------------------------
+// WriteRestrackCapture
+//
+// Writes a capture taken with CaptureResources along with the current mappings of the
+// target.
+// ------------------------------------------------------------------------------------------
+bool WriteRestrackCapture(const char* filename, ProcDumpConfiguration* config, RestrackCapture& capture)
+{
+    GetRestrackMappings(config->ProcessId, capture.mappings);
+    capture.header.moduleCount = capture.mappings.size();
+
+    FILE* file = fopen(filename, "w");
+    if(file == NULL)
+    {
+        Trace("WriteRestrackCapture: Failed to open file: %s", filename);
+        return false;
+    }
+
+    auto_free char* buffer = (char*) malloc(RESTRACK_CAPTURE_BUFFER_SIZE);
+    if(buffer != NULL)
+    {
+        setvbuf(file, buffer, _IOFBF, RESTRACK_CAPTURE_BUFFER_SIZE);
+    }
+
+    fwrite(&capture.header, sizeof(RestrackCaptureHeader), 1, file);
+
+    for (const auto& mapping : capture.mappings)
+    {
+        RestrackCaptureModule module = {};
+        module.start = mapping.start;
+        module.end = mapping.end;
+        module.fileOffset = mapping.fileOffset;
+        module.pathLength = mapping.path.length();
+        module.buildIdLength = mapping.buildId.length();
+
+        fwrite(&module, sizeof(RestrackCaptureModule), 1, file);
+        fwrite(mapping.path.data(), 1, module.pathLength, file);
+        fwrite(mapping.buildId.data(), 1, module.buildIdLength, file);
+    }
+
+    for (uint32_t i = 0; i < capture.header.stackCount; i++)
+    {
+        uint32_t frameCount = capture.stackOffsets[i + 1] - capture.stackOffsets[i];
+        fwrite(&frameCount, sizeof(uint32_t), 1, file);
+        fwrite(capture.stackFrames.data() + capture.stackOffsets[i], sizeof(unsigned long long), frameCount, file);
+    }
+
+    fwrite(capture.resources.data(), sizeof(RestrackCaptureResource), capture.resources.size(), file);
+
+    bool ret = ferror(file) == 0;
+    if(fclose(file) != 0)
+    {
+        ret = false;
+    }
+
+    return ret;
+}
+
+// ------------------------------------------------------------------------------------------
+// ReadRestrackCapture
+// ------------------------------------------------------------------------------------------
+bool ReadRestrackCapture(const char* filename, RestrackCapture& capture)
+{
+    FILE* file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        Trace("ReadRestrackCapture: Failed to open file: %s", filename);
+        return false;
+    }
+
+    bool ret = false;
+
+    if(fread(&capture.header, sizeof(RestrackCaptureHeader), 1, file) != 1 ||
+        memcmp(capture.header.magic, RESTRACK_CAPTURE_MAGIC, sizeof(capture.header.magic)) != 0 ||
+        capture.header.version != RESTRACK_CAPTURE_VERSION ||
+        capture.header.samplingShift >= RESTRACK_MAX_SAMPLING_SHIFT)
+    {
+        Trace("ReadRestrackCapture: Invalid capture header.");
+        goto Exit;
+    }
+
+    for (uint32_t i = 0; i < capture.header.moduleCount; i++)
+    {
+        RestrackCaptureModule module = {};
+        if(fread(&module, sizeof(RestrackCaptureModule), 1, file) != 1 || module.pathLength > PATH_MAX || module.buildIdLength > RESTRACK_MAX_BUILD_ID)
+        {
+            Trace("ReadRestrackCapture: Invalid module.");
+            goto Exit;
+        }
+
+        RestrackCaptureMapping mapping;
+        mapping.start = module.start;
+        mapping.end = module.end;
+        mapping.fileOffset = module.fileOffset;
+        mapping.path.resize(module.pathLength);
+        mapping.buildId.resize(module.buildIdLength);
+
+        if(fread(&mapping.path[0], 1, module.pathLength, file) != module.pathLength ||
+            fread(&mapping.buildId[0], 1, module.buildIdLength, file) != module.buildIdLength)
+        {
+            Trace("ReadRestrackCapture: Invalid module.");
+            goto Exit;
+        }
+
+        capture.mappings.push_back(mapping);
+    }
+
+    capture.stackOffsets.push_back(0);
+    for (uint32_t i = 0; i < capture.header.stackCount; i++)
+    {
+        uint32_t frameCount = 0;
+        if(fread(&frameCount, sizeof(uint32_t), 1, file) != 1 || frameCount > MAX_CALL_STACK_FRAMES)
+        {
+            Trace("ReadRestrackCapture: Invalid call stack.");
+            goto Exit;
+        }
+
+        size_t offset = capture.stackFrames.size();
+        capture.stackFrames.resize(offset + frameCount);
+        if(fread(capture.stackFrames.data() + offset, sizeof(unsigned long long), frameCount, file) != frameCount)
+        {
+            Trace("ReadRestrackCapture: Invalid call stack.");
+            goto Exit;
+        }
+
+        capture.stackOffsets.push_back(capture.stackFrames.size());
+    }
+
+    for (uint64_t i = 0; i < capture.header.resourceCount; i++)
+    {
+        RestrackCaptureResource resource = {};
+        if(fread(&resource, sizeof(RestrackCaptureResource), 1, file) != 1 || resource.stackIndex >= capture.header.stackCount)
+        {
+            Trace("ReadRestrackCapture: Invalid resource.");
+            goto Exit;
+        }
+
+        capture.resources.push_back(resource);
+    }
+
+    ret = true;
+
+Exit:
+    fclose(file);
+    return ret;
+}
+
+// ------------------------------------------------------------------------------------------
+// GetOfflineReportName
+//
+// Returns the name of the report generated from a capture. The '.raw' extension of the
+// capture is replaced by the extension of the report format.
+// ------------------------------------------------------------------------------------------
+static std::string GetOfflineReportName(ProcDumpConfiguration* config)
+{
+    std::string filename = config->RestrackReportFile;
+    const std::string rawExtension = ".raw";
+
+    if(filename.length() > rawExtension.length() && filename.compare(filename.length() - rawExtension.length(), rawExtension.length(), rawExtension) == 0)
+    {
+        filename.erase(filename.length() - rawExtension.length());
+    }
+    else
+    {
+        filename += ".report";
+    }
+
+    if(config->RestrackFormat == RestrackFormatPprof)
+    {
+        filename += ".pb.gz";
+    }
+    else if(config->RestrackFormat == RestrackFormatFolded)
+    {
+        filename += ".folded";
+    }
+
+    return filename;
+}
+
+// ------------------------------------------------------------------------------------------
+// RestrackOfflineReport
+//
+// Generates a report (-rf) from a raw capture (-restrack-report). The modules are
+// symbolized from the files at the paths recorded in the capture, modules whose build id
+// does not match the capture are not symbolized.
+// ------------------------------------------------------------------------------------------
+int RestrackOfflineReport(ProcDumpConfiguration* config)
+{
+    RestrackCapture capture;
+    if(ReadRestrackCapture(config->RestrackReportFile, capture) == false)
+    {
+        Log(error, "Failed to read restrack capture: %s", config->RestrackReportFile);
+        return -1;
+    }
+
+    //
+    // Group the resources, the minimum age (-ra) is relative to the time of the capture
+    //
+    std::unordered_map<std::string, groupedAllocEntry> groups;
+    uint64_t minAgeNs = (uint64_t) config->RestrackMinAge * 1000000000ULL;
+
+    for (const auto& resource : capture.resources)
+    {
+        uint64_t ageNs = capture.header.captureTime > resource.timestamp ? capture.header.captureTime - resource.timestamp : 0;
+        if(ageNs < minAgeNs)
+        {
+            continue;
+        }
+
+        uint32_t offset = capture.stackOffsets[resource.stackIndex];
+        GroupResource(groups, resource.type, resource.size, ageNs, capture.stackOffsets[resource.stackIndex + 1] - offset, capture.stackFrames.data() + offset, 1ULL << capture.header.samplingShift);
+    }
+
+    //
+    // Only use the modules that match the build ids of the capture
+    //
+    std::vector<mod_info> modules;
+    std::unordered_set<std::string> mismatched;
+
+    for (const auto& mapping : capture.mappings)
+    {
+        if(mapping.buildId.length() > 0 && mismatched.find(mapping.path) == mismatched.end())
+        {
+            char buildId[RESTRACK_MAX_BUILD_ID] = {};
+            if(bcc_elf_get_buildid(mapping.path.c_str(), buildId) != 0 || mapping.buildId != buildId)
+            {
+                Log(warn, "%s does not match the build id of the capture and will not be symbolized.", mapping.path.c_str());
+                mismatched.insert(mapping.path);
+            }
+        }
+
+        if(mismatched.find(mapping.path) != mismatched.end())
+        {
+            continue;
+        }
+
+        mod_info module = {};
+        module.name = const_cast<char*>(mapping.path.c_str());
+        module.start_addr = mapping.start;
+        module.end_addr = mapping.end;
+        module.file_offset = mapping.fileOffset;
+        modules.push_back(module);
+    }
+
+    config->ProcessId = capture.header.pid;
+    config->SampleRate = capture.header.sampleRate;
+    config->restrackSamplingShift = capture.header.samplingShift;
+    InitRestrackSymbolCache();
+    std::string filename = GetOfflineReportName(config);
+
+    void* symResolver = bcc_symcache_new_from_modules(modules.data(), modules.size(), NULL);
+    bool ret = WriteRestrackReport(config, filename.c_str(), symResolver, groups, NULL, 0, &capture.mappings);
+    bcc_free_symcache(symResolver, 0);
+
+    if(ret == false)
+    {
+        Log(error, "Failed to write leak report: %s", filename.c_str());
+        return -1;
+    }
+
+    Log(info, "Leak report generated: %s", filename.c_str());
+    return 0;
+}
@@ -0,0 +1,569 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License
+
+//--------------------------------------------------------------------
+//
+// RestrackOutput.cpp
+//
+// Machine readable restrack report formats:
+//
+// pprof  - gzip'ed protobuf (https://github.com/google/pprof/blob/main/proto/profile.proto)
+//          with the mapping, location, function and string tables deduplicated.
+// folded - one line per call stack, frames separated by ';' (root first) followed by the
+//          value. Can be consumed directly by flamegraph.pl and similar tools.
+//
+//--------------------------------------------------------------------
+
+#include "Includes.h"
+
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#define RESTRACK_WRITE_BUFFER_SIZE  (256 * 1024)
+
+//
+// pprof profile.proto field numbers
+//
+#define PPROF_PROFILE_SAMPLE_TYPE           1
+#define PPROF_PROFILE_SAMPLE                2
+#define PPROF_PROFILE_MAPPING               3
+#define PPROF_PROFILE_LOCATION              4
+#define PPROF_PROFILE_FUNCTION              5
+#define PPROF_PROFILE_STRING_TABLE          6
+#define PPROF_PROFILE_TIME_NANOS            9
+#define PPROF_PROFILE_PERIOD_TYPE           11
+#define PPROF_PROFILE_PERIOD                12
+#define PPROF_PROFILE_DEFAULT_SAMPLE_TYPE   14
+
+#define PPROF_VALUETYPE_TYPE                1
+#define PPROF_VALUETYPE_UNIT                2
+
+#define PPROF_SAMPLE_LOCATION_ID            1
+#define PPROF_SAMPLE_VALUE                  2
+#define PPROF_SAMPLE_LABEL                  3
+
+#define PPROF_LABEL_KEY                     1
+#define PPROF_LABEL_STR                     2
+
+#define PPROF_MAPPING_ID                    1
+#define PPROF_MAPPING_MEMORY_START          2
+#define PPROF_MAPPING_MEMORY_LIMIT          3
+#define PPROF_MAPPING_FILE_OFFSET           4
+#define PPROF_MAPPING_FILENAME              5
+#define PPROF_MAPPING_BUILD_ID              6
+#define PPROF_MAPPING_HAS_FUNCTIONS         7
+
+#define PPROF_LOCATION_ID                   1
+#define PPROF_LOCATION_MAPPING_ID           2
+#define PPROF_LOCATION_ADDRESS              3
+#define PPROF_LOCATION_LINE                 4
+
+#define PPROF_LINE_FUNCTION_ID              1
+
+#define PPROF_FUNCTION_ID                   1
+#define PPROF_FUNCTION_NAME                 2
+#define PPROF_FUNCTION_SYSTEM_NAME          3
+#define PPROF_FUNCTION_FILENAME             4
+
+#define PROTOBUF_WIRE_VARINT                0
+#define PROTOBUF_WIRE_LENGTH                2
+
+//
+// Buffered writer to a plain or gzip'ed file
+//
+typedef struct {
+    FILE* file;
+    gzFile compressedFile;
+    char* buffer;
+    size_t used;
+    bool bError;
+} restrackWriter;
+
+typedef struct {
+    const RestrackCaptureMapping* mapping;
+    uint64_t id;
+} pprofMapping;
+
+// ------------------------------------------------------------------------------------------
+// WriterOpen
+// ------------------------------------------------------------------------------------------
+static bool WriterOpen(restrackWriter* writer, const char* filename, bool bCompress)
+{
+    memset(writer, 0, sizeof(restrackWriter));
+
+    writer->buffer = (char*) malloc(RESTRACK_WRITE_BUFFER_SIZE);
+    if(writer->buffer == NULL)
+    {
+        return false;
+    }
+
+    if(bCompress)
+    {
+        writer->compressedFile = gzopen(filename, "wb");
+    }
+    else
+    {
+        writer->file = fopen(filename, "w");
+    }
+
+    if(writer->compressedFile == NULL && writer->file == NULL)
+    {
+        Trace("WriterOpen: Failed to open file: %s", filename);
+        free(writer->buffer);
+        writer->buffer = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// WriterFlush
+// ------------------------------------------------------------------------------------------
+static void WriterFlush(restrackWriter* writer)
+{
+    if(writer->used == 0 || writer->bError)
+    {
+        writer->used = 0;
+        return;
+    }
+
+    if(writer->compressedFile != NULL)
+    {
+        if(gzwrite(writer->compressedFile, writer->buffer, writer->used) != (int) writer->used)
+        {
+            writer->bError = true;
+        }
+    }
+    else if(fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used)
+    {
+        writer->bError = true;
+    }
+
+    writer->used = 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// WriterWrite
+// ------------------------------------------------------------------------------------------
+static void WriterWrite(restrackWriter* writer, const char* data, size_t len)
+{
+    while(len > 0)
+    {
+        if(writer->used == RESTRACK_WRITE_BUFFER_SIZE)
+        {
+            WriterFlush(writer);
+        }
+
+        size_t chunk = std::min(len, (size_t) (RESTRACK_WRITE_BUFFER_SIZE - writer->used));
+        memcpy(writer->buffer + writer->used, data, chunk);
+        writer->used += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// WriterWriteString
+// ------------------------------------------------------------------------------------------
+static void WriterWriteString(restrackWriter* writer, const std::string& str)
+{
+    WriterWrite(writer, str.data(), str.size());
+}
+
+// ------------------------------------------------------------------------------------------
+// WriterWriteDecimal
+// ------------------------------------------------------------------------------------------
+static void WriterWriteDecimal(restrackWriter* writer, uint64_t value)
+{
+    char digits[21];
+    int pos = sizeof(digits);
+
+    do
+    {
+        digits[--pos] = '0' + (value % 10);
+        value /= 10;
+    } while(value != 0);
+
+    WriterWrite(writer, digits + pos, sizeof(digits) - pos);
+}
+
+// ------------------------------------------------------------------------------------------
+// WriterClose
+//
+// Flushes and closes the writer. Returns false if any write failed.
+// ------------------------------------------------------------------------------------------
+static bool WriterClose(restrackWriter* writer)
+{
+    WriterFlush(writer);
+
+    if(writer->compressedFile != NULL && gzclose(writer->compressedFile) != Z_OK)
+    {
+        writer->bError = true;
+    }
+
+    if(writer->file != NULL && fclose(writer->file) != 0)
+    {
+        writer->bError = true;
+    }
+
+    free(writer->buffer);
+    writer->buffer = NULL;
+
+    return writer->bError == false;
+}
+
+// ------------------------------------------------------------------------------------------
+// GetFrameName
+//
+// Returns the name used for a frame, the demangled symbol if available.
+// ------------------------------------------------------------------------------------------
+static std::string GetFrameName(const stackFrame& frame)
+{
+    if(frame.demangledSymbolName.length() > 0)
+    {
+        return frame.demangledSymbolName;
+    }
+
+    if(frame.symbolName.length() > 0)
+    {
+        return frame.symbolName;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "[0x%llx]", frame.pc);
+    return name;
+}
+
+// ------------------------------------------------------------------------------------------
+// WriteRestrackFolded
+//
+// Writes the grouped call stacks in the folded stack format. The resource type is the root
+// frame, the value is the outstanding bytes for memory and the count for other resources.
+// ------------------------------------------------------------------------------------------
+bool WriteRestrackFolded(const char* filename, ProcDumpConfiguration* config, void* symResolver, std::vector<const groupedAllocEntry*>& groups)
+{
+    restrackWriter writer;
+    if(WriterOpen(&writer, filename, false) == false)
+    {
+        return false;
+    }
+
+    for (const auto group : groups)
+    {
+        std::vector<stackFrame> callStack;
+        if(ResolveCallStack(config, symResolver, *group, callStack) == false)
+        {
+            continue;
+        }
+
+        WriterWriteString(&writer, GetRestrackSectionTitle(group->type));
+
+        //
+        // Call stacks are captured leaf first
+        //
+        for (auto it = callStack.rbegin(); it != callStack.rend(); ++it)
+        {
+            std::string name = GetFrameName(*it);
+            std::replace(name.begin(), name.end(), ';', ':');
+
+            WriterWrite(&writer, ";", 1);
+            WriterWriteString(&writer, name);
+        }
+
+        WriterWrite(&writer, " ", 1);
+        WriterWriteDecimal(&writer, group->type == RESTRACK_ALLOC ? group->totalAllocSize : group->allocCount);
+        WriterWrite(&writer, "\n", 1);
+    }
+
+    return WriterClose(&writer);
+}
+
+// ------------------------------------------------------------------------------------------
+// Protobuf encoding helpers
+// ------------------------------------------------------------------------------------------
+static void PbVarint(std::string& out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back((char) ((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char) value);
+}
+
+static void PbTag(std::string& out, int field, int wireType)
+{
+    PbVarint(out, ((uint64_t) field << 3) | wireType);
+}
+
+static void PbUint(std::string& out, int field, uint64_t value)
+{
+    if(value != 0)
+    {
+        PbTag(out, field, PROTOBUF_WIRE_VARINT);
+        PbVarint(out, value);
+    }
+}
+
+static void PbBytes(std::string& out, int field, const std::string& data)
+{
+    PbTag(out, field, PROTOBUF_WIRE_LENGTH);
+    PbVarint(out, data.size());
+    out.append(data);
+}
+
+static void PbPacked(std::string& out, int field, const std::vector<uint64_t>& values)
+{
+    std::string packed;
+    for (auto value : values)
+    {
+        PbVarint(packed, value);
+    }
+    PbBytes(out, field, packed);
+}
+
+// ------------------------------------------------------------------------------------------
+// pprofStringTable
+//
+// Deduplicated pprof string table, index 0 is always the empty string.
+// ------------------------------------------------------------------------------------------
+class pprofStringTable
+{
+public:
+    pprofStringTable()
+    {
+        Intern("");
+    }
+
+    uint64_t Intern(const std::string& str)
+    {
+        auto it = indexes.find(str);
+        if(it != indexes.end())
+        {
+            return it->second;
+        }
+
+        uint64_t index = strings.size();
+        strings.push_back(str);
+        indexes[str] = index;
+        return index;
+    }
+
+    std::vector<std::string> strings;
+
+private:
+    std::unordered_map<std::string, uint64_t> indexes;
+};
+
+// ------------------------------------------------------------------------------------------
+// WriteRestrackPprof
+//
+// Writes the grouped call stacks as a gzip'ed pprof profile. Every group is a sample with
+// the outstanding count and bytes (allocated count and bytes for churn) and a 'resource'
+// label with the resource type.
+// ------------------------------------------------------------------------------------------
+bool WriteRestrackPprof(const char* filename, ProcDumpConfiguration* config, void* symResolver, std::vector<const groupedAllocEntry*>& groups, const std::vector<RestrackCaptureMapping>& targetMappings)
+{
+    restrackWriter writer;
+    pprofStringTable strings;
+    std::vector<pprofMapping> mappings;
+    std::unordered_map<uint64_t, uint64_t> locationIds;         // pc -> location id
+    std::unordered_map<std::string, uint64_t> functionIds;      // name + module -> function id
+    std::string locations;
+    std::string functions;
+    std::string message;
+
+    if(WriterOpen(&writer, filename, true) == false)
+    {
+        return false;
+    }
+
+    //
+    // Skip the perf map pseudo module which covers the whole address space
+    //
+    for (const auto& targetMapping : targetMappings)
+    {
+        if(targetMapping.end != (uint64_t) -1)
+        {
+            pprofMapping mapping = { &targetMapping, mappings.size() + 1 };
+            mappings.push_back(mapping);
+        }
+    }
+
+    std::sort(mappings.begin(), mappings.end(), [](const pprofMapping& a, const pprofMapping& b) {
+        return a.mapping->start < b.mapping->start;
+    });
+
+    //
+    // Sample types (count and bytes). Churn groups count the allocations since the previous
+    // report (freed or not) rather than the outstanding ones.
+    //
+    bool bChurn = std::any_of(groups.begin(), groups.end(), [](const groupedAllocEntry* group) {
+        return group->type == RESTRACK_ALLOC_CHURN;
+    });
+    uint64_t space = strings.Intern(bChurn ? "alloc_space" : "inuse_space");
+    uint64_t countUnit = strings.Intern("count");
+    const uint64_t sampleTypes[][2] = { { strings.Intern(bChurn ? "alloc_objects" : "inuse_objects"), countUnit }, { space, strings.Intern("bytes") } };
+
+    //
+    // The period is the -sr sample rate, one in how many allocations is tracked
+    //
+    uint64_t periodType = strings.Intern("objects");
+    for (const auto& sampleType : sampleTypes)
+    {
+        message.clear();
+        PbUint(message, PPROF_VALUETYPE_TYPE, sampleType[0]);
+        PbUint(message, PPROF_VALUETYPE_UNIT, sampleType[1]);
+
+        std::string field;
+        PbBytes(field, PPROF_PROFILE_SAMPLE_TYPE, message);
+        WriterWriteString(&writer, field);
+    }
+
+    uint64_t resourceKey = strings.Intern("resource");
+
+    //
+    // Samples. Locations and functions are collected while going through the call stacks
+    // and written afterwards.
+    //
+    for (const auto group : groups)
+    {
+        std::vector<stackFrame> callStack;
+        if(ResolveCallStack(config, symResolver, *group, callStack) == false)
+        {
+            continue;
+        }
+
+        std::vector<uint64_t> sampleLocations;
+        for (const auto& frame : callStack)
+        {
+            auto location = locationIds.find(frame.pc);
+            if(location != locationIds.end())
+            {
+                sampleLocations.push_back(location->second);
+                continue;
+            }
+
+            uint64_t locationId = locationIds.size() + 1;
+            locationIds[frame.pc] = locationId;
+            sampleLocations.push_back(locationId);
+
+            //
+            // Find the mapping that contains the frame
+            //
+            uint64_t mappingId = 0;
+            auto mapping = std::upper_bound(mappings.begin(), mappings.end(), frame.pc, [](uint64_t pc, const pprofMapping& m) {
+                return pc < m.mapping->start;
+            });
+            if(mapping != mappings.begin() && frame.pc < (mapping - 1)->mapping->end)
+            {
+                mappingId = (mapping - 1)->id;
+            }
+
+            message.clear();
+            PbUint(message, PPROF_LOCATION_ID, locationId);
+            PbUint(message, PPROF_LOCATION_MAPPING_ID, mappingId);
+            PbUint(message, PPROF_LOCATION_ADDRESS, frame.pc);
+
+            if(frame.symbolName.length() > 0)
+            {
+                std::string functionKey = frame.symbolName + '\0' + frame.moduleName;
+                uint64_t functionId = 0;
+
+                auto function = functionIds.find(functionKey);
+                if(function != functionIds.end())
+                {
+                    functionId = function->second;
+                }
+                else
+                {
+                    functionId = functionIds.size() + 1;
+                    functionIds[functionKey] = functionId;
+
+                    std::string functionMessage;
+                    PbUint(functionMessage, PPROF_FUNCTION_ID, functionId);
+                    PbUint(functionMessage, PPROF_FUNCTION_NAME, strings.Intern(GetFrameName(frame)));
+                    PbUint(functionMessage, PPROF_FUNCTION_SYSTEM_NAME, strings.Intern(frame.symbolName));
+                    PbUint(functionMessage, PPROF_FUNCTION_FILENAME, strings.Intern(frame.moduleName));
+                    PbBytes(functions, PPROF_PROFILE_FUNCTION, functionMessage);
+                }
+
+                std::string line;
+                PbUint(line, PPROF_LINE_FUNCTION_ID, functionId);
+                PbBytes(message, PPROF_LOCATION_LINE, line);
+            }
+
+            PbBytes(locations, PPROF_PROFILE_LOCATION, message);
+        }
+
+        std::string label;
+        PbUint(label, PPROF_LABEL_KEY, resourceKey);
+        PbUint(label, PPROF_LABEL_STR, strings.Intern(GetRestrackSectionTitle(group->type)));
+
+        std::vector<uint64_t> values = { group->allocCount, group->totalAllocSize };
+
+        message.clear();
+        PbPacked(message, PPROF_SAMPLE_LOCATION_ID, sampleLocations);
+        PbPacked(message, PPROF_SAMPLE_VALUE, values);
+        PbBytes(message, PPROF_SAMPLE_LABEL, label);
+
+        std::string field;
+        PbBytes(field, PPROF_PROFILE_SAMPLE, message);
+        WriterWriteString(&writer, field);
+    }
+
+    //
+    // Mappings
+    //
+    for (const auto& mapping : mappings)
+    {
+        message.clear();
+        PbUint(message, PPROF_MAPPING_ID, mapping.id);
+        PbUint(message, PPROF_MAPPING_MEMORY_START, mapping.mapping->start);
+        PbUint(message, PPROF_MAPPING_MEMORY_LIMIT, mapping.mapping->end);
+        PbUint(message, PPROF_MAPPING_FILE_OFFSET, mapping.mapping->fileOffset);
+        PbUint(message, PPROF_MAPPING_FILENAME, strings.Intern(mapping.mapping->path));
+        PbUint(message, PPROF_MAPPING_BUILD_ID, strings.Intern(mapping.mapping->buildId));
+        PbUint(message, PPROF_MAPPING_HAS_FUNCTIONS, 1);
+
+        std::string field;
+        PbBytes(field, PPROF_PROFILE_MAPPING, message);
+        WriterWriteString(&writer, field);
+    }
+
+    WriterWriteString(&writer, locations);
+    WriterWriteString(&writer, functions);
+
+    //
+    // String table (must be written after all strings are interned)
+    //
+    for (const auto& str : strings.strings)
+    {
+        std::string field;
+        PbBytes(field, PPROF_PROFILE_STRING_TABLE, str);
+        WriterWriteString(&writer, field);
+    }
+
+    //
+    // Time, period and default sample type
+    //
+    struct timespec now = {};
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    message.clear();
+    PbUint(message, PPROF_PROFILE_TIME_NANOS, now.tv_sec * 1000000000ULL + now.tv_nsec);
+
+    std::string period;
+    PbUint(period, PPROF_VALUETYPE_TYPE, periodType);
+    PbUint(period, PPROF_VALUETYPE_UNIT, countUnit);
+    PbBytes(message, PPROF_PROFILE_PERIOD_TYPE, period);
+    PbUint(message, PPROF_PROFILE_PERIOD, config->SampleRate);
+    PbUint(message, PPROF_PROFILE_DEFAULT_SAMPLE_TYPE, space);
+    WriterWriteString(&writer, message);
+
+    return WriterClose(&writer);
+}
@@ -80,6 +80,37 @@ bool bcc_perf_map_path(char *map_path, size_t map_len, int pid) {
   return true;
 }
 
+bool bcc_perf_map_parse_line(char *line, uint64_t *start, uint64_t *size,
+                             char **name) {
+  char *cursor = line;
+  char *newline, *sep;
+  unsigned long long begin, len;
+
+  errno = 0;
+  begin = strtoull(cursor, &sep, 16);
+  if (begin == 0 || *sep != ' ' || (begin == ULLONG_MAX && errno == ERANGE))
+    return false;
+  cursor = sep;
+  while (*cursor && isspace(*cursor)) cursor++;
+
+  len = strtoull(cursor, &sep, 16);
+  if (*sep != ' ' ||
+      (sep == cursor && len == 0) ||
+      (len == ULLONG_MAX && errno == ERANGE))
+    return false;
+  cursor = sep;
+  while (*cursor && isspace(*cursor)) cursor++;
+
+  newline = strchr(cursor, '\n');
+  if (newline)
+      newline[0] = '\0';
+
+  *start = begin;
+  *size = len;
+  *name = cursor;
+  return true;
+}
+
 int bcc_perf_map_foreach_sym(const char *path, bcc_perf_map_symcb callback,
                              void* payload) {
   FILE* file = fopen(path, "r");
@@ -88,30 +119,11 @@ int bcc_perf_map_foreach_sym(const char *path, bcc_perf_map_symcb callback,
 
   char *line = NULL;
   size_t size = 0;
-  long long begin, len;
+  uint64_t begin, len;
+  char *name;
   while (getline(&line, &size, file) != -1) {
-    char *cursor = line;
-    char *newline, *sep;
-
-    begin = strtoull(cursor, &sep, 16);
-    if (begin == 0 || *sep != ' ' || (begin == ULLONG_MAX && errno == ERANGE))
-      continue;
-    cursor = sep;
-    while (*cursor && isspace(*cursor)) cursor++;
-
-    len = strtoull(cursor, &sep, 16);
-    if (*sep != ' ' ||
-        (sep == cursor && len == 0) ||
-        (len == ULLONG_MAX && errno == ERANGE))
-      continue;
-    cursor = sep;
-    while (*cursor && isspace(*cursor)) cursor++;
-
-    newline = strchr(cursor, '\n');
-    if (newline)
-        newline[0] = '\0';
-
-    callback(cursor, begin, len, payload);
+    if (bcc_perf_map_parse_line(line, &begin, &len, &name))
+      callback(name, begin, len, payload);
   }
 
   free(line);
@@ -32,6 +32,9 @@ bool bcc_is_valid_perf_map(const char *path);
 
 int bcc_perf_map_nstgid(int pid);
 bool bcc_perf_map_path(char *map_path, size_t map_len, int pid);
+// Parses one "<start> <size> <name>" line in place, name points into line
+bool bcc_perf_map_parse_line(char *line, uint64_t *start, uint64_t *size,
+                             char **name);
 int bcc_perf_map_foreach_sym(const char *path, bcc_perf_map_symcb callback,
                              void* payload);
 
@@ -28,8 +28,11 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 
+#include <sys/mman.h>
+
 #include <cstdio>
 #include <cstring>
+#include <mutex>
 
 #include "bcc_elf.h"
 #include "bcc_perf_map.h"
@@ -171,7 +174,7 @@ bool KSyms::resolve_name(const char *_unused, const char *name,
 }
 
 ProcSyms::ProcSyms(int pid, struct bcc_symbol_option *option)
-    : pid_(pid), procstat_(pid) {
+    : pid_(pid), procstat_(pid), snapshot_(false) {
   if (option)
     std::memcpy(&symbol_option_, option, sizeof(bcc_symbol_option));
   else
@@ -184,11 +187,29 @@ ProcSyms::ProcSyms(int pid, struct bcc_symbol_option *option)
   load_modules();
 }
 
+ProcSyms::ProcSyms(mod_info *modules, int count,
+                   struct bcc_symbol_option *option)
+    : pid_(-1), procstat_(-1), snapshot_(true) {
+  if (option)
+    std::memcpy(&symbol_option_, option, sizeof(bcc_symbol_option));
+  else
+    symbol_option_ = {
+      .use_debug_file = 1,
+      .check_debug_file_crc = 1,
+      .lazy_symbolize = 1,
+      .use_symbol_type = (1 << STT_FUNC) | (1 << STT_GNU_IFUNC)
+    };
+  for (int i = 0; i < count; i++)
+    _add_module(&modules[i], 0, this);
+}
+
 void ProcSyms::load_modules() {
   bcc_procutils_each_module(pid_, _add_module, this);
 }
 
 void ProcSyms::refresh() {
+  if (snapshot_)
+    return;
   modules_.clear();
   load_modules();
   procstat_.reset();
@@ -205,6 +226,8 @@ int ProcSyms::_add_module(mod_info *mod, int enter_ns, void *payload) {
   if (it == ps->modules_.end()) {
     auto module = Module(
         mod->name, modpath, &ps->symbol_option_);
+    if (!ps->snapshot_)
+      module.pid_ = ps->pid_;
 
     // pid/maps doesn't account for file_offset of text within the ELF.
     // It only gives the mmap offset. We need the real offset for symbol
@@ -251,14 +274,7 @@ bool ProcSyms::resolve_addr(uint64_t addr, struct bcc_symbol *sym,
     if (only_perf_map && (mod.type_ != ModuleType::PERF_MAP))
       continue;
     if (mod.contains(addr, offset)) {
-      if (mod.find_addr(offset, sym)) {
-        if (demangle) {
-          if (sym->name && (!strncmp(sym->name, "_Z", 2) || !strncmp(sym->name, "___Z", 4)))
-            sym->demangle_name =
-                abi::__cxa_demangle(sym->name, nullptr, nullptr, nullptr);
-          if (!sym->demangle_name)
-            sym->demangle_name = sym->name;
-        }
+      if (mod.find_addr(offset, sym, demangle)) {
         return true;
       } else if (mod.type_ != ModuleType::PERF_MAP) {
         // In this case, we found the address in the range of a module, but
@@ -297,7 +313,8 @@ ProcSyms::Module::Module(const char *name, std::shared_ptr<ModulePath> path,
       path_(path),
       loaded_(false),
       symbol_option_(option),
-      type_(ModuleType::UNKNOWN) {
+      type_(ModuleType::UNKNOWN),
+      pid_(-1) {
   int elf_type = bcc_elf_get_type(path_->path());
   // The Module is an ELF file
   if (elf_type >= 0) {
@@ -318,23 +335,6 @@ ProcSyms::Module::Module(const char *name, std::shared_ptr<ModulePath> path,
   elf_so_addr_ = 0;
 }
 
-int ProcSyms::Module::_add_symbol(const char *symname, uint64_t start,
-                                  uint64_t size, void *p) {
-  Module *m = static_cast<Module *>(p);
-  auto res = m->symnames_.emplace(symname);
-  m->syms_.emplace_back(&*(res.first), start, size);
-  return 0;
-}
-
-int ProcSyms::Module::_add_symbol_lazy(size_t section_idx, size_t str_table_idx,
-                                       size_t str_len, uint64_t start,
-                                       uint64_t size, int debugfile, void *p) {
-  Module *m = static_cast<Module *>(p);
-  m->syms_.emplace_back(
-      section_idx, str_table_idx, str_len, start, size, debugfile);
-  return 0;
-}
-
 void ProcSyms::Module::load_sym_table() {
   if (loaded_)
     return;
@@ -343,19 +343,23 @@ void ProcSyms::Module::load_sym_table() {
   if (type_ == ModuleType::UNKNOWN)
     return;
 
-  if (type_ == ModuleType::PERF_MAP)
-    bcc_perf_map_foreach_sym(path_->path(), _add_symbol, this);
-  if (type_ == ModuleType::EXEC || type_ == ModuleType::SO) {
-    if (symbol_option_->lazy_symbolize)
-      bcc_elf_foreach_sym_lazy(path_->path(), _add_symbol_lazy, symbol_option_,
-                               this);
+  if (type_ == ModuleType::PERF_MAP) {
+    // Only the lines appended since the previous symbol cache of the process
+    // are parsed
+    if (pid_ != -1)
+      perf_map_ = PerfMap::get(pid_, path_->path());
     else
-      bcc_elf_foreach_sym(path_->path(), _add_symbol, symbol_option_, this);
+      perf_map_ = PerfMap::load(path_->path());
+    perf_map_->update();
+  }
+  if (type_ == ModuleType::EXEC || type_ == ModuleType::SO) {
+    // Files without a build id get a table of their own
+    table_ = SymbolTable::get(path_->path(), symbol_option_);
+    if (!table_)
+      table_ = SymbolTable::load_elf(path_->path(), symbol_option_);
   }
   if (type_ == ModuleType::VDSO)
-    bcc_elf_foreach_vdso_sym(_add_symbol, this);
-
-  std::sort(syms_.begin(), syms_.end());
+    table_ = SymbolTable::load_vdso();
 }
 
 bool ProcSyms::Module::contains(uint64_t addr, uint64_t &offset) const {
@@ -419,14 +423,224 @@ bool ProcSyms::Module::find_name(const char *symname, uint64_t *addr) {
   return true;
 }
 
-bool ProcSyms::Module::find_addr(uint64_t offset, struct bcc_symbol *sym) {
+bool ProcSyms::Module::find_addr(uint64_t offset, struct bcc_symbol *sym,
+                                 bool demangle) {
   load_sym_table();
 
   sym->module = name_.c_str();
   sym->offset = offset;
 
-  auto it = std::upper_bound(syms_.begin(), syms_.end(), Symbol(nullptr, offset, 0));
-  if (it == syms_.begin())
+  if (perf_map_)
+    return perf_map_->find_addr(offset, sym);
+  return table_ && table_->find_addr(offset, sym, demangle);
+}
+
+namespace {
+
+const char kSymbolTableMagic[8] = {'B', 'C', 'C', 'S', 'Y', 'M', 'T', '\0'};
+const uint32_t kSymbolTableVersion = 2;
+const size_t kMaxBuildIdSize = 256;
+
+// Header of a persisted symbol table, followed by the entries and the
+// name pool.
+struct SymbolTableHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t count;
+  uint64_t names_size;
+};
+
+std::mutex symbol_tables_mutex;
+std::unordered_map<std::string, std::shared_ptr<SymbolTable>> symbol_tables;
+std::string symbol_tables_dir;
+
+const size_t kPerfMapBlockSize = 64 * 1024;
+
+std::mutex perf_maps_mutex;
+std::unordered_map<std::string, std::shared_ptr<PerfMap>> perf_maps;
+
+}  // namespace
+
+SymbolTable::~SymbolTable() {
+  if (mapping_)
+    munmap(mapping_, mapping_size_);
+}
+
+void SymbolTable::set_cache_dir(const char *dir) {
+  std::lock_guard<std::mutex> lock(symbol_tables_mutex);
+  symbol_tables_dir = dir ? dir : "";
+}
+
+std::shared_ptr<SymbolTable> SymbolTable::get(const char *path,
+                                              struct bcc_symbol_option *option) {
+  char buildid[kMaxBuildIdSize] = {};
+  if (bcc_elf_get_buildid(path, buildid) < 0 || buildid[0] == '\0')
+    return nullptr;
+
+  // The symbol types and debug file option change the content of the table
+  std::string key = tfm::format("%s.%x.%d", buildid, option->use_symbol_type,
+                                option->use_debug_file);
+  std::string dir;
+  {
+    std::lock_guard<std::mutex> lock(symbol_tables_mutex);
+    auto it = symbol_tables.find(key);
+    if (it != symbol_tables.end())
+      return it->second;
+    dir = symbol_tables_dir;
+  }
+
+  // Build the table without holding the lock, if another thread did the
+  // same in the meantime, the first table wins.
+  std::shared_ptr<SymbolTable> table;
+  std::string index_path;
+  if (!dir.empty()) {
+    index_path = dir + "/" + key + ".symtab";
+    table = load_index(index_path);
+  }
+
+  if (!table) {
+    table = load_elf(path, option);
+    if (!table)
+      return nullptr;
+
+    // Switch to the mmap'ed copy so the table is backed by the page cache
+    // rather than our heap
+    if (!index_path.empty() && table->save_index(index_path)) {
+      std::shared_ptr<SymbolTable> mapped = load_index(index_path);
+      if (mapped)
+        table = mapped;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(symbol_tables_mutex);
+  return symbol_tables.emplace(key, table).first->second;
+}
+
+int SymbolTable::_add_symbol(const char *symname, uint64_t start,
+                             uint64_t size, void *p) {
+  SymbolTable *table = static_cast<SymbolTable *>(p);
+  size_t len = strlen(symname) + 1;
+  if (table->name_storage_.size() > UINT32_MAX - len)
+    return -1;
+
+  Entry entry = {start, (uint32_t)std::min<uint64_t>(size, UINT32_MAX),
+                 (uint32_t)table->name_storage_.size()};
+  table->entry_storage_.push_back(entry);
+  table->name_storage_.append(symname, len);
+  return 0;
+}
+
+void SymbolTable::finish() {
+  std::sort(entry_storage_.begin(), entry_storage_.end());
+  entry_storage_.shrink_to_fit();
+  name_storage_.shrink_to_fit();
+  entries_ = entry_storage_.data();
+  count_ = entry_storage_.size();
+  names_ = name_storage_.data();
+  names_size_ = name_storage_.size();
+}
+
+std::shared_ptr<SymbolTable> SymbolTable::load_elf(
+    const char *path, struct bcc_symbol_option *option) {
+  std::shared_ptr<SymbolTable> table(new SymbolTable());
+
+  // All the names are read up front into the pool, the table never changes
+  bcc_symbol_option table_option = *option;
+  table_option.lazy_symbolize = 0;
+  if (bcc_elf_foreach_sym(path, _add_symbol, &table_option, table.get()) < 0)
+    return nullptr;
+
+  table->finish();
+  return table;
+}
+
+std::shared_ptr<SymbolTable> SymbolTable::load_vdso() {
+  std::shared_ptr<SymbolTable> table(new SymbolTable());
+  bcc_elf_foreach_vdso_sym(_add_symbol, table.get());
+  table->finish();
+  return table;
+}
+
+std::shared_ptr<SymbolTable> SymbolTable::load_index(
+    const std::string &index_path) {
+  int fd = open(index_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(SymbolTableHeader)) {
+    close(fd);
+    return nullptr;
+  }
+
+  void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return nullptr;
+
+  std::shared_ptr<SymbolTable> table(new SymbolTable());
+  table->mapping_ = mapping;
+  table->mapping_size_ = st.st_size;
+
+  const SymbolTableHeader *header =
+      static_cast<const SymbolTableHeader *>(mapping);
+  size_t available = st.st_size - sizeof(SymbolTableHeader);
+  if (memcmp(header->magic, kSymbolTableMagic, sizeof(header->magic)) ||
+      header->version != kSymbolTableVersion ||
+      header->count > available / sizeof(Entry) ||
+      header->names_size != available - header->count * sizeof(Entry) ||
+      (header->names_size > 0 &&
+       static_cast<const char *>(mapping)[st.st_size - 1] != '\0'))
+    return nullptr;
+
+  table->entries_ = reinterpret_cast<const Entry *>(header + 1);
+  table->count_ = header->count;
+  table->names_ = reinterpret_cast<const char *>(table->entries_ + table->count_);
+  table->names_size_ = header->names_size;
+  return table;
+}
+
+bool SymbolTable::save_index(const std::string &index_path) const {
+  // Write to a temporary file first so that readers never see a partial table.
+  // The name is unique since several threads can save the same table at once.
+  std::string tmp_path = index_path + ".XXXXXX";
+  int fd = mkstemp(&tmp_path[0]);
+  if (fd < 0)
+    return false;
+
+  FILE *file = fdopen(fd, "w");
+  if (!file) {
+    close(fd);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  SymbolTableHeader header = {};
+  memcpy(header.magic, kSymbolTableMagic, sizeof(header.magic));
+  header.version = kSymbolTableVersion;
+  header.count = count_;
+  header.names_size = names_size_;
+
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(entries_, sizeof(Entry), count_, file) == count_ &&
+            fwrite(names_, 1, names_size_, file) == names_size_;
+  if (fclose(file) != 0)
+    ok = false;
+
+  if (!ok || rename(tmp_path.c_str(), index_path.c_str()) < 0) {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool SymbolTable::find_addr(uint64_t offset, struct bcc_symbol *sym,
+                            bool demangle) const {
+  Entry key = {offset, 0, 0};
+  const Entry *it = std::upper_bound(entries_, entries_ + count_, key);
+  if (it == entries_)
     return false;
 
   // 'it' points to the symbol whose start address is strictly greater than
@@ -453,32 +667,159 @@ bool ProcSyms::Module::find_addr(uint64_t offset, struct bcc_symbol *sym) {
   uint64_t limit = it->start;
   for (; offset >= it->start; --it) {
     if (offset < it->start + it->size) {
-      // Resolve and cache the symbol name if necessary
-      if (!it->is_name_resolved) {
-        std::string sym_name(it->data.name_idx.str_len + 1, '\0');
-        if (bcc_elf_symbol_str(path_->path(), it->data.name_idx.section_idx,
-                               it->data.name_idx.str_table_idx, &sym_name[0],
-                               sym_name.size(), it->data.name_idx.debugfile))
-          break;
-
-        it->data.name = &*(symnames_.emplace(std::move(sym_name)).first);
-        it->is_name_resolved = true;
-      }
-
-      sym->name = it->data.name->c_str();
-      sym->offset = (offset - it->start);
+      if (it->name_offset >= names_size_)
+        return false;
+      sym->name = names_ + it->name_offset;
+      sym->offset = offset - it->start;
+      if (demangle)
+        sym->demangle_name = demangle_name(it->name_offset);
       return true;
     }
     if (limit > it->start + it->size)
       break;
-    // But don't step beyond begin()!
-    if (it == syms_.begin())
+    // But don't step beyond the first entry!
+    if (it == entries_)
       break;
   }
 
   return false;
 }
 
+const char *SymbolTable::demangle_name(uint32_t name_offset) const {
+  const char *name = names_ + name_offset;
+  if (strncmp(name, "_Z", 2) && strncmp(name, "___Z", 4))
+    return name;
+
+  // Only the names of the symbols that are looked up are demangled, once
+  std::lock_guard<std::mutex> lock(demangled_mutex_);
+  auto it = demangled_.find(name_offset);
+  if (it == demangled_.end()) {
+    char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, nullptr);
+    it = demangled_.emplace(name_offset, demangled ? demangled : "").first;
+    free(demangled);
+  }
+
+  return it->second.empty() ? name : it->second.c_str();
+}
+
+std::shared_ptr<PerfMap> PerfMap::get(int pid, const char *path) {
+  std::lock_guard<std::mutex> lock(perf_maps_mutex);
+  std::shared_ptr<PerfMap> &perf_map = perf_maps[path];
+  if (!perf_map || perf_map->pid_ != pid)
+    perf_map.reset(new PerfMap(pid, path));
+  return perf_map;
+}
+
+std::shared_ptr<PerfMap> PerfMap::load(const char *path) {
+  return std::shared_ptr<PerfMap>(new PerfMap(-1, path));
+}
+
+void PerfMap::release(int pid) {
+  std::lock_guard<std::mutex> lock(perf_maps_mutex);
+  for (auto it = perf_maps.begin(); it != perf_maps.end();) {
+    if (it->second->pid_ == pid)
+      it = perf_maps.erase(it);
+    else
+      ++it;
+  }
+}
+
+void PerfMap::reset() {
+  // The names are kept, symbols resolved earlier may still point to them
+  entries_.clear();
+  offset_ = 0;
+}
+
+void PerfMap::update() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FILE *file = fopen(path_.c_str(), "r");
+  if (!file)
+    return;
+
+  struct stat st;
+  if (fstat(fileno(file), &st) < 0) {
+    fclose(file);
+    return;
+  }
+
+  // A different file (the pid was reused) or a truncated one, start over
+  if (st.st_dev != dev_ || st.st_ino != ino_ || (uint64_t)st.st_size < offset_) {
+    reset();
+    dev_ = st.st_dev;
+    ino_ = st.st_ino;
+  }
+
+  if ((uint64_t)st.st_size == offset_ || fseeko(file, offset_, SEEK_SET) < 0) {
+    fclose(file);
+    return;
+  }
+
+  char *line = NULL;
+  size_t line_size = 0;
+  ssize_t len;
+  while ((len = getline(&line, &line_size, file)) != -1) {
+    // The runtime is still writing the last line, it's read next time
+    if (line[len - 1] != '\n')
+      break;
+    offset_ += len;
+
+    uint64_t start, size;
+    char *name;
+    if (bcc_perf_map_parse_line(line, &start, &size, &name))
+      add_symbol(name, start, size);
+  }
+
+  free(line);
+  fclose(file);
+}
+
+void PerfMap::add_symbol(const char *name, uint64_t start, uint64_t size) {
+  uint64_t end = start + std::max<uint64_t>(size, 1);
+
+  // Drop the older entries overlapping [start, end)
+  auto it = entries_.lower_bound(start);
+  if (it != entries_.begin()) {
+    auto prev = std::prev(it);
+    if (prev->second.end > start)
+      it = prev;
+  }
+  while (it != entries_.end() && it->first < end)
+    it = entries_.erase(it);
+
+  Entry entry = {end, add_name(name)};
+  entries_.emplace_hint(it, start, entry);
+}
+
+const char *PerfMap::add_name(const char *name) {
+  size_t len = strlen(name) + 1;
+  if (name_blocks_.empty() || block_used_ + len > kPerfMapBlockSize) {
+    name_blocks_.emplace_back(new char[std::max(len, kPerfMapBlockSize)]);
+    block_used_ = 0;
+  }
+
+  char *copy = name_blocks_.back().get() + block_used_;
+  memcpy(copy, name, len);
+  block_used_ += len;
+  return copy;
+}
+
+bool PerfMap::find_addr(uint64_t addr, struct bcc_symbol *sym) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.upper_bound(addr);
+  if (it == entries_.begin())
+    return false;
+
+  --it;
+  if (addr >= it->second.end)
+    return false;
+
+  // JIT names (.NET, node, ...) are not mangled
+  sym->name = it->second.name;
+  sym->demangle_name = sym->name;
+  sym->offset = addr - it->first;
+  return true;
+}
+
 bool BuildSyms::Module::load_sym_table()
 {
   if (loaded_)
@@ -575,6 +916,19 @@ void *bcc_symcache_new(int pid, struct bcc_symbol_option *option) {
   return static_cast<void *>(new ProcSyms(pid, option));
 }
 
+void *bcc_symcache_new_from_modules(struct mod_info *modules, int count,
+                                    struct bcc_symbol_option *option) {
+  return static_cast<void *>(new ProcSyms(modules, count, option));
+}
+
+void bcc_symcache_set_cache_dir(const char *dir) {
+  SymbolTable::set_cache_dir(dir);
+}
+
+void bcc_symcache_release_perf_map(int pid) {
+  PerfMap::release(pid);
+}
+
 void bcc_free_symcache(void *symcache, int pid) {
   if (pid < 0)
     delete static_cast<KSyms*>(symcache);
@@ -583,8 +937,7 @@ void bcc_free_symcache(void *symcache, int pid) {
 }
 
 void bcc_symbol_free_demangle_name(struct bcc_symbol *sym) {
-  if (sym->demangle_name && (sym->demangle_name != sym->name))
-    free(const_cast<char*>(sym->demangle_name));
+  // Demangled names are owned by the symbol tables
 }
 
 int bcc_symcache_resolve(void *resolver, uint64_t addr,
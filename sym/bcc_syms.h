@@ -55,11 +55,24 @@ struct bcc_symbol_option {
 };
 
 void *bcc_symcache_new(int pid, struct bcc_symbol_option *option);
+// Creates a symbol cache from a snapshot of the executable mappings of a
+// process (for example, saved from /proc/PID/maps) instead of a live process.
+// The module paths are used as is. Free with bcc_free_symcache(symcache, 0).
+void *bcc_symcache_new_from_modules(struct mod_info *modules, int count,
+                                    struct bcc_symbol_option *option);
 void bcc_free_symcache(void *symcache, int pid);
-
-// The demangle_name pointer in bcc_symbol struct is returned from the
-// __cxa_demangle function call, which is supposed to be freed by caller. Call
-// this function after done using returned result of bcc_symcache_resolve.
+// Sets the directory where the symbol tables of ELF files with a build id are
+// persisted (and mmap'ed back from). The tables are always shared in memory
+// across symbol caches, NULL or an empty string disables persistence.
+void bcc_symcache_set_cache_dir(const char *dir);
+// The perf map (/tmp/perf-PID.map) of a live process is read incrementally:
+// it's kept across the symbol caches of the process and each new cache only
+// parses what was appended since. Drops the perf map kept for the process.
+void bcc_symcache_release_perf_map(int pid);
+
+// The demangle_name pointer in bcc_symbol struct is cached by the symbol
+// cache and stays valid until the cache is freed. Kept for compatibility, this
+// function does nothing.
 void bcc_symbol_free_demangle_name(struct bcc_symbol *sym);
 int bcc_symcache_resolve(void *symcache, uint64_t addr, struct bcc_symbol *sym);
 int bcc_symcache_resolve_no_demangle(void *symcache, uint64_t addr,
@@ -16,7 +16,9 @@
 #pragma once
 
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <sys/types.h>
 #include <unordered_map>
@@ -83,40 +85,108 @@ public:
   virtual void refresh() override;
 };
 
-class ProcSyms : SymbolCache {
-  struct NameIdx {
-    size_t section_idx;
-    size_t str_table_idx;
-    size_t str_len;
-    bool debugfile;
+// Address sorted symbol table of a module: an array of {start, size,
+// name_offset} entries over a single pool of names. Tables are immutable once
+// built. Tables of ELF files with a build id are shared by every module that
+// maps the same file (across symbol caches and processes) and, if a cache
+// directory is set, persisted there and mmap'ed back instead of parsing the
+// ELF file. Names are demangled on first lookup and cached.
+class SymbolTable {
+ public:
+  struct Entry {
+    uint64_t start;
+    uint32_t size;
+    uint32_t name_offset;
+
+    bool operator<(const Entry &rhs) const { return start < rhs.start; }
   };
 
-  struct Symbol {
-    Symbol(const std::string *name, uint64_t start, uint64_t size)
-        : is_name_resolved(true), start(start), size(size) {
-      data.name = name;
-    }
-    Symbol(size_t section_idx, size_t str_table_idx, size_t str_len, uint64_t start,
-           uint64_t size, bool debugfile)
-        : is_name_resolved(false), start(start), size(size) {
-      data.name_idx.section_idx = section_idx;
-      data.name_idx.str_table_idx = str_table_idx;
-      data.name_idx.str_len = str_len;
-      data.name_idx.debugfile = debugfile;
-    }
-    bool is_name_resolved;
-    union {
-      struct NameIdx name_idx;
-      const std::string *name{nullptr};
-    } data;
-    uint64_t start;
-    uint64_t size;
+  ~SymbolTable();
+
+  bool find_addr(uint64_t offset, struct bcc_symbol *sym, bool demangle) const;
+
+  static std::shared_ptr<SymbolTable> get(const char *path,
+                                          struct bcc_symbol_option *option);
+  static std::shared_ptr<SymbolTable> load_elf(const char *path,
+                                               struct bcc_symbol_option *option);
+  static std::shared_ptr<SymbolTable> load_vdso();
+  static void set_cache_dir(const char *dir);
+
+ private:
+  SymbolTable()
+      : entries_(nullptr), count_(0), names_(nullptr), names_size_(0),
+        mapping_(nullptr), mapping_size_(0) {}
+
+  static std::shared_ptr<SymbolTable> load_index(const std::string &index_path);
+  bool save_index(const std::string &index_path) const;
+  static int _add_symbol(const char *symname, uint64_t start, uint64_t size,
+                         void *p);
+  void finish();
+  const char *demangle_name(uint32_t name_offset) const;
+
+  const Entry *entries_;
+  size_t count_;
+  const char *names_;
+  size_t names_size_;
+
+  // Storage when built from the ELF file
+  std::vector<Entry> entry_storage_;
+  std::string name_storage_;
+
+  // Storage when mmap'ed from the cache directory
+  void *mapping_;
+  size_t mapping_size_;
+
+  // Demangled names by name offset, empty if the name can't be demangled
+  mutable std::mutex demangled_mutex_;
+  mutable std::unordered_map<uint32_t, std::string> demangled_;
+};
 
-    bool operator<(const struct Symbol& rhs) const {
-      return start < rhs.start;
-    }
+// Symbols of a JIT perf map (/tmp/perf-<pid>.map). Runtimes keep appending
+// to the file while the process runs, so the map remembers how far it has
+// read and update() only parses the lines added since. Entries are indexed by
+// address interval, a newer entry replaces the ones it overlaps (code that was
+// re-jitted or whose memory was reused). Maps of live processes are shared
+// by the symbol caches of the process until release() is called.
+class PerfMap {
+ public:
+  bool find_addr(uint64_t addr, struct bcc_symbol *sym);
+  void update();
+
+  static std::shared_ptr<PerfMap> get(int pid, const char *path);
+  static std::shared_ptr<PerfMap> load(const char *path);
+  static void release(int pid);
+
+ private:
+  struct Entry {
+    uint64_t end;
+    const char *name;
   };
 
+  PerfMap(int pid, const char *path)
+      : pid_(pid), path_(path), dev_(0), ino_(0), offset_(0), block_used_(0) {}
+
+  void reset();
+  void add_symbol(const char *name, uint64_t start, uint64_t size);
+  const char *add_name(const char *name);
+
+  int pid_;
+  std::string path_;
+  std::mutex mutex_;
+
+  // Identity of the file and how much of it has been parsed
+  dev_t dev_;
+  ino_t ino_;
+  uint64_t offset_;
+
+  // Entries by start address, the names are stored in fixed size blocks so
+  // that the names handed out stay valid across updates
+  std::map<uint64_t, Entry> entries_;
+  std::vector<std::unique_ptr<char[]>> name_blocks_;
+  size_t block_used_;
+};
+
+class ProcSyms : SymbolCache {
   enum class ModuleType {
     UNKNOWN,
     EXEC,
@@ -172,34 +242,33 @@ class ProcSyms : SymbolCache {
     uint64_t elf_so_offset_;
     uint64_t elf_so_addr_;
 
-    std::unordered_set<std::string> symnames_;
-    std::vector<Symbol> syms_;
+    std::shared_ptr<SymbolTable> table_;
+    std::shared_ptr<PerfMap> perf_map_;
+    // Process the perf map belongs to, -1 for snapshots
+    int pid_;
 
     void load_sym_table();
 
     bool contains(uint64_t addr, uint64_t &offset) const;
     uint64_t start() const { return ranges_.begin()->start; }
 
-    bool find_addr(uint64_t offset, struct bcc_symbol *sym);
+    bool find_addr(uint64_t offset, struct bcc_symbol *sym, bool demangle);
     bool find_name(const char *symname, uint64_t *addr);
-
-    static int _add_symbol(const char *symname, uint64_t start, uint64_t size,
-                           void *p);
-    static int _add_symbol_lazy(size_t section_idx, size_t str_table_idx,
-                                size_t str_len, uint64_t start, uint64_t size,
-                                int debugfile, void *p);
   };
 
   int pid_;
   std::vector<Module> modules_;
   ProcStat procstat_;
   bcc_symbol_option symbol_option_;
+  // Modules of a snapshot, never reloaded
+  bool snapshot_;
 
   static int _add_module(mod_info *, int, void *);
   void load_modules();
 
 public:
   ProcSyms(int pid, struct bcc_symbol_option *option = nullptr);
+  ProcSyms(mod_info *modules, int count, struct bcc_symbol_option *option = nullptr);
   virtual void refresh() override;
   virtual bool resolve_addr(uint64_t addr, struct bcc_symbol *sym, bool demangle = true) override;
   virtual bool resolve_name(const char *module, const char *name,
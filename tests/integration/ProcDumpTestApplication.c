@@ -6,6 +6,13 @@
 #include <signal.h>
 #include <limits.h>
 #include <sys/mman.h>
+#include <fcntl.h>
+#include <time.h>
+#if defined(__linux__) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#else
+#define DTRACE_PROBE1(provider, name, arg)
+#endif
 
 #define FILE_DESC_COUNT	500
 #define THREAD_COUNT	100
@@ -76,6 +83,30 @@ void* ThreadProc(void *input)
     return NULL;
 };
 
+void Burn(int ms)
+{
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        do
+        {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+        } while((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 < ms);
+}
+
+__attribute__((noinline)) void ProbeTarget(int iteration)
+{
+        DTRACE_PROBE1(procdumptest, probe, iteration);
+
+        // Every 20th call is slow (-pl)
+        usleep(iteration % 20 == 19 ? 1000000 : 10000);
+}
+
+void ThrowExceptions(void);
+
+void SignalHandler(int signum)
+{
+}
+
 int main(int argc, char *argv[])
 {
     if (argc > 1)
@@ -92,6 +123,39 @@ int main(int argc, char *argv[])
         {
             while(1);
         }
+        else if (strcmp("memwave", argv[1]) == 0)
+        {
+          // Commit oscillates between ~75MB and ~90MB every 2s (-mh)
+          size_t baseSize = 74 * 1024 * 1024;
+          size_t waveSize = 16 * 1024 * 1024;
+          sleep(10);
+          char* base = mmap(NULL, baseSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+          if(base != MAP_FAILED)
+          {
+            memset(base, 'a', baseSize);
+          }
+          while(1)
+          {
+            char* wave = mmap(NULL, waveSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(wave != MAP_FAILED)
+            {
+              memset(wave, 'a', waveSize);
+              sleep(2);
+              munmap(wave, waveSize);
+            }
+            sleep(2);
+          }
+        }
+        else if (strcmp("burst", argv[1]) == 0)
+        {
+          // 400ms bursts every 2s, 20% on average but 100% within the bursts (-cw)
+          sleep(10);
+          while(1)
+          {
+            Burn(400);
+            usleep(1600000);
+          }
+        }
         else if (strcmp("fc", argv[1]) == 0)
         {
           FILE* fd[FILE_DESC_COUNT];
@@ -102,6 +166,18 @@ int main(int argc, char *argv[])
           memset(fd, 0, FILE_DESC_COUNT*sizeof(FILE*));
           sleep(UINT_MAX);
         }
+        else if (strcmp("fcdup", argv[1]) == 0)
+        {
+          // Descriptors only created by fcntl and dup2 (-fc counted in-kernel)
+          sleep(10);
+          int fd = open(argv[0], O_RDONLY);
+          for(int i=0; i<FILE_DESC_COUNT/2; i++)
+          {
+              fcntl(fd, F_DUPFD, 0);
+              dup2(fd, FILE_DESC_COUNT + i);
+          }
+          sleep(UINT_MAX);
+        }
         else if (strcmp("tc", argv[1]) == 0)
         {
           pthread_t threads[THREAD_COUNT];
@@ -124,5 +200,45 @@ int main(int argc, char *argv[])
 
           sleep(UINT_MAX);
         }
+        else if (strcmp("segfault", argv[1]) == 0)
+        {
+          int* volatile ptr = NULL;
+          sleep(10);
+          *ptr = 0;
+        }
+        else if (strcmp("probe", argv[1]) == 0)
+        {
+          sleep(10);
+          for(int i=0; ; i++)
+          {
+            ProbeTarget(i);
+            usleep(100000);
+          }
+        }
+        else if (strcmp("syscallerror", argv[1]) == 0)
+        {
+          sleep(10);
+          while(1)
+          {
+            // Fails with ENOENT
+            open("/nonexistent/procdumptest", O_RDONLY);
+            usleep(100000);
+          }
+        }
+        else if (strcmp("throw", argv[1]) == 0)
+        {
+          sleep(10);
+          ThrowExceptions();
+        }
+        else if (strcmp("signal", argv[1]) == 0)
+        {
+          signal(SIGUSR1, SignalHandler);
+          sleep(10);
+          while(1)
+          {
+            raise(SIGUSR1);
+            sleep(1);
+          }
+        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include <stdexcept>
+#include <unistd.h>
+
+//
+// C++ exceptions for the -ne scenarios, thrown (and caught) every 100ms
+//
+extern "C" void ThrowExceptions()
+{
+    while(1)
+    {
+        try
+        {
+            throw std::runtime_error("ProcDumpTestApplication");
+        }
+        catch(const std::exception&)
+        {
+        }
+        usleep(100000);
+    }
+}
@@ -99,14 +99,61 @@ function runProcDumpAndValidate {
 
 	# If we are checking restrack results
 	if [[ $PREFIX == *"-restrack"* ]]; then
-		foundFile=$(find "$dumpDir" -mindepth 1 -name "*.restrack" -print -quit)
-		if [[ -n $foundFile ]]; then
-			pwd
-			if [ $(stat -c%s "$foundFile") -gt 19 ]; then
-				exit 0
+		reportExtension=".restrack"
+		if [[ $PREFIX == *"-rf pprof"* ]]; then
+			reportExtension=".restrack.pb.gz"
+		elif [[ $PREFIX == *"-rf folded"* ]]; then
+			reportExtension=".restrack.folded"
+		elif [[ $PREFIX == *"-rf raw"* ]]; then
+			reportExtension=".restrack.raw"
+		fi
+
+		foundFile=$(find "$dumpDir" -mindepth 1 -name "*$reportExtension" -print -quit)
+		if [[ -z $foundFile ]]; then
+			exit 1
+		fi
+		pwd
+
+		# Raw captures are validated through the report generated from them
+		if [[ $reportExtension == ".restrack.raw" ]]; then
+			echo "$PROCDUMPPATH -log stdout -restrack-report $foundFile"
+			$PROCDUMPPATH -log stdout -restrack-report "$foundFile"
+			foundFile="${foundFile%.raw}"
+			reportExtension=".restrack"
+			if [ ! -f "$foundFile" ]; then
+				exit 1
+			fi
+		fi
+
+		if [ $(stat -c%s "$foundFile") -le 19 ]; then
+			exit 1
+		fi
+
+		# pprof reports are gzip'ed, folded reports are one 'frame;frame;... value' line per stack
+		if [[ $reportExtension == ".restrack.pb.gz" ]]; then
+			gzip -t "$foundFile" || exit 1
+		elif [[ $reportExtension == ".restrack.folded" ]]; then
+			if grep -qvE '^[^;]+(;.+)* [0-9]+$' "$foundFile"; then
+				exit 1
 			fi
 		fi
-		exit 1;
+
+		# Optionally, one of the reports has to contain REPORTPATTERN
+		if [ -n "$REPORTPATTERN" ]; then
+			if ! grep -lq "$REPORTPATTERN" "$dumpDir"/*$reportExtension; then
+				exit 1
+			fi
+		fi
+		exit 0
+	fi
+
+	# Optionally, exactly DUMPCOUNT dumps have to be written
+	if [ -n "$DUMPCOUNT" ]; then
+		if [ $(find "$dumpDir" -mindepth 1 -maxdepth 1 -type f | wc -l) -eq $DUMPCOUNT ]; then
+			exit 0
+		else
+			exit 1
+		fi
 	fi
 
 	# We're checking dump results
@@ -0,0 +1,33 @@
+#!/bin/bash
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )";
+OS=$(uname -s)
+if [ "$OS" = "Darwin" ]; then
+    runProcDumpAndValidate=$DIR/../runProcDumpAndValidate.sh;
+else
+    runProcDumpAndValidate=$(readlink -m "$DIR/../runProcDumpAndValidate.sh");    
+fi
+
+source $runProcDumpAndValidate
+
+TESTPROGNAME="ProcDumpTestApplication"
+TESTPROGMODE="burst"
+
+# TARGETVALUE is only used for stress-ng
+#TARGETVALUE=3M
+
+# These are all the ProcDump switches preceeding the PID
+PREFIX="-c 50 -cw 200"
+
+# This are all the ProcDump switches after the PID
+POSTFIX=""
+
+# Indicates whether the test should result in a dump or not
+SHOULDDUMP=true
+
+# Only applicable to stress-ng and can be either MEM or CPU
+RESTYPE=""
+
+# The dump target
+DUMPTARGET=""
+
+runProcDumpAndValidate
\ No newline at end of file